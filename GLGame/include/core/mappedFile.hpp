@@ -0,0 +1,31 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// read only view of a whole file. posix systems map it, everything else falls
+// back to one bulk read into memory we own. the view stays valid until close().
+class MappedFile{
+public:
+    MappedFile() = default;
+    ~MappedFile(){ close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const char* getData() const { return data; }
+    size_t getSize() const { return size; }
+    bool isOpen() const { return opened; }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    bool opened = false;
+    bool mapped = false;
+    std::vector<char> buffer;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+#include <cstddef>
+#include <functional>
+
+// a fixed set of worker threads shared by the whole game. jobs never touch gl,
+// only the main thread owns the context. without init() everything runs inline
+// on the calling thread.
+class ThreadPool{
+public:
+    // threadCount 0 uses one worker per hardware thread minus the main thread
+    static void init(unsigned int threadCount = 0);
+    static void shutdown();
+
+    // workers plus the calling thread
+    static unsigned int getThreadCount();
+
+    static void submit(std::function<void()> job);
+
+    // number of ranges parallelFor splits count items into, each at least minRange long
+    static unsigned int getRangeCount(size_t count, size_t minRange);
+
+    // calls body(range, begin, end) for contiguous ranges covering [0, count) and
+    // returns once all of them are done. the calling thread works through the ranges
+    // no worker has picked up yet, never other queued jobs, so a decode waiting in the
+    // queue can't stall it and nested calls from a job don't deadlock.
+    static void parallelFor(size_t count, size_t minRange, const std::function<void(unsigned int range, size_t begin, size_t end)>& body);
+};
+
+#endif
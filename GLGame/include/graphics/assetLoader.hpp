@@ -0,0 +1,59 @@
+#ifndef ASSET_LOADER_HPP
+#define ASSET_LOADER_HPP
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "graphics/model.hpp"
+#include "graphics/textureArray.hpp"
+
+enum class AssetState : uint8_t{
+    Loading,    // queued or being read and decoded on a worker
+    Uploading,  // decoded, waiting for its turn in AssetLoader::update
+    Ready,
+    Failed
+};
+
+// what a load call hands back right away. value is only written on the main
+// thread, by AssetLoader::update, so it can be used there as soon as isReady()
+template <typename T>
+struct Asset{
+    std::atomic<AssetState> state{AssetState::Loading};
+    T value{};
+
+    bool isReady() const { return state.load(std::memory_order_acquire) == AssetState::Ready; }
+};
+
+template <typename T>
+using AssetHandle = std::shared_ptr<Asset<T>>;
+
+// loads assets in the background. file reads, obj parsing and cooking, image
+// decoding and mip generation run on the ThreadPool; the gl uploads they end in are queued for the
+// main thread, which works through them in update() within a time budget per frame.
+class AssetLoader{
+public:
+    // waits for the decodes still running and drops the uploads that never happened
+    static void shutdown();
+
+    // resources come from ResourceCache, a cached one is Ready right away. asking for
+    // one that is still loading hands back the same handle, it is only decoded and
+    // uploaded once. main thread only
+    static AssetHandle<std::shared_ptr<TextureLayer>> loadTexture(const std::string& path);
+    static AssetHandle<std::shared_ptr<Model>> loadModel(const std::string& objPath, const std::string& texturePath, bool alphaOn);
+
+    // runs queued uploads until budgetMilliseconds is spent. at least one runs per
+    // call, so an upload longer than the budget still gets through. main thread only
+    static void update(double budgetMilliseconds);
+
+    // assets neither Ready nor Failed yet
+    static unsigned int getPendingCount();
+
+    struct Stats{
+        unsigned int uploads = 0;
+        double uploadMilliseconds = 0.0;
+        double longestUpdateMilliseconds = 0.0;
+    };
+    static const Stats& getStats();
+};
+
+#endif
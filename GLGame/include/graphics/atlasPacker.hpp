@@ -0,0 +1,64 @@
+#ifndef ATLAS_PACKER_HPP
+#define ATLAS_PACKER_HPP
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// the .atlas file: this header, spriteCount records, then every page's RGBA8 pixels
+// at pageOffset, bottom up like ImageDecoder's
+struct AtlasFileHeader{
+    char magic[4];
+    uint32_t version;
+    uint32_t pageWidth;
+    uint32_t pageHeight;
+    uint32_t pageCount;
+    uint32_t spriteCount;
+    uint32_t pageOffset;
+    // mip levels, the page's own included, in which no texel mixes two sprites' cells
+    uint32_t levelCount;
+};
+
+// one image's texels on a page, without its gutter
+struct AtlasSpriteRecord{
+    char name[64];
+    uint32_t page;
+    uint32_t x, y;
+    uint32_t width, height;
+};
+
+struct AtlasPlacement{
+    uint16_t page = 0;
+    int x = 0, y = 0;
+};
+
+struct AtlasLayout{
+    int pageWidth = 0;
+    int pageHeight = 0;
+    unsigned int pageCount = 0;
+    // by rect, page is NOT_PACKED for rects larger than a page
+    std::vector<AtlasPlacement> placements;
+};
+
+// packs sprites into texture pages with maxrects, best short side fit. sprites are
+// never rotated, so their uvs stay a plain rect. every page has the same size so
+// they can share a texture array page
+class AtlasPacker{
+public:
+    static const uint32_t VERSION = 2;
+    static const uint16_t NOT_PACKED = 0xffff;
+
+    // the page with the least area that holds every rect, each side a multiple of
+    // alignment and at most maxPageSize. more maxPageSize square pages when one isn't
+    // enough
+    static AtlasLayout pack(const std::vector<glm::ivec2>& sizes, int maxPageSize, int alignment = 1);
+
+    // decodes the images and writes them to path as an atlas. every sprite is framed
+    // by gutter texels copied from its edges and padding transparent ones, and its
+    // cell starts on a multiple of the gutter rounded to a power of two, so the
+    // mips down to that level don't mix neighbours. the pages keep only those mips,
+    // see levelCount. sprites are named after their file
+    static bool cook(const std::vector<std::string>& imagePaths, const std::string& path, int maxPageSize = 2048, int gutter = 4, int padding = 0);
+};
+
+#endif
@@ -2,12 +2,20 @@
 #define BATCH_RENDERER_2D_HPP
 // code greatly inspired by The Cherno
 #include <glm/glm.hpp>
+#include <functional>
+#include <vector>
+#include "graphics/batchVertex.hpp"
+#include "graphics/frustum.hpp"
 #include "graphics/shader.h"
+#include "graphics/streamBuffer.hpp"
+#include "graphics/textureArray.hpp"
+#include "graphics/textureAtlas.hpp"
+#include "graphics/vertexKernels.hpp"
 
 class BatchRenderer2D
 {
 public:
-    static void init();
+    static void init(UploadMode mode = UploadMode::RingBuffer);
     static void shutdown();
 
     static void startBatch();
@@ -15,21 +23,78 @@ public:
     static void flush();
 
     static void drawQuad(const glm::vec2& position, const glm::vec2& size, const glm::vec4& color);
-    static void drawQuad(const glm::vec2& position, const glm::vec2& size, unsigned int textureID);
+    static void drawQuad(const glm::vec2& position, const glm::vec2& size, const TextureLayer& texture);
     static void drawTile(const glm::vec2& position, const glm::vec2& size, const glm::vec4& color, float rotation);
-    static void drawTile(const glm::vec2& position, const glm::vec2& size, unsigned int textureID, float rotation);
+    static void drawTile(const glm::vec2& position, const glm::vec2& size, const TextureLayer& texture, float rotation);
     static void drawTile(const glm::vec2& position, const glm::vec2& size, const glm::vec4& color);
-    static void drawTile(const glm::vec2& position, const glm::vec2& size, unsigned int textureID);
+    static void drawTile(const glm::vec2& position, const glm::vec2& size, const TextureLayer& texture);
+    // atlas sprites batch like any other layer of their page, with the sprite's uvs
+    static void drawQuad(const glm::vec2& position, const glm::vec2& size, const AtlasSprite& sprite);
+    static void drawTile(const glm::vec2& position, const glm::vec2& size, const AtlasSprite& sprite);
+    // bulk version of drawTile, expanded with the sse kernels and split across the thread pool
+    static void drawTiles(const TileArrays& tiles);
+
+    // one thread's slice of a batch built with drawParallel. it writes its quads into
+    // its own scratch, drawParallel copies them into the batch once every thread is done
+    class QuadWriter{
+    public:
+        void drawQuad(const glm::vec2& position, const glm::vec2& size, const glm::vec4& color);
+        void drawQuad(const glm::vec2& position, const glm::vec2& size, const TextureLayer& texture);
+        void drawTile(const glm::vec2& position, const glm::vec2& size, const glm::vec4& color);
+        void drawTile(const glm::vec2& position, const glm::vec2& size, const TextureLayer& texture);
+        void drawQuad(const glm::vec2& position, const glm::vec2& size, const AtlasSprite& sprite);
+        void drawTile(const glm::vec2& position, const glm::vec2& size, const AtlasSprite& sprite);
+
+    private:
+        friend class BatchRenderer2D;
+        // quads from firstQuad on sample page, until the next run
+        struct PageRun{
+            unsigned int firstQuad;
+            uint16_t page;
+        };
+        void begin(unsigned int maxQuads);
+        uint16_t resolve(const TextureLayer& texture);
+        bool cull(const glm::vec3& min, const glm::vec3& max);
+        BatchVertex* next() { return &vertices[quadCount++ * 4]; }
+
+        // kept between calls so the scratch is only allocated once
+        std::vector<BatchVertex> vertices;
+        std::vector<PageRun> runs;
+        unsigned int quadCount = 0;
+        unsigned int maxQuads = 0;
+        uint16_t texturePage = 0;
+        unsigned int culled = 0;
+    };
+
+    // builds quadCount quads on the thread pool. build is called once per contiguous
+    // range [begin, end) and must draw at most end - begin quads through its writer.
+    // only the quads actually drawn end up in the batch, in range order, and a switch
+    // to another texture page flushes the batch like it does for drawQuad
+    static void drawParallel(unsigned int quadCount, const std::function<void(QuadWriter& writer, unsigned int begin, unsigned int end)>& build);
+
+    // quads entirely outside the frustum are dropped before their vertices are written.
+    // pass a default constructed Frustum to turn culling off
+    static void setFrustum(const Frustum& frustum);
 
     static void setupShaderSampler(Shader& shader);
 
     struct Stats{
         unsigned int drawCalls = 0;
         unsigned int quadCount = 0;
+        unsigned int bytesUploaded = 0;
+        unsigned int bytesSaved = 0; // compared to the unpacked float vertex layout
+        unsigned int culled = 0;
     };
     
     static const Stats& getStats();
     static void resetStats();
+
+    // times drawTile against expandTiles and per tile isBoxVisible against cullTiles on
+    // count random tiles, plain and rotated, and checks both pairs agree. needs neither gl nor init()
+    static void benchmarkKernels(unsigned int count = 100000, unsigned int iterations = 10);
+
+private:
+    static void drawVisibleTiles(const TileArrays& tiles);
 };
 
 #endif
\ No newline at end of file
@@ -2,12 +2,28 @@
 #define BATCH_RENDERER_CUBE_HPP
 // code greatly inspired by The Cherno
 #include <glm/glm.hpp>
+#include <functional>
+#include <vector>
+#include "graphics/batchVertex.hpp"
+#include "graphics/frustum.hpp"
 #include "graphics/shader.h"
+#include "graphics/streamBuffer.hpp"
+#include "graphics/textureArray.hpp"
+#include "graphics/vertexKernels.hpp"
+
+struct CubeInstance;
 
 class BatchRendererCube
 {
 public:
-    static void init();
+    // Batched expands every cube into 24 vertices on the cpu, Instanced uploads one
+    // record per cube and draws the whole batch with a single instanced call
+    enum class Mode{
+        Batched,
+        Instanced
+    };
+
+    static void init(UploadMode uploadMode = UploadMode::RingBuffer, Mode mode = Mode::Batched);
     static void shutdown();
 
     static void startBatch();
@@ -15,17 +31,65 @@ public:
     static void flush();
 
     static void drawCube(const glm::vec3& position, const glm::vec3& size, const glm::vec4& color);
-    static void drawCube(const glm::vec3& position, const glm::vec3& size, unsigned int textureID);
+    static void drawCube(const glm::vec3& position, const glm::vec3& size, const TextureLayer& texture);
+    // bulk version of drawCube, expanded with the sse kernels and split across the thread pool
+    static void drawCubes(const CubeArrays& cubes);
+
+    // one thread's slice of a batch built with drawParallel, writes 24 vertices or one
+    // instance record per cube depending on the mode into its own scratch
+    class CubeWriter{
+    public:
+        void drawCube(const glm::vec3& position, const glm::vec3& size, const glm::vec4& color);
+        void drawCube(const glm::vec3& position, const glm::vec3& size, const TextureLayer& texture);
+
+    private:
+        friend class BatchRendererCube;
+        // cubes from firstCube on sample page, until the next run
+        struct PageRun{
+            unsigned int firstCube;
+            uint16_t page;
+        };
+        void begin(unsigned int maxCubes, bool instanced);
+        uint16_t resolve(const TextureLayer& texture);
+        void write(const glm::vec3& position, const glm::vec3& size, uint32_t color, uint16_t textureIndex);
+
+        // kept between calls so the scratch is only allocated once
+        std::vector<BatchVertex> vertices;
+        std::vector<CubeInstance> instances;
+        std::vector<PageRun> runs;
+        bool instanced = false;
+        unsigned int cubeCount = 0;
+        unsigned int maxCubes = 0;
+        uint16_t texturePage = 0;
+        unsigned int culled = 0;
+    };
+
+    // builds cubeCount cubes on the thread pool, see BatchRenderer2D::drawParallel
+    static void drawParallel(unsigned int cubeCount, const std::function<void(CubeWriter& writer, unsigned int begin, unsigned int end)>& build);
+
+    // cubes entirely outside the frustum are dropped before they are written.
+    // pass a default constructed Frustum to turn culling off
+    static void setFrustum(const Frustum& frustum);
 
     static void setupShaderSampler(Shader& shader);
 
     struct Stats{
         unsigned int drawCalls = 0;
         unsigned int quadCount = 0;
+        unsigned int bytesUploaded = 0;
+        unsigned int bytesSaved = 0; // compared to the unpacked float vertex layout
+        unsigned int culled = 0;
     };
     
     static const Stats& getStats();
     static void resetStats();
+
+    // times batched drawCube and scalar code against expandCubes, and per cube isBoxVisible
+    // against cullCubes, on count random cubes and checks they agree. needs neither gl nor init()
+    static void benchmarkKernels(unsigned int count = 20000, unsigned int iterations = 10);
+
+private:
+    static void drawVisibleCubes(const CubeArrays& cubes);
 };
 
 #endif
\ No newline at end of file
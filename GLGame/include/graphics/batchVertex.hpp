@@ -0,0 +1,60 @@
+#ifndef BATCH_VERTEX_HPP
+#define BATCH_VERTEX_HPP
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// the batch renderers only emit axis aligned faces, so the normal is stored as an
+// index into this table. keep the order in sync with texQuadShader.vs
+enum NormalIndex : uint8_t{
+    NORMAL_POS_X,
+    NORMAL_NEG_X,
+    NORMAL_POS_Y,
+    NORMAL_NEG_Y,
+    NORMAL_POS_Z,
+    NORMAL_NEG_Z
+};
+
+// packed vertex shared by BatchRenderer2D and BatchRendererCube (24 bytes)
+struct BatchVertex{
+    glm::vec3 position;
+    uint32_t color;         // RGBA8
+    uint32_t texCoord;      // two half floats
+    uint16_t texIndex;
+    uint8_t normalIndex;
+    uint8_t padding;
+};
+
+// size of the old all-float vertex (vec3 + vec4 + vec2 + vec3 + float), used to report savings
+const unsigned int UNPACKED_VERTEX_SIZE = 52;
+
+inline uint32_t packColor(const glm::vec4& color){
+    return glm::packUnorm4x8(color);
+}
+
+inline uint32_t packTexCoord(float u, float v){
+    return glm::packHalf2x16(glm::vec2(u, v));
+}
+
+// expects the vao and the vertex buffer to be bound
+inline void setupBatchVertexAttributes(){
+    // position attribute
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (const void*)(offsetof(BatchVertex, position)));
+    glEnableVertexAttribArray(0);
+    // color attribute
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BatchVertex), (const void*)(offsetof(BatchVertex, color)));
+    glEnableVertexAttribArray(1);
+    // texture coord attribute
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(BatchVertex), (const void*)(offsetof(BatchVertex, texCoord)));
+    glEnableVertexAttribArray(2);
+    // texture index attribute
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_SHORT, sizeof(BatchVertex), (const void*)(offsetof(BatchVertex, texIndex)));
+    glEnableVertexAttribArray(3);
+    // normal index attribute
+    glVertexAttribIPointer(4, 1, GL_UNSIGNED_BYTE, sizeof(BatchVertex), (const void*)(offsetof(BatchVertex, normalIndex)));
+    glEnableVertexAttribArray(4);
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef BLOCK_COMPRESSION_HPP
+#define BLOCK_COMPRESSION_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// the block compressed formats gpus sample directly. every 4x4 pixel block becomes
+// 8 bytes (BC1, opaque rgb) or 16 bytes (BC3, rgb plus a separate alpha block, and
+// BC7, rgba at noticeably better quality)
+enum class BlockFormat : uint32_t{
+    BC1 = 1,
+    BC3 = 3,
+    BC7 = 7
+};
+
+// cpu encoder and decoder for the block formats, no gl involved. the encoders fit
+// endpoints along the block's principal axis and refine them by least squares;
+// BC7 only ever writes mode 6 (one subset, 4 bit indices, rgba endpoints)
+class BlockCompression{
+public:
+    static size_t getBlockBytes(BlockFormat format);
+    static size_t getImageBytes(BlockFormat format, int width, int height);
+    static const char* getName(BlockFormat format);
+
+    // rgba holds the block's 16 pixels row by row, 4 bytes each
+    static void encodeBlock(BlockFormat format, const uint8_t* rgba, uint8_t* block);
+    static void decodeBlock(BlockFormat format, const uint8_t* block, uint8_t* rgba);
+
+    // width x height RGBA8 pixels of any size, blocks on the right and top edge
+    // repeat the last column and row. encoding runs across the ThreadPool
+    static std::vector<uint8_t> encode(BlockFormat format, const uint8_t* rgba, int width, int height);
+    static std::vector<uint8_t> decode(BlockFormat format, const uint8_t* blocks, int width, int height);
+
+    // peak signal to noise ratio in dB over rgb, or rgba with alpha, of two RGBA8 images
+    static double psnr(const uint8_t* a, const uint8_t* b, size_t pixels, bool alpha);
+
+    // encodes an image iterations times in every format, reporting speed and psnr
+    static void benchmark(const std::string& imagePath, unsigned int iterations = 5);
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef COMPRESSED_TEXTURE_HPP
+#define COMPRESSED_TEXTURE_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "core/mappedFile.hpp"
+#include "graphics/blockCompression.hpp"
+#include "graphics/mipGenerator.hpp"
+
+struct CompressedTextureHeader;
+struct DecodedImage;
+
+// one mip level's blocks inside the file
+struct CompressedTextureLevel{
+    uint32_t offset;
+    uint32_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+// a texture cooked offline by texcook, in the spirit of ktx: a header with the
+// block format and a table of mip levels, then every level's blocks back to back,
+// largest first. rows are bottom up like ImageDecoder's, so the levels go straight
+// to glCompressedTexImage2D. the file is mapped, not read.
+class CompressedTexture{
+public:
+    static const uint32_t VERSION = 1;
+    static const uint32_t MAX_LEVELS = 16;
+
+    CompressedTexture() = default;
+    CompressedTexture(const CompressedTexture&) = delete;
+    CompressedTexture& operator=(const CompressedTexture&) = delete;
+
+    bool load(const std::string& path);
+    void close();
+    bool isLoaded() const { return header != nullptr; }
+
+    BlockFormat getFormat() const;
+    int getWidth() const;
+    int getHeight() const;
+    uint32_t getLevelCount() const;
+    CompressedTextureLevel getLevel(uint32_t level) const;
+    const uint8_t* getLevelData(uint32_t level) const;
+    // every level together, what the gpu keeps
+    size_t getBytes() const;
+
+    // encodes the image and its mip chain down to 1x1 and writes them to path.
+    // srgb is for colour, data like normal maps is filtered as it is
+    static bool cook(const DecodedImage& image, BlockFormat format, const std::string& path, MipFilter filter = MipFilter::Kaiser, bool srgb = true);
+    // files load() understands, by extension
+    static bool isCompressedPath(const std::string& path);
+
+private:
+    MappedFile file;
+    const CompressedTextureHeader* header = nullptr;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef COOKED_MESH_HPP
+#define COOKED_MESH_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "core/mappedFile.hpp"
+#include "physics/meshBvh.hpp"
+
+struct CookedMeshHeader;
+
+// a level of detail, a range of the shared index blob. error is how far, in model
+// units, the simplified surface may be from the original
+struct MeshLod{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+};
+
+// vertex layout of a cooked mesh, 16 bytes instead of the parser's 8 floats
+struct CookedVertex{
+    uint16_t position[3];   // unorm within the mesh bounds
+    uint16_t padding;
+    uint16_t texCoord[2];   // half floats
+    int16_t normal[2];      // snorm octahedral encoding
+};
+
+// binary copy of a parsed obj, stored next to it with a .mesh extension. the file
+// is a header followed by the CookedVertex blob and the index blob, uint16 when
+// every vertex fits and uint32 otherwise, laid out exactly as gl wants them, so a
+// warm load maps it and hands the blobs straight to glBufferData. the header carries the
+// obj's FNV-1a hash; when the obj changes the mesh is parsed and cooked again.
+// cooking also reorders triangles and vertices for the gpu and appends up to three
+// simplified levels of detail to the index blob, all indexing the same vertices.
+// the full detail level's bounding sphere and MeshBvh follow the indices.
+class CookedMesh{
+public:
+    static const uint32_t VERSION = 5;
+    static const uint32_t MAX_LODS = 4;
+
+    CookedMesh() = default;
+    CookedMesh(const CookedMesh&) = delete;
+    CookedMesh& operator=(const CookedMesh&) = delete;
+
+    // maps the cooked file for objPath, cooking it first when it is missing or stale
+    bool load(const std::string& objPath);
+    void close();
+
+    const CookedVertex* getVertices() const;
+    // uint16_t or uint32_t, see getIndexSize
+    const void* getIndices() const;
+    uint32_t getVertexCount() const;
+    uint32_t getIndexSize() const;
+    // all levels of detail together
+    uint32_t getIndexCount() const;
+    uint32_t getLodCount() const;
+    MeshLod getLod(uint32_t lod) const;
+    glm::vec3 getBoundsMin() const;
+    glm::vec3 getBoundsMax() const;
+    glm::vec3 getBoundingSphereCenter() const;
+    float getBoundingSphereRadius() const;
+    const BvhNode* getBvhNodes() const;
+    uint32_t getBvhNodeCount() const;
+    const BvhTriangle* getBvhTriangles() const;
+    uint32_t getBvhTriangleCount() const;
+    // false when the cooked file was up to date
+    bool wasCooked() const { return cooked; }
+
+    static std::string getCookedPath(const std::string& objPath);
+    static uint64_t hash(const char* data, size_t size);
+
+    // times a cold load (cache deleted, obj parsed and cooked) against warm loads
+    static void benchmark(const std::string& objPath, unsigned int iterations = 10);
+
+private:
+    bool cook(const std::string& objPath, const std::string& cookedPath, uint64_t sourceHash, uint64_t sourceSize);
+    const char* getBytes() const;
+
+    MappedFile file;
+    // the cooked image when it could not be written to disk
+    std::vector<char> image;
+    const CookedMeshHeader* header = nullptr;
+    bool cooked = false;
+};
+
+#endif
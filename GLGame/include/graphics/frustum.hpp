@@ -0,0 +1,37 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+#include <glm/glm.hpp>
+
+// the six planes of a view frustum in world space, normals pointing inwards.
+// a default constructed frustum contains everything, so culling is opt-in.
+class Frustum{
+public:
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    // extracts the planes from projection * view (Gribb/Hartmann)
+    void set(const glm::mat4& viewProjection);
+    bool isEnabled() const { return enabled; }
+
+    // false only when the box is completely outside one of the planes. the sse path
+    // tests four planes per instruction against the box center and extents
+    bool isBoxVisible(const glm::vec3& min, const glm::vec3& max) const;
+    // same for a box in model space placed by `transform`
+    bool isBoxVisible(const glm::vec3& min, const glm::vec3& max, const glm::mat4& transform) const;
+    bool isSphereVisible(const glm::vec3& center, float radius) const;
+
+    const glm::vec4& getPlane(int index) const { return planes[index]; }
+
+private:
+    bool enabled = false;
+    glm::vec4 planes[6];
+
+    // planes transposed into two groups of four for the sse test, the last two
+    // lanes hold planes every box passes
+    alignas(16) float planeX[8];
+    alignas(16) float planeY[8];
+    alignas(16) float planeZ[8];
+    alignas(16) float planeW[8];
+};
+
+#endif
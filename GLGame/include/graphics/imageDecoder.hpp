@@ -0,0 +1,41 @@
+#ifndef IMAGE_DECODER_HPP
+#define IMAGE_DECODER_HPP
+#include <string>
+#include <vector>
+
+// pixels stb_image decoded, flipped so the first row is the bottom one like gl
+// expects. owns them, so images move but don't copy
+struct DecodedImage{
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+
+    DecodedImage() = default;
+    DecodedImage(const DecodedImage&) = delete;
+    DecodedImage& operator=(const DecodedImage&) = delete;
+    DecodedImage(DecodedImage&& other) noexcept;
+    DecodedImage& operator=(DecodedImage&& other) noexcept;
+    ~DecodedImage();
+
+    bool isEmpty() const { return pixels == nullptr; }
+};
+
+// image decoding that is safe on any thread. stb's flip flag is set per thread,
+// never through the global one, so decodes can run side by side on the ThreadPool
+class ImageDecoder{
+public:
+    // channels 0 keeps the file's own, anything else converts to that many
+    static bool decode(const std::string& path, int channels, DecodedImage& image);
+    // only reads the header, for callers that decode the image later
+    static bool getSize(const std::string& path, int& width, int& height);
+
+    // decodes every path across the ThreadPool and returns the images in the
+    // same order. an image that failed comes back empty
+    static std::vector<DecodedImage> decodeAll(const std::vector<std::string>& paths, int channels);
+
+    // decodes the images in a directory iterations times, one after the other and across the pool
+    static void benchmark(const std::string& directory, unsigned int iterations = 10);
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+#include <cstddef>
+#include <vector>
+
+// cpu side reordering of indexed triangle meshes, run once when a mesh is cooked.
+// vertices are interleaved floats with the position in the first three.
+
+// average cache miss ratio: vertices transformed per triangle with a fifo
+// post transform cache of cacheSize entries. 0.5 is the ideal, 3 the worst.
+float computeACMR(const std::vector<int>& indices, size_t vertexCount, unsigned int cacheSize = 16);
+
+// reorders triangles for post transform cache hits (Forsyth's linear speed
+// optimizer with a simulated lru cache)
+void optimizeVertexCache(std::vector<int>& indices, size_t vertexCount);
+
+// splits the cache ordered triangles into clusters wherever the cache starts over
+// or the cluster is already about as cache efficient as the whole mesh, then draws
+// outward facing clusters first. acmr grows by at most `threshold`.
+void optimizeOverdraw(std::vector<int>& indices, const std::vector<float>& vertices, size_t floatsPerVertex, float threshold = 1.05f);
+
+// renumbers vertices in the order the indices first use them and drops unused ones
+void optimizeVertexFetch(std::vector<float>& vertices, std::vector<int>& indices, size_t floatsPerVertex);
+
+// quadric error metric edge collapses until about targetIndexCount indices are left.
+// collapses move one position onto a neighbouring one, so the result indexes the
+// same vertices and every level of detail can share one vertex buffer. returns the
+// largest collapse error, roughly a distance in model units.
+float simplifyMesh(std::vector<int>& destination, const std::vector<int>& indices, const std::vector<float>& vertices, size_t floatsPerVertex, size_t targetIndexCount);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef MIP_GENERATOR_HPP
+#define MIP_GENERATOR_HPP
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class MipFilter : uint8_t{
+    Box,    // average of the 2x2 texels underneath, cheap enough for load time
+    Kaiser  // 8 tap kaiser windowed sinc, sharper, for cooking
+};
+
+// one RGBA8 level of a mip chain
+struct MipLevel{
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// builds mip chains on the cpu, so every level is uploaded explicitly and comes
+// out the same on every driver. levels are filtered from the one above in float,
+// in linear light for srgb images, with colour weighted by alpha so transparent
+// texels don't bleed their colour into the edges. the sse2 path filters a whole
+// texel per instruction, other targets fall back to scalar code.
+class MipGenerator{
+public:
+    // every level below the width x height image down to 1x1, largest first
+    static std::vector<MipLevel> generate(const uint8_t* rgba, int width, int height, MipFilter filter = MipFilter::Box, bool srgb = true);
+    // levels of a full chain, the image itself included
+    static unsigned int getLevelCount(int width, int height);
+
+    // times both filters on an image, iterations times each
+    static void benchmark(const std::string& imagePath, unsigned int iterations = 10);
+};
+
+#endif
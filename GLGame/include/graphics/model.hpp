@@ -1,26 +1,90 @@
 #ifndef GLGAME_MODEL_HPP
 #define GLGAME_MODEL_HPP
 #include <glad/glad.h>
+#include <cstddef>
+#include <cstring>
+#include <memory>
 #include <vector>
-#include "objLoader.hpp"
+#include <glm/glm.hpp>
+#include "camera.h"
+#include "frustum.hpp"
+#include "cookedMesh.hpp"
+#include "resourceCache.hpp"
+#include "physics/meshBvh.hpp"
+#include "physics/raycast.hpp"
+#include "streamBuffer.hpp"
 #include "texture2D.hpp"
 #include "shader.h"
 
 class Model {
 public:
+    // a level of detail is used once its error projects to less than this many pixels
+    static constexpr float LOD_PIXEL_ERROR = 1.0f;
+    // transforms per instanced draw call, one segment of the ring all models share
+    static const unsigned int MAX_INSTANCES = 4096;
+
+    // triangles drawn since resetStats, all models together
+    struct Stats{
+        unsigned int drawCalls = 0;
+        unsigned int instances = 0;     // models drawn, every instance counts
+        unsigned int triangles = 0;
+        unsigned int lodDraws[CookedMesh::MAX_LODS] = {};   // models drawn at each level
+    };
+
     Model() = default;
     ~Model(){
+        destroy();
+    }
+    // owns its gl buffers, share models through ResourceCache instead of copying
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+    // releases the gl objects, call while the context is still alive
+    void destroy(){
+        // never loaded, gl may not even be initialized
+        if (vao == 0)
+            return;
         glDeleteVertexArrays(1, &vao);
         glDeleteBuffers(1, &vbo);
         glDeleteBuffers(1, &ibo);
+        vao = vbo = ibo = 0;
+        // the last model drawn instanced takes the shared ring with it
+        if (instancing && --sInstancingModels == 0)
+            sInstanceStream.destroy();
+        instancing = false;
+    }
+    void setTexture(const std::shared_ptr<Texture2D>& texture){
+        this->texture = texture;
     }
-    void setupShader(Shader& shader){
+    static void setupShader(Shader& shader){
         shader.setInt("u_texture", 0);
     }
 
     void load(std::string path, std::string texturePath, bool alphaOn){
-        texture = Texture2D{texturePath.c_str(), alphaOn};
-        OBJLoader::loadFromFile(path, vertexArray, indexArray);
+        texture = ResourceCache::getTexture(texturePath, alphaOn);
+
+        CookedMesh mesh;
+        if (!mesh.load(path))
+            return;
+        upload(mesh);
+    }
+
+    // the gl half of load. the mesh can be loaded on any thread, this runs on the
+    // one owning the context. the cooked mesh is mapped, its blobs go to gl without
+    // another copy and nothing of them stays on the cpu once the mesh is closed
+    void upload(const CookedMesh& mesh){
+        indexCount = mesh.getIndexCount();
+        indexSize = mesh.getIndexSize();
+        indexType = indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        lods.clear();
+        for (uint32_t i = 0; i < mesh.getLodCount(); i++)
+            lods.push_back(mesh.getLod(i));
+        boundsMin = mesh.getBoundsMin();
+        boundsMax = mesh.getBoundsMax();
+        sphereCenter = mesh.getBoundingSphereCenter();
+        sphereRadius = mesh.getBoundingSphereRadius();
+        bvh.assign(mesh.getBvhNodes(), mesh.getBvhNodeCount(), mesh.getBvhTriangles(), mesh.getBvhTriangleCount());
+        vertexBytes = sizeof(CookedVertex) * mesh.getVertexCount();
+        indexBytes = (size_t)indexSize * indexCount;
 
         glGenVertexArrays(1, &vao);
         glGenBuffers(1, &vbo);
@@ -29,36 +93,226 @@ public:
         glBindVertexArray(vao);
 
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertexArray.size(), vertexArray.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, mesh.getVertices(), GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(float) * indexArray.size(), indexArray.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, mesh.getIndices(), GL_STATIC_DRAW);
 
-        // position attribute
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (const void*)0);
+        // position attribute, fractions of the bounds, see setQuantization
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CookedVertex), (const void*)offsetof(CookedVertex, position));
         glEnableVertexAttribArray(0);
         // texture coord attribute
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (const void*)(3 * sizeof(float)));
+        glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CookedVertex), (const void*)offsetof(CookedVertex, texCoord));
         glEnableVertexAttribArray(1);
-        // normal vector attribute
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (const void*)(5 * sizeof(float)));
+        // normal vector attribute, octahedral
+        glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, sizeof(CookedVertex), (const void*)offsetof(CookedVertex, normal));
         glEnableVertexAttribArray(2);
     }
 
+    // the shader turns quantized positions back into model space with these. the
+    // shader must be in use, RenderQueue sets them before every model it draws
+    void setQuantization(Shader& shader) const{
+        shader.setVec3("positionMin", boundsMin);
+        shader.setVec3("positionExtent", boundsMax - boundsMin);
+    }
+
+    // full detail
     void draw() {
+        drawLod(0);
+    }
+
+    // the coarsest level whose error stays under LOD_PIXEL_ERROR on screen, from the
+    // distance to the camera and the projection's pixels per unit at that distance
+    void draw(const glm::mat4& transform, const Camera& camera, const glm::mat4& projection, float viewportHeight) {
+        drawLod(selectLod(transform, camera, projection, viewportHeight));
+    }
+
+    unsigned int selectLod(const glm::mat4& transform, const Camera& camera, const glm::mat4& projection, float viewportHeight) const{
+        glm::vec3 center = glm::vec3(transform * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        float scale = glm::max(glm::length(glm::vec3(transform[0])), glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+        float pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+        // perspective projections shrink with distance, orthographic ones don't
+        if (projection[3][3] == 0.0f)
+            pixelsPerUnit /= glm::max(glm::length(center - camera.Position), 0.0001f);
+
+        for (unsigned int lod = (unsigned int)lods.size(); lod-- > 1;)
+            if (lods[lod].error * scale * pixelsPerUnit <= LOD_PIXEL_ERROR)
+                return lod;
+        return 0;
+    }
+
+    void drawLod(unsigned int lod) {
+        if (lods.empty())
+            return;
+        lod = glm::min(lod, (unsigned int)lods.size() - 1);
         glActiveTexture(GL_TEXTURE0);
-        texture.bind();
+        if (texture)
+            texture->bind();
 
         glBindVertexArray(vao);
-        glDrawElements(GL_TRIANGLES, indexArray.size(), GL_UNSIGNED_INT, nullptr);
+        glDrawElements(GL_TRIANGLES, lods[lod].indexCount, indexType, (const void*)((size_t)indexSize * lods[lod].firstIndex));
+        countDraw(lod, 1);
+    }
+
+    // one copy per transform in as few draw calls as MAX_INSTANCES allows. the shader
+    // must read the transform per instance, see shaderInstanced.vs
+    void drawInstanced(const glm::mat4* transforms, size_t count, unsigned int lod = 0) {
+        if (lods.empty() || count == 0)
+            return;
+        lod = glm::min(lod, (unsigned int)lods.size() - 1);
+        if (!instancing)
+            initInstancing();
+
+        glActiveTexture(GL_TEXTURE0);
+        if (texture)
+            texture->bind();
+        glBindVertexArray(vao);
+        for (size_t first = 0; first < count; first += MAX_INSTANCES){
+            size_t batch = glm::min(count - first, (size_t)MAX_INSTANCES);
+            uint8_t* instances = sInstanceStream.map();
+            memcpy(instances, transforms + first, sizeof(glm::mat4) * batch);
+            sInstanceStream.unmap(sizeof(glm::mat4) * batch);
+
+            setupInstanceAttributes(sInstanceStream.getOffset());
+            glDrawElementsInstanced(GL_TRIANGLES, lods[lod].indexCount, indexType, (const void*)((size_t)indexSize * lods[lod].firstIndex), (GLsizei)batch);
+            sInstanceStream.fence();
+            countDraw(lod, (unsigned int)batch);
+        }
+    }
+
+    // every instance picks its level like draw(transform, ...) does, then each level
+    // is drawn instanced
+    void drawInstanced(const glm::mat4* transforms, size_t count, const Camera& camera, const glm::mat4& projection, float viewportHeight) {
+        for (std::vector<glm::mat4>& level : lodInstances)
+            level.clear();
+        for (size_t i = 0; i < count; i++)
+            lodInstances[selectLod(transforms[i], camera, projection, viewportHeight)].push_back(transforms[i]);
+        for (unsigned int lod = 0; lod < CookedMesh::MAX_LODS; lod++)
+            drawInstanced(lodInstances[lod].data(), lodInstances[lod].size(), lod);
+    }
+
+    unsigned int getLodCount() const{
+        return (unsigned int)lods.size();
+    }
+    unsigned int getLodTriangles(unsigned int lod) const{
+        return lod < lods.size() ? lods[lod].indexCount / 3 : 0;
+    }
+
+    static const Stats& getStats(){
+        return sStats;
+    }
+    static void resetStats(){
+        sStats = Stats{};
+    }
+
+    // vertex and index buffers, the instance ring is shared, see getInstanceBytes
+    size_t getGpuBytes() const{
+        return vertexBytes + indexBytes;
+    }
+    // the instance ring, allocated with the first instanced draw of any model
+    static size_t getInstanceBytes(){
+        return sInstancingModels > 0 ? sizeof(glm::mat4) * MAX_INSTANCES * StreamBuffer::SEGMENTS : 0;
+    }
+    size_t getVertexBytes() const{
+        return vertexBytes;
+    }
+    size_t getIndexBytes() const{
+        return indexBytes;
+    }
+    // the object itself, its levels of detail, its hierarchy for picking and the instance scratch arrays
+    size_t getCpuBytes() const{
+        size_t bytes = sizeof(Model) + lods.capacity() * sizeof(MeshLod) + bvh.getBytes();
+        for (const std::vector<glm::mat4>& level : lodInstances)
+            bytes += level.capacity() * sizeof(glm::mat4);
+        return bytes;
+    }
+
+    unsigned int getTextureID() const{
+        return texture ? texture->getID() : 0;
+    }
+
+    // model space bounding box of the loaded mesh
+    const glm::vec3& getBoundsMin() const{
+        return boundsMin;
+    }
+    const glm::vec3& getBoundsMax() const{
+        return boundsMax;
+    }
+
+    const glm::vec3& getBoundingSphereCenter() const{
+        return sphereCenter;
+    }
+    float getBoundingSphereRadius() const{
+        return sphereRadius;
+    }
+
+    bool isVisible(const Frustum& frustum, const glm::mat4& transform) const{
+        return frustum.isBoxVisible(boundsMin, boundsMax, transform);
+    }
+
+    // nearest triangle of the full detail mesh placed by `transform` along a world
+    // space ray. the ray moves into model space unnormalized, so the hit distance
+    // stays in units of the world direction's length
+    RayHit raycast(const Ray& ray, const glm::mat4& transform, float maxDistance = std::numeric_limits<float>::max()) const{
+        glm::mat4 inverse = glm::inverse(transform);
+        glm::vec3 origin = glm::vec3(inverse * glm::vec4(ray.origin, 1.0f));
+        glm::vec3 direction = glm::vec3(inverse * glm::vec4(ray.direction, 0.0f));
+        return bvh.raycast(origin, direction, maxDistance);
     }
 private:
-    unsigned int vao, vbo, ibo;
+    void countDraw(unsigned int lod, unsigned int instances){
+        sStats.drawCalls++;
+        sStats.instances += instances;
+        sStats.triangles += lods[lod].indexCount / 3 * instances;
+        sStats.lodDraws[lod] += instances;
+    }
+
+    // the transform takes locations 3 to 6, one column each
+    void initInstancing(){
+        if (sInstancingModels++ == 0)
+            sInstanceStream.init(sizeof(glm::mat4) * MAX_INSTANCES, UploadMode::RingBuffer);
+        instancing = true;
+        glBindVertexArray(vao);
+        setupInstanceAttributes(0);
+        for (unsigned int column = 0; column < 4; column++){
+            glEnableVertexAttribArray(3 + column);
+            glVertexAttribDivisor(3 + column, 1);
+        }
+    }
+
+    // re-pointed at the ring segment being drawn before every instanced call
+    void setupInstanceAttributes(size_t offset){
+        glBindBuffer(GL_ARRAY_BUFFER, sInstanceStream.getID());
+        for (unsigned int column = 0; column < 4; column++)
+            glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (const void*)(offset + sizeof(glm::vec4) * column));
+    }
+
+    unsigned int vao = 0, vbo = 0, ibo = 0;
+    // whether this model's vao reads transforms from the shared ring
+    bool instancing = false;
+    std::vector<glm::mat4> lodInstances[CookedMesh::MAX_LODS];
 
-    std::vector<float> vertexArray;
-    std::vector<int> indexArray;
+    unsigned int indexCount = 0;
+    unsigned int indexSize = sizeof(uint32_t);
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t vertexBytes = 0, indexBytes = 0;
+    std::vector<MeshLod> lods;
 
-    Texture2D texture;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 sphereCenter = glm::vec3(0.0f);
+    float sphereRadius = 0.0f;
+    MeshBvh bvh;
+
+    std::shared_ptr<Texture2D> texture;
+
+    static Stats sStats;
+    static StreamBuffer sInstanceStream;
+    static unsigned int sInstancingModels;
 };
 
+inline Model::Stats Model::sStats;
+inline StreamBuffer Model::sInstanceStream;
+inline unsigned int Model::sInstancingModels = 0;
+
 #endif
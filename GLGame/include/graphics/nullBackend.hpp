@@ -0,0 +1,37 @@
+#ifndef NULL_BACKEND_HPP
+#define NULL_BACKEND_HPP
+
+// a gl "driver" that draws nothing. load() points every glad function at a stub,
+// so the renderers run unchanged without a context or a gpu and the stubs record
+// what a frame would have cost the driver. object names, compile status, fences
+// and mapped buffer memory are faked well enough for the game to run; everything
+// else is a no-op, on x86-64 only (see nullProcAddress).
+//
+// there is no backend interface between the renderers and gl. swapping the glad
+// loader keeps every renderer calling gl directly, so headless runs the same code
+// a real context does.
+class NullBackend{
+public:
+    // replaces gladLoadGLLoader. the reported version picks the renderers' code paths,
+    // 4.4+ enables persistent mapped stream buffers
+    static bool load(int majorVersion = 4, int minorVersion = 6);
+
+    struct Stats{
+        unsigned int drawCalls = 0;
+        unsigned int instances = 0;         // instances drawn by instanced calls
+        unsigned int indices = 0;           // indices submitted, times instances
+        // buffer and texture data handed to gl, mapped ranges once flushed. writes into
+        // coherent persistent mappings never reach the driver and are not counted
+        unsigned int bytesUploaded = 0;
+        unsigned int bufferMaps = 0;
+        unsigned int stateChanges = 0;      // program, vao, texture, depth and enable state that actually changed
+        unsigned int redundantStateChanges = 0;
+        unsigned int textureBinds = 0;      // binds that changed a texture unit
+        unsigned int uniqueTextures = 0;    // distinct textures bound since resetStats
+    };
+
+    static const Stats& getStats();
+    static void resetStats();
+};
+
+#endif
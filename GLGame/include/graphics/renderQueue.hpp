@@ -0,0 +1,115 @@
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "graphics/frustum.hpp"
+#include "graphics/shader.h"
+#include "graphics/textureArray.hpp"
+#include "graphics/textureAtlas.hpp"
+
+class Camera;
+class Model;
+class TileLayer;
+
+enum class RenderPass : uint8_t{
+    Opaque,         // sorted front to back so early-z rejects hidden fragments
+    Overlay,        // drawn on top of opaque geometry at equal depth (GL_LEQUAL)
+    Transparent     // sorted back to front
+};
+
+// records a frame's draws, sorts them by a 64 bit key and replays them through
+// BatchRenderer2D, BatchRendererCube, TileLayer and Model. the key is, from the
+// most significant bit: pass, shader, renderer, material and quantized view depth,
+// so commands that share state end up next to each other.
+// view/projection uniforms must already be set on every shader before flush().
+class RenderQueue{
+public:
+    void begin(const glm::mat4& view, float farPlane);
+    // models outside the frustum are dropped at submission, tiles and cubes are
+    // culled by their batch renderers
+    void setFrustum(const Frustum& frustum);
+    // models pick their level of detail from this view and textured tiles and cubes ask
+    // TextureStreamer for the resolution they cover, without it both get full detail
+    void setCamera(const Camera& camera, const glm::mat4& projection, float viewportHeight);
+
+    void submitTile(RenderPass pass, Shader& shader, const glm::vec2& position, const glm::vec2& size, const glm::vec4& color);
+    void submitTile(RenderPass pass, Shader& shader, const glm::vec2& position, const glm::vec2& size, const TextureLayer& texture);
+    // the sprite is read at flush(), it has to live until then
+    void submitTile(RenderPass pass, Shader& shader, const glm::vec2& position, const glm::vec2& size, const AtlasSprite& sprite);
+    void submitCube(RenderPass pass, Shader& shader, const glm::vec3& position, const glm::vec3& size, const glm::vec4& color);
+    void submitCube(RenderPass pass, Shader& shader, const glm::vec3& position, const glm::vec3& size, const TextureLayer& texture);
+    void submitModel(RenderPass pass, Shader& shader, Model& model, const glm::mat4& transform);
+    // copies of one model in a single instanced draw per level of detail, the shader
+    // reads the transform per instance (shaderInstanced.vs). each copy is culled on its own
+    void submitModelInstances(RenderPass pass, Shader& shader, Model& model, const glm::mat4* instanceTransforms, size_t count);
+    void submitTileLayer(RenderPass pass, Shader& shader, TileLayer& layer);
+
+    // sorts and dispatches everything submitted since begin()
+    void flush();
+
+    // draw calls and shader/texture changes the frame needs in submission order
+    // versus sorted order, counted the way the batch renderers merge draws
+    struct Stats{
+        unsigned int commands = 0;
+        unsigned int culled = 0;
+        unsigned int unsortedDrawCalls = 0;
+        unsigned int sortedDrawCalls = 0;
+        unsigned int unsortedStateChanges = 0;
+        unsigned int sortedStateChanges = 0;
+    };
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    enum class Type : uint8_t{
+        Tile,
+        Cube,
+        TileLayer,
+        Model
+    };
+
+    struct Command{
+        Type type;
+        bool textured;
+        Shader* shader;
+        glm::vec3 position;
+        glm::vec3 size;
+        glm::vec4 color;
+        TextureLayer texture;
+        const AtlasSprite* sprite;      // tiles drawn from an atlas, the sprite's page is in texture
+        void* object;
+        unsigned int transformIndex;
+        unsigned int instanceCount;     // 0 for a model drawn on its own
+    };
+
+    void push(RenderPass pass, Shader& shader, Command& command, uint16_t material, const glm::vec3& center);
+    // textureSize is the world size one copy of the texture covers inside the box
+    void requestTexture(uint16_t page, const glm::vec3& min, const glm::vec3& max, float textureSize);
+    unsigned int shaderSlot(const Shader& shader);
+    void radixSort();
+    void countBatches(const std::vector<uint32_t>& order, unsigned int& drawCalls, unsigned int& stateChanges) const;
+    void dispatch();
+
+    glm::mat4 view = glm::mat4(1.0f);
+    float farPlane = 100.0f;
+    Frustum frustum;
+    const Camera* camera = nullptr;
+    glm::mat4 projection = glm::mat4(1.0f);
+    float viewportHeight = 0.0f;
+
+    std::vector<Command> commands;
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> order;
+    std::vector<glm::mat4> transforms;
+    std::vector<unsigned int> shaderIDs;
+
+    // radixSort's buffers, kept between flushes so sorting allocates nothing once they have grown
+    std::vector<uint64_t> sortedKeys;
+    std::vector<uint64_t> keyScratch;
+    std::vector<uint32_t> orderScratch;
+
+    Stats stats;
+};
+
+#endif
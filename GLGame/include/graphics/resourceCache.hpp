@@ -0,0 +1,49 @@
+#ifndef RESOURCE_CACHE_HPP
+#define RESOURCE_CACHE_HPP
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "graphics/textureArray.hpp"
+
+class Model;
+class Shader;
+class Texture2D;
+
+// resources shared by everyone who asks for the same file with the same parameters.
+// the cache only holds weak references: a resource is freed, gpu memory included,
+// when its last handle goes away, and loaded again by the next request for it.
+// main thread only, every resource here lives on the gl context.
+class ResourceCache{
+public:
+    // get* loads on a miss. find* never loads, add* hands over a resource loaded
+    // elsewhere and returns the cached one instead when it was loaded meanwhile
+    static std::shared_ptr<TextureLayer> getTextureLayer(const std::string& path);
+    static std::shared_ptr<TextureLayer> findTextureLayer(const std::string& path);
+    static std::shared_ptr<TextureLayer> addTextureLayer(const std::string& path, const TextureLayer& texture);
+    // getTextureLayer for many paths
+    static std::vector<std::shared_ptr<TextureLayer>> getTextureLayers(const std::vector<std::string>& paths);
+
+    static std::shared_ptr<Texture2D> getTexture(const std::string& path, bool alphaOn);
+    static std::shared_ptr<Texture2D> findTexture(const std::string& path, bool alphaOn);
+    static std::shared_ptr<Texture2D> addTexture(const std::string& path, bool alphaOn, Texture2D&& texture);
+
+    static std::shared_ptr<Shader> getShader(const std::string& vertexPath, const std::string& fragmentPath);
+
+    // the mesh and its texture, which comes from getTexture
+    static std::shared_ptr<Model> getModel(const std::string& objPath, const std::string& texturePath, bool alphaOn);
+    static std::shared_ptr<Model> findModel(const std::string& objPath, const std::string& texturePath, bool alphaOn);
+    static std::shared_ptr<Model> addModel(const std::string& objPath, const std::string& texturePath, bool alphaOn, const std::shared_ptr<Model>& model);
+
+    // hits are requests served from the cache, misses the loads it had to do.
+    // resident counts what is alive right now; bytes are gpu estimates, shaders count as 0
+    struct Stats{
+        unsigned int hits = 0;
+        unsigned int misses = 0;
+        unsigned int resident = 0;
+        size_t residentBytes = 0;
+    };
+    static Stats getStats();
+};
+
+#endif
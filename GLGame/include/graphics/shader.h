@@ -5,6 +5,7 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <utility>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -12,8 +13,25 @@
 class Shader
 {
 public:
-    unsigned int ID;
+    unsigned int ID = 0;
     Shader(){}
+    ~Shader()
+    {
+        if (ID != 0)
+            glDeleteProgram(ID);
+    }
+    // the program is owned, so shaders move but don't copy
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+    Shader(Shader&& other) noexcept : ID(other.ID)
+    {
+        other.ID = 0;
+    }
+    Shader& operator=(Shader&& other) noexcept
+    {
+        std::swap(ID, other.ID);
+        return *this;
+    }
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath)
@@ -0,0 +1,51 @@
+#ifndef STREAM_BUFFER_HPP
+#define STREAM_BUFFER_HPP
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+
+// how a StreamBuffer moves a batch from the cpu to the gpu
+enum class UploadMode{
+    BufferSubData,  // cpu staging array copied with glBufferSubData every batch
+    Orphan,         // cpu staging array, storage orphaned before every copy so the driver never waits
+    RingBuffer      // batches written in place into a triple-buffered ring guarded by fences
+};
+
+// a vertex buffer the cpu can write the next batch into while the gpu is still
+// reading the previous ones. in RingBuffer mode the buffer is split into SEGMENTS
+// slices; it stays persistently mapped when the driver has GL 4.4 buffer storage
+// and is mapped unsynchronized per batch otherwise.
+class StreamBuffer{
+public:
+    static const unsigned int SEGMENTS = 3;
+
+    void init(size_t segmentSize, UploadMode mode);
+    void destroy();
+
+    // writable memory for the next batch, at most segmentSize bytes
+    uint8_t* map();
+    // hands the first `size` bytes written since map() to the gpu
+    void unmap(size_t size);
+    // call after the draw that reads the current segment
+    void fence();
+
+    // byte offset of the current segment inside the buffer
+    size_t getOffset() const { return segmentIndex * segmentSize; }
+    unsigned int getID() const { return vbo; }
+    bool isPersistent() const { return persistentPtr != nullptr; }
+
+private:
+    void waitForSegment();
+
+    UploadMode mode = UploadMode::BufferSubData;
+    unsigned int vbo = 0;
+    size_t segmentSize = 0;
+    unsigned int segmentIndex = 0;
+
+    uint8_t* staging = nullptr;
+    uint8_t* persistentPtr = nullptr;
+    uint8_t* mappedPtr = nullptr;
+    GLsync fences[SEGMENTS] = {};
+};
+
+#endif
@@ -2,9 +2,12 @@
 #define TEX_QUAD_BATCH_HPP
 #include <glad/glad.h>
 #include <array>
+#include <memory>
+#include <vector>
 #include "shader.h"
 #include "graphics/camera.h"
-#include "texture2D.hpp"
+#include "textureArray.hpp"
+#include "resourceCache.hpp"
 
 class TexQuadBatch{
 public:
@@ -16,15 +19,15 @@ public:
         glm::vec3 Position;
         glm::vec4 Color;
         glm::vec2 TexCoords;
-        float TexID;
+        unsigned int TexID;
     };
 private:
-    std::array<TexQuadBatch::TexQuadVertex, 4> createQuad(float x, float y, float sizeX, float sizeY, float textureID);
-    Shader shader;
+    std::array<TexQuadBatch::TexQuadVertex, 4> createQuad(float x, float y, float sizeX, float sizeY, unsigned int textureID);
+    std::shared_ptr<Shader> shader;
     unsigned int VAO, VBO, EBO;
     unsigned int maxQuads = 250;
-    Texture2D texture1{"resources/container.jpg", false};
-    Texture2D texture2{"resources/awesomeface.png", true};
+    // the same images Game draws, loaded once between the two
+    std::vector<std::shared_ptr<TextureLayer>> textures = ResourceCache::getTextureLayers({"resources/container.jpg", "resources/awesomeface.png"});
 };
 
 #endif
\ No newline at end of file
@@ -1,39 +1,62 @@
 #ifndef TEXTURE_2D_HPP
 #define TEXTURE_2D_HPP
 #include <glad/glad.h>
+#include <cstring>
 #include <string>
-#include <iostream>
-#include "graphics/stb_image.h"
+#include <utility>
+#include <vector>
+#include "graphics/blockCompression.hpp"
+#include "graphics/compressedTexture.hpp"
+#include "graphics/imageDecoder.hpp"
+#include "graphics/mipGenerator.hpp"
+
+// from EXT_texture_compression_s3tc, which glad only knows as an extension
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
 
 class Texture2D{
 public:
     Texture2D(){}
+    ~Texture2D(){
+        destroy();
+    }
+    // the gl texture is owned, so textures move but don't copy
+    Texture2D(const Texture2D&) = delete;
+    Texture2D& operator=(const Texture2D&) = delete;
+    Texture2D(Texture2D&& other) noexcept : textureID(other.textureID), width(other.width), height(other.height), bytes(other.bytes){
+        other.textureID = 0;
+    }
+    Texture2D& operator=(Texture2D&& other) noexcept{
+        std::swap(textureID, other.textureID);
+        std::swap(width, other.width);
+        std::swap(height, other.height);
+        std::swap(bytes, other.bytes);
+        return *this;
+    }
     Texture2D(const char* path, bool alphaOn){
-        glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        // set the texture wrapping parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        // set texture filtering parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        // load image, create texture and generate mipmaps
-        int width, height, nrChannels;
-        stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
-        unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
-        if (data)
-        {   
-            if(!alphaOn)
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            else
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
+        // cooked textures bring their format and mipmaps, alphaOn doesn't apply
+        if (CompressedTexture::isCompressedPath(path)){
+            CompressedTexture texture;
+            if (texture.load(path))
+                create(texture);
+            return;
         }
-        else
-        {
-            std::cout << "Failed to load texture" << std::endl;
-        }
-        stbi_image_free(data);
+        // load image, create texture and its mipmaps
+        DecodedImage image;
+        ImageDecoder::decode(path, 4, image);
+        create(image.pixels, image.width, image.height, MipGenerator::generate(image.pixels, image.width, image.height), alphaOn);
+    }
+    // a texture texcook cooked, its levels uploaded as they are
+    Texture2D(const CompressedTexture& texture){
+        create(texture);
+    }
+    // an RGBA8 image and its mip chain made elsewhere, e.g. on a loader thread
+    Texture2D(const DecodedImage& image, const std::vector<MipLevel>& mips, bool alphaOn){
+        create(image.pixels, image.width, image.height, mips, alphaOn);
     }
     Texture2D(unsigned int color){
         // create a default white texture
@@ -44,6 +67,8 @@ public:
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &color);
+        width = height = 1;
+        bytes = 4;
     }
     unsigned int getID() const{
         return textureID;
@@ -52,10 +77,113 @@ public:
         glBindTexture(GL_TEXTURE_2D, textureID);
     }
     void destroy(){
-        glDeleteTextures(1, &textureID);
+        if (textureID != 0)
+            glDeleteTextures(1, &textureID);
+        textureID = 0;
+    }
+    size_t getBytes() const{
+        return textureID != 0 ? bytes : 0;
+    }
+
+    static unsigned int getCompressedFormat(BlockFormat format){
+        switch (format){
+        case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BlockFormat::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        }
+        return 0;
+    }
+    // bptc is core since 4.2, s3tc never made it into core but desktop drivers all have it
+    static bool isCompressedFormatSupported(BlockFormat format){
+        if (!sFormatSupport.queried)
+            queryFormatSupport();
+        return format == BlockFormat::BC7 ? sFormatSupport.bptc : sFormatSupport.s3tc;
+    }
+    // walks the context's extension list once, isCompressedFormatSupported answers from
+    // what it found. call it again after loading the functions of a new context
+    static void queryFormatSupport(){
+        sFormatSupport = FormatSupport{};
+        sFormatSupport.queried = true;
+        sFormatSupport.bptc = GLAD_GL_VERSION_4_2 != 0;
+        int count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (int i = 0; i < count; i++){
+            const char* name = (const char*)glGetStringi(GL_EXTENSIONS, (unsigned int)i);
+            if (!name)
+                continue;
+            if (strcmp(name, "GL_ARB_texture_compression_bptc") == 0)
+                sFormatSupport.bptc = true;
+            if (strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+                sFormatSupport.s3tc = true;
+        }
     }
 private:
-    unsigned int textureID;
+    // RGBA8 pixels, every level uploaded as given instead of left to glGenerateMipmap.
+    // without alphaOn the texture drops the alpha channel
+    void create(const unsigned char* data, int width, int height, const std::vector<MipLevel>& mips, bool alphaOn){
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        // set the texture wrapping parameters
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        // set texture filtering parameters
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mips.empty() ? GL_LINEAR : GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)mips.size());
+        if (data)
+        {
+            this->width = width;
+            this->height = height;
+            int format = alphaOn ? GL_RGBA8 : GL_RGB8;
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            for (size_t i = 0; i < mips.size(); i++)
+                glTexImage2D(GL_TEXTURE_2D, (int)i + 1, format, mips[i].width, mips[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, mips[i].pixels.data());
+            // drivers pad rgb to four bytes
+            bytes = (size_t)width * height * 4;
+            for (const MipLevel& level : mips)
+                bytes += level.pixels.size();
+        }
+    }
+    void create(const CompressedTexture& texture){
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)texture.getLevelCount() - 1);
+        width = texture.getWidth();
+        height = texture.getHeight();
+
+        // without the format the blocks are decoded here, the texture still works at rgba8's size
+        unsigned int format = getCompressedFormat(texture.getFormat());
+        bool supported = isCompressedFormatSupported(texture.getFormat());
+        bytes = 0;
+        for (uint32_t i = 0; i < texture.getLevelCount(); i++){
+            CompressedTextureLevel level = texture.getLevel(i);
+            if (supported){
+                glCompressedTexImage2D(GL_TEXTURE_2D, (int)i, format, (int)level.width, (int)level.height, 0, (int)level.size, texture.getLevelData(i));
+                bytes += level.size;
+            } else {
+                std::vector<uint8_t> rgba = BlockCompression::decode(texture.getFormat(), texture.getLevelData(i), (int)level.width, (int)level.height);
+                glTexImage2D(GL_TEXTURE_2D, (int)i, GL_RGBA8, (int)level.width, (int)level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+                bytes += rgba.size();
+            }
+        }
+    }
+
+    unsigned int textureID = 0;
+    int width = 0, height = 0;
+    size_t bytes = 0;
+
+    struct FormatSupport{
+        bool queried = false;
+        bool bptc = false;
+        bool s3tc = false;
+    };
+    static FormatSupport sFormatSupport;
 };
 
+inline Texture2D::FormatSupport Texture2D::sFormatSupport;
+
 #endif
\ No newline at end of file
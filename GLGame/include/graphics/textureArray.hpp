@@ -0,0 +1,77 @@
+#ifndef TEXTURE_ARRAY_HPP
+#define TEXTURE_ARRAY_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "graphics/mipGenerator.hpp"
+
+struct DecodedImage;
+
+// a texture stored as one layer of a GL_TEXTURE_2D_ARRAY. textures of the same size
+// share a page (one array texture), so a batch only has to break when it switches
+// pages. layer 0 of every page is plain white, which lets untextured draws use
+// whatever page the batch already has bound.
+struct TextureLayer{
+    uint16_t page = 0;
+    uint16_t layer = 0;
+};
+
+class TextureManager{
+public:
+    static void init();
+    static void shutdown();
+
+    static const int STREAMING_START_SIZE = 64;
+
+    // a layer of the streamed page matching the image's size, see add with a source
+    static TextureLayer load(const char* path);
+    // width x height RGBA8 pixels already decoded, e.g. on a loader thread. every
+    // level is uploaded, mips either built here or handed in from MipGenerator
+    static TextureLayer add(const unsigned char* pixels, int width, int height);
+    static TextureLayer add(const unsigned char* pixels, int width, int height, const std::vector<MipLevel>& mips);
+    // same, with only the first levelCount levels of the chain. for images whose
+    // smaller mips would mix unrelated texels, like the sprites of an atlas page
+    static TextureLayer add(const unsigned char* pixels, int width, int height, unsigned int levelCount);
+    // a layer of a streamed page for the image at source, which only gets decoded
+    // once the layer is drawn. the page starts with only its levels of
+    // STREAMING_START_SIZE and below resident, the layer is white until
+    // TextureStreamer streams it in
+    static TextureLayer add(int width, int height, const std::string& source);
+    // reads the sizes of all images and adds them as above. a failed image gets the white layer
+    static std::vector<TextureLayer> loadAll(const std::vector<std::string>& paths);
+    // the layer is reused by the next add of the same size. a page whose layers
+    // are all released is deleted, its index stays reserved for a new page
+    static void release(const TextureLayer& texture);
+    // one layer of the page with its resident mipmaps
+    static size_t getLayerBytes(uint16_t page);
+
+    // streaming, driven by TextureStreamer. a streamed page only keeps the levels
+    // from its resident level down in gl, the finer ones are decoded again from the
+    // layers' sources when they are needed
+    static bool isStreamed(uint16_t page);
+    // size of level 0 and the levels the page has of its chain
+    static int getWidth(uint16_t page);
+    static int getHeight(uint16_t page);
+    static unsigned int getLevelCount(uint16_t page);
+    static unsigned int getResidentLevel(uint16_t page);
+    // the level a new streamed page starts at, the one the page never goes below
+    static unsigned int getStartLevel(uint16_t page);
+    // the page's whole array texture with level as its top level
+    static size_t getPageBytes(uint16_t page, unsigned int level);
+    // by layer, empty for the white layer and released layers
+    static std::vector<std::string> getSources(uint16_t page);
+    // by layer, the ones added but not streamed in yet
+    static std::vector<bool> getPendingLayers(uint16_t page);
+    static bool hasPendingLayers(uint16_t page);
+    // recreates the page's array with level as its top level, the levels both arrays
+    // have are copied over on the gpu. new finer ones, and every level of a pending
+    // layer, come from images and their mips, decoded from getSources and indexed by layer
+    static void setResidentLevel(uint16_t page, unsigned int level, const std::vector<DecodedImage>& images, const std::vector<std::vector<MipLevel>>& mips);
+
+    // GL name of a page, stable lookup even after the page was grown
+    static unsigned int getArrayID(uint16_t page);
+    static unsigned int getPageCount();
+};
+
+#endif
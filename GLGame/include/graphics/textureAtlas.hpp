@@ -0,0 +1,42 @@
+#ifndef TEXTURE_ATLAS_HPP
+#define TEXTURE_ATLAS_HPP
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "graphics/textureArray.hpp"
+
+// a sub-rect of an atlas page. the batch renderers write texCoords as they are,
+// the corners of the rect packed like BatchVertex in quad order 00, 10, 11, 01
+struct AtlasSprite{
+    TextureLayer texture;
+    glm::vec2 uvMin = glm::vec2(0.0f);
+    glm::vec2 uvMax = glm::vec2(1.0f);
+    uint32_t texCoords[4] = {};
+};
+
+// sprites packed offline by atlaspack (see AtlasPacker). every page becomes a layer
+// of one texture array page, so everything drawn from an atlas can share a batch.
+// the pages are fully resident, an atlas is never streamed
+class TextureAtlas{
+public:
+    TextureAtlas() = default;
+    ~TextureAtlas();
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    bool load(const std::string& path);
+    void destroy();
+
+    // nullptr for a name the atlas doesn't have
+    const AtlasSprite* find(const std::string& name) const;
+    size_t getSpriteCount() const { return sprites.size(); }
+    size_t getPageCount() const { return pages.size(); }
+
+private:
+    std::vector<TextureLayer> pages;
+    std::unordered_map<std::string, AtlasSprite> sprites;
+};
+
+#endif
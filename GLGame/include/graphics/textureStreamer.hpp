@@ -0,0 +1,48 @@
+#ifndef TEXTURE_STREAMER_HPP
+#define TEXTURE_STREAMER_HPP
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// raises and lowers the resolution of streamed texture pages (TextureManager::add
+// with a source). draws report how large their page shows up on screen, update()
+// then decodes the missing levels, and the layers nothing was decoded for yet, on
+// the ThreadPool and uploads them a frame or more later. when the streamed pages go
+// over the budget the top levels of the pages used longest ago are dropped, a page is
+// never dropped below the level it started at.
+class TextureStreamer{
+public:
+    static const size_t DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+    // bytes of array texture memory for the streamed pages. pages that are always
+    // fully resident, the white page and atlases, can't be evicted and don't count
+    static void setBudget(size_t bytes);
+    static size_t getBudget();
+
+    // the page is drawn this frame covering screenPixels pixels per texture width
+    static void request(uint16_t page, float screenPixels);
+    // pixels a worldSize long edge covers at distance from the eye
+    static float getScreenSize(float worldSize, float distance, const glm::mat4& projection, float viewportHeight);
+
+    // uploads finished decodes, starts new ones for this frame's requests and evicts
+    // down to the budget. once a frame on the main thread, after the draws were submitted
+    static void update();
+
+    // waits for the decodes still running and drops what they made
+    static void shutdown();
+
+    struct Stats{
+        size_t budgetBytes = 0;
+        size_t residentBytes = 0;       // streamed pages, held to the budget
+        size_t fixedBytes = 0;          // pages that are never streamed, outside the budget
+        unsigned int streamIns = 0;
+        unsigned int evictions = 0;
+        unsigned int pending = 0;
+        // from starting a page's decode to its upload
+        double averageLatencyMilliseconds = 0.0;
+        double longestLatencyMilliseconds = 0.0;
+    };
+    static Stats getStats();
+};
+
+#endif
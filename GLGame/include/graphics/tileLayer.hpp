@@ -0,0 +1,96 @@
+#ifndef TILE_LAYER_HPP
+#define TILE_LAYER_HPP
+#include <glm/glm.hpp>
+#include <functional>
+#include <vector>
+#include "graphics/batchVertex.hpp"
+#include "graphics/frustum.hpp"
+#include "graphics/shader.h"
+#include "graphics/textureArray.hpp"
+#include "graphics/textureAtlas.hpp"
+
+// a grid of floor tiles that lives on the gpu. the mesh is built once, split into
+// CHUNK_SIZE x CHUNK_SIZE chunks laid out contiguously in the vertex buffer, and
+// setTile only re-uploads the dirty range of the chunk it touches. draw with the
+// same shader as BatchRenderer2D. all textured tiles must come from one texture page,
+// the sprites of one atlas do, so a whole map of tile art draws from one page.
+class TileLayer{
+public:
+    static constexpr unsigned int CHUNK_SIZE = 16;
+
+    TileLayer() = default;
+    ~TileLayer();
+    TileLayer(const TileLayer&) = delete;
+    TileLayer& operator=(const TileLayer&) = delete;
+
+    void init(unsigned int width, unsigned int height, float tileSize);
+    void destroy();
+    void setupShaderSampler(Shader& shader);
+
+    void setTile(unsigned int x, unsigned int y, const glm::vec4& color);
+    void setTile(unsigned int x, unsigned int y, const TextureLayer& texture);
+    void setTile(unsigned int x, unsigned int y, const AtlasSprite& sprite);
+    // rebuilds every tile on the thread pool and uploads the mesh in one go.
+    // colorAt is called from worker threads
+    void fill(const std::function<glm::vec4(unsigned int x, unsigned int y)>& colorAt);
+
+    // chunks outside the frustum are skipped, visible neighbours are merged into
+    // one range of a single glMultiDrawElements
+    void setFrustum(const Frustum& frustum);
+
+    // uploads whatever changed since the last call and draws the visible chunks
+    void draw();
+
+    unsigned int getWidth() const { return width; }
+    unsigned int getHeight() const { return height; }
+    float getTileSize() const { return tileSize; }
+    uint16_t getTexturePage() const { return texturePage; }
+
+    struct Stats{
+        unsigned int drawCalls = 0;
+        unsigned int chunksUpdated = 0;
+        unsigned int tilesUploaded = 0;
+        unsigned int bytesUploaded = 0;
+        unsigned int chunksCulled = 0;
+        // setTile calls since init whose texture was on another page than the layer's,
+        // drawn white instead. resetStats keeps this one
+        unsigned int otherPageTiles = 0;
+    };
+
+    const Stats& getStats() const { return renderStats; }
+    void resetStats();
+
+private:
+    struct Chunk{
+        unsigned int firstTile;     // index of the chunk's first tile in the vertex buffer
+        unsigned int width, height;
+        unsigned int dirtyBegin, dirtyEnd;  // local tile range waiting for upload, empty when begin >= end
+    };
+
+    unsigned int chunkIndex(unsigned int x, unsigned int y) const;
+    BatchVertex* tileVertices(unsigned int x, unsigned int y, Chunk** chunk);
+    // texCoords nullptr is the whole layer
+    void writeTile(unsigned int x, unsigned int y, uint32_t color, uint16_t textureIndex, const uint32_t* texCoords = nullptr);
+    void uploadDirtyChunks();
+    void buildChunks(const std::function<glm::vec4(unsigned int x, unsigned int y)>& colorAt);
+
+    unsigned int width = 0, height = 0;
+    unsigned int chunksX = 0, chunksY = 0;
+    float tileSize = 1.0f;
+
+    unsigned int vao = 0, vbo = 0, ibo = 0;
+
+    std::vector<BatchVertex> vertices;
+    std::vector<Chunk> chunks;
+    std::vector<unsigned int> dirtyChunks;
+
+    Frustum frustum;
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void*> drawOffsets;
+
+    uint16_t texturePage = 0;
+
+    Stats renderStats;
+};
+
+#endif
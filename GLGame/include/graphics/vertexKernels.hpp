@@ -0,0 +1,69 @@
+#ifndef VERTEX_KERNELS_HPP
+#define VERTEX_KERNELS_HPP
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "graphics/batchVertex.hpp"
+#include "graphics/frustum.hpp"
+
+// structure of arrays input for the bulk draw calls. every array holds `count`
+// entries; colors, textureLayers and rotations may be null (white, untextured,
+// unrotated). all textured entries sample layers of the same texturePage.
+struct TileArrays{
+    size_t count = 0;
+    const float* x = nullptr;
+    const float* y = nullptr;
+    const float* width = nullptr;
+    const float* height = nullptr;
+    const uint32_t* colors = nullptr;           // packColor values
+    const uint16_t* textureLayers = nullptr;
+    const float* rotations = nullptr;
+    uint16_t texturePage = 0;
+};
+
+struct CubeArrays{
+    size_t count = 0;
+    const float* x = nullptr;
+    const float* y = nullptr;
+    const float* z = nullptr;
+    const float* width = nullptr;
+    const float* height = nullptr;
+    const float* depth = nullptr;
+    const uint32_t* colors = nullptr;
+    const uint16_t* textureLayers = nullptr;
+    uint16_t texturePage = 0;
+};
+
+// compacted copies of the entries that survived culling, reused between calls
+struct TileScratch{
+    std::vector<float> x, y, width, height, rotations;
+    std::vector<uint32_t> colors;
+    std::vector<uint16_t> textureLayers;
+};
+
+struct CubeScratch{
+    std::vector<float> x, y, z, width, height, depth;
+    std::vector<uint32_t> colors;
+    std::vector<uint16_t> textureLayers;
+};
+
+// returns arrays holding only the entries inside the frustum, backed by scratch. the
+// sse2 and neon paths test four entries per iteration, read straight from the arrays
+TileArrays cullTiles(const TileArrays& tiles, const Frustum& frustum, TileScratch& scratch);
+CubeArrays cullCubes(const CubeArrays& cubes, const Frustum& frustum, CubeScratch& scratch);
+
+// bounds of a tile on the floor plane, rotated tiles use the box around their circle
+void tileBounds(float x, float y, float width, float height, bool rotated, glm::vec3& min, glm::vec3& max);
+
+// expand entries [first, first + count) into 4 (tiles) or 24 (cubes) vertices each,
+// written to `out` in the same order drawTile and drawCube emit them. the sse2 and
+// neon (arm64) paths handle four tiles per iteration, other targets fall back to
+// scalar code.
+void expandTiles(BatchVertex* out, const TileArrays& tiles, size_t first, size_t count);
+void expandCubes(BatchVertex* out, const CubeArrays& cubes, size_t first, size_t count);
+void expandCube(BatchVertex* out, const glm::vec3& position, const glm::vec3& size, uint32_t color, uint16_t textureIndex);
+// expandCube without simd, what other targets run. --bench-kernels checks the kernels against it
+void expandCubeScalar(BatchVertex* out, const glm::vec3& position, const glm::vec3& size, uint32_t color, uint16_t textureIndex);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef MESH_BVH_HPP
+#define MESH_BVH_HPP
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// 32 bytes, two to a cache line. interior nodes (count 0) have their first child
+// right after them and the second at offset; leaves hold triangles [offset, offset + count)
+struct BvhNode{
+    float boundsMin[3];
+    uint32_t offset;
+    float boundsMax[3];
+    uint32_t count;
+};
+
+// a triangle ready for Moller-Trumbore, stored in leaf order so a leaf's
+// triangles are contiguous. index is the triangle's place in the mesh's full detail level
+struct BvhTriangle{
+    float vertex[3];
+    float edge1[3];
+    float edge2[3];
+    uint32_t index;
+};
+
+struct RayHit{
+    bool hit = false;
+    float distance = std::numeric_limits<float>::max();
+    uint32_t triangle = 0;
+    // weights of the triangle's second and third vertex
+    glm::vec2 barycentric = glm::vec2(0.0f);
+};
+
+// bounding volume hierarchy over a mesh's triangles, built top down with the
+// binned surface area heuristic and stored depth first in one array
+class MeshBvh{
+public:
+    static const unsigned int SAH_BINS = 12;
+    static const unsigned int MAX_LEAF_TRIANGLES = 8;
+
+    // vertices are interleaved floats with the position in the first three
+    void build(const std::vector<float>& vertices, size_t floatsPerVertex, const int* indices, size_t indexCount);
+    // takes over a hierarchy build() laid out earlier, e.g. from a cooked mesh
+    void assign(const BvhNode* nodes, size_t nodeCount, const BvhTriangle* triangles, size_t triangleCount);
+    void clear();
+
+    // nearest hit in [0, maxDistance). distances are in units of direction's length
+    RayHit raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance = std::numeric_limits<float>::max()) const;
+    // every triangle, no hierarchy. the reference raycast() is measured against
+    RayHit raycastBruteForce(const glm::vec3& origin, const glm::vec3& direction, float maxDistance = std::numeric_limits<float>::max()) const;
+
+    const std::vector<BvhNode>& getNodes() const { return nodes; }
+    const std::vector<BvhTriangle>& getTriangles() const { return triangles; }
+    bool isEmpty() const { return nodes.empty(); }
+    size_t getBytes() const { return nodes.capacity() * sizeof(BvhNode) + triangles.capacity() * sizeof(BvhTriangle); }
+
+    // rays from around the bounding sphere at the mesh, traced through the cooked
+    // mesh's hierarchy and by brute force
+    static void benchmark(const std::string& objPath, unsigned int rays = 100000);
+
+private:
+    std::vector<BvhNode> nodes;
+    std::vector<BvhTriangle> triangles;
+};
+
+#endif
@@ -1,5 +1,12 @@
 #ifndef GLGAME_RAYCAST_HPP
 #define GLGAME_RAYCAST_HPP
+#include <glm/glm.hpp>
+
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
 
 class Raycast
 {
@@ -30,6 +37,10 @@ public:
     glm::vec3 getRay(){
         return ray;
     }
+    // the mouse ray starting at the camera
+    Ray getRay(glm::vec3 origin) const{
+        return Ray{origin, ray};
+    }
 
 private:
     glm::vec3 ray = glm::vec3(0, 0, 1);
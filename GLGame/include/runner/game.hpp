@@ -9,22 +9,38 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "core/threadPool.hpp"
 #include "graphics/shader.h"
 #include "graphics/camera.h"
 #include "graphics/texture2D.hpp"
+#include "graphics/textureArray.hpp"
+#include "graphics/textureAtlas.hpp"
+#include "graphics/textureStreamer.hpp"
 #include "graphics/texQuadBatch.hpp"
 #include "graphics/batchRenderer2D.hpp"
 #include "graphics/batchRendererCube.hpp"
+#include "graphics/tileLayer.hpp"
+#include "graphics/renderQueue.hpp"
+#include "graphics/nullBackend.hpp"
+#include "graphics/assetLoader.hpp"
+#include "graphics/resourceCache.hpp"
 
+#include <chrono>
 #include <iostream>
 #include <entt/entity/registry.hpp>
 
 class Game{
 public:
-    Game();
+    // headless runs on the null gl backend, with no window or gpu
+    Game(bool headless = false);
     void setupWindow();
+    void setupHeadless();
 
     void runMainGameLoop();
+    // renders `frames` frames as fast as possible and reports cpu time and driver work per frame
+    void runHeadless(unsigned int frames);
+    // extra foxes spread over the floor, all drawn by one instanced call
+    void setHerdSize(unsigned int size);
 
     void cleanup();
 
@@ -33,19 +49,36 @@ public:
     static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 private:
     GLFWwindow* window = nullptr;
+    bool headless = false;
 
-    Shader shader;
-    Shader modelLoaderShader;
-    Shader debugDepthQuad;
+    std::shared_ptr<Shader> shader;
+    std::shared_ptr<Shader> cubeShader;
+    std::shared_ptr<Shader> modelLoaderShader;
+    std::shared_ptr<Shader> modelInstancedShader;
+    std::shared_ptr<Shader> debugDepthQuad;
 
-    Texture2D crateTexture;
-    Texture2D awesomeFaceTexture;
-    Texture2D foxTexture;
+    AssetHandle<std::shared_ptr<TextureLayer>> crateTexture;
+    AssetHandle<std::shared_ptr<TextureLayer>> awesomeFaceTexture;
+    AssetHandle<std::shared_ptr<Model>> fox;
+
+    TileLayer floorTiles;
+    TextureAtlas spriteAtlas;
+    std::vector<glm::mat4> herd;
+    unsigned int herdSize = 0;
+    RenderQueue renderQueue;
 
     double lastTime, deltaTime, fpsTimer = 0;
     unsigned int fps = 0;
 
+    // milliseconds from the constructor to the first finished frame and to the
+    // first frame with every asset loaded, negative until then
+    std::chrono::steady_clock::time_point startTime;
+    double firstFrameMilliseconds = -1.0;
+    double assetsReadyMilliseconds = -1.0;
+
     void renderScene();
+    void endFrame();
+    double getTime() const;
 
     void processInput(GLFWwindow* window);
 };
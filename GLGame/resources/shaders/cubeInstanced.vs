@@ -0,0 +1,33 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in uint aTexIndex;
+layout (location = 4) in uint aNormalIndex;
+layout (location = 5) in vec3 aCubePosition;
+layout (location = 6) in vec3 aCubeSize;
+
+out vec4 vColor;
+out vec2 vTexCoord;
+flat out uint vTexIndex;
+out vec3 vNormal;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// same order as NormalIndex in batchVertex.hpp
+const vec3 normals[6] = vec3[6](
+    vec3(1, 0, 0), vec3(-1, 0, 0),
+    vec3(0, 1, 0), vec3(0, -1, 0),
+    vec3(0, 0, 1), vec3(0, 0, -1)
+);
+
+void main()
+{
+    vColor = aColor;
+    vTexCoord = aTexCoord;
+    vTexIndex = aTexIndex;
+    vNormal = normals[aNormalIndex];
+    gl_Position = projection * view * model * vec4(aCubePosition + aPos * aCubeSize, 1.0);
+}
\ No newline at end of file
@@ -1,7 +1,7 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
-layout (location = 2) in vec3 aNormal;
+layout (location = 2) in vec2 aNormal;
 
 out vec2 vTexCoord;
 out vec3 vNormal;
@@ -11,9 +11,21 @@ uniform mat4 view;
 uniform mat4 projection;
 uniform mat3 normalMatrix;
 
+// quantized attributes, see CookedVertex
+uniform vec3 positionMin;
+uniform vec3 positionExtent;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main()
 {
     vTexCoord = aTexCoord;
-    vNormal = normalMatrix * aNormal;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vNormal = normalMatrix * decodeOctahedral(aNormal);
+    gl_Position = projection * view * model * vec4(positionMin + aPos * positionExtent, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec2 aNormal;
+layout (location = 3) in mat4 aModel;
+
+out vec2 vTexCoord;
+out vec3 vNormal;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// quantized attributes, see CookedVertex
+uniform vec3 positionMin;
+uniform vec3 positionExtent;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    // the cofactor matrix is the normal matrix times the determinant, the fragment shader
+    // normalizes. the determinant's sign is put back so mirrored transforms keep their normals
+    mat3 m = mat3(aModel);
+    vec3 c0 = cross(m[1], m[2]);
+    mat3 normalMatrix = mat3(c0, cross(m[2], m[0]), cross(m[0], m[1])) * sign(dot(m[0], c0));
+
+    vTexCoord = aTexCoord;
+    vNormal = normalMatrix * decodeOctahedral(aNormal);
+    gl_Position = projection * view * aModel * vec4(positionMin + aPos * positionExtent, 1.0);
+}
@@ -0,0 +1,71 @@
+#include "core/mappedFile.hpp"
+
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_MMAP
+#endif
+
+bool MappedFile::open(const std::string& path){
+    close();
+
+#ifdef MAPPED_FILE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0){
+        ::close(fd);
+        return false;
+    }
+    size = (size_t)info.st_size;
+    opened = true;
+    // empty files can't be mapped, they are simply open with no data
+    if (size > 0){
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED){
+            madvise(view, size, MADV_SEQUENTIAL);
+            data = (const char*)view;
+            mapped = true;
+        }
+    }
+    ::close(fd);
+    if (mapped || size == 0)
+        return true;
+#endif
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file){
+        close();
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    buffer.resize(length > 0 ? (size_t)length : 0);
+    size_t read = buffer.empty() ? 0 : fread(buffer.data(), 1, buffer.size(), file);
+    fclose(file);
+
+    buffer.resize(read);
+    size = read;
+    data = buffer.empty() ? nullptr : buffer.data();
+    opened = true;
+    return true;
+}
+
+void MappedFile::close(){
+#ifdef MAPPED_FILE_MMAP
+    if (mapped)
+        munmap((void*)data, size);
+#endif
+    data = nullptr;
+    size = 0;
+    opened = false;
+    mapped = false;
+    buffer.clear();
+    buffer.shrink_to_fit();
+}
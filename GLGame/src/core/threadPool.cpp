@@ -0,0 +1,130 @@
+#include "core/threadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct PoolData{
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+static PoolData sData;
+
+static void workerLoop(){
+    while (true){
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(sData.mutex);
+            sData.wake.wait(lock, []{ return sData.stopping || !sData.jobs.empty(); });
+            if (sData.jobs.empty())
+                return;
+            job = std::move(sData.jobs.front());
+            sData.jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void ThreadPool::init(unsigned int threadCount){
+    if (!sData.workers.empty())
+        return;
+    if (threadCount == 0){
+        unsigned int hardware = std::thread::hardware_concurrency();
+        threadCount = hardware > 1 ? hardware - 1 : 0;
+    }
+
+    sData.stopping = false;
+    for (unsigned int i = 0; i < threadCount; i++)
+        sData.workers.emplace_back(workerLoop);
+}
+
+void ThreadPool::shutdown(){
+    {
+        std::lock_guard<std::mutex> lock(sData.mutex);
+        sData.stopping = true;
+    }
+    sData.wake.notify_all();
+    for (std::thread& worker : sData.workers)
+        worker.join();
+    sData.workers.clear();
+}
+
+unsigned int ThreadPool::getThreadCount(){
+    return (unsigned int)sData.workers.size() + 1;
+}
+
+void ThreadPool::submit(std::function<void()> job){
+    if (sData.workers.empty()){
+        job();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sData.mutex);
+        sData.jobs.push_back(std::move(job));
+    }
+    sData.wake.notify_one();
+}
+
+unsigned int ThreadPool::getRangeCount(size_t count, size_t minRange){
+    if (count == 0)
+        return 0;
+    size_t ranges = (count + std::max<size_t>(minRange, 1) - 1) / std::max<size_t>(minRange, 1);
+    return (unsigned int)std::min<size_t>(ranges, getThreadCount());
+}
+
+// one parallelFor call. whoever runs ranges claims them from next, so the caller
+// only ever runs its own ranges and never some other queued job
+struct ParallelRun{
+    std::atomic<unsigned int> next{0};
+    unsigned int ranges = 0;
+    size_t count = 0;
+    // only used after a successful claim, which parallelFor waits for before returning
+    const std::function<void(unsigned int range, size_t begin, size_t end)>* body = nullptr;
+
+    std::mutex mutex;
+    std::condition_variable done;
+    unsigned int finished = 0;
+};
+
+static void runRanges(ParallelRun& run){
+    auto rangeBegin = [&](unsigned int range){ return run.count * range / run.ranges; };
+    unsigned int range;
+    while ((range = run.next.fetch_add(1)) < run.ranges){
+        (*run.body)(range, rangeBegin(range), rangeBegin(range + 1));
+        std::lock_guard<std::mutex> lock(run.mutex);
+        if (++run.finished == run.ranges)
+            run.done.notify_all();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t minRange, const std::function<void(unsigned int range, size_t begin, size_t end)>& body){
+    unsigned int ranges = getRangeCount(count, minRange);
+    if (ranges == 0)
+        return;
+    if (ranges == 1){
+        body(0, 0, count);
+        return;
+    }
+
+    // a helper that gets to run after the caller claimed everything finds nothing
+    // left and only drops its reference
+    auto run = std::make_shared<ParallelRun>();
+    run->ranges = ranges;
+    run->count = count;
+    run->body = &body;
+    for (unsigned int helper = 1; helper < ranges; helper++)
+        submit([run]{ runRanges(*run); });
+
+    runRanges(*run);
+    std::unique_lock<std::mutex> lock(run->mutex);
+    run->done.wait(lock, [&]{ return run->finished == ranges; });
+}
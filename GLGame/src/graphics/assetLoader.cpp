@@ -0,0 +1,222 @@
+#include "graphics/assetLoader.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include "core/threadPool.hpp"
+#include "graphics/compressedTexture.hpp"
+#include "graphics/cookedMesh.hpp"
+#include "graphics/imageDecoder.hpp"
+#include "graphics/mipGenerator.hpp"
+#include "graphics/resourceCache.hpp"
+
+// loads still on their way by cache key, only touched on the main thread
+template <typename T>
+using PendingLoads = std::unordered_map<std::string, std::weak_ptr<Asset<T>>>;
+
+struct LoaderData{
+    std::mutex mutex;
+    std::condition_variable idle;
+    // gl work, only ever run by update() on the main thread
+    std::deque<std::function<void()>> uploads;
+    unsigned int decoding = 0;
+    std::atomic<unsigned int> pending{0};
+    PendingLoads<std::shared_ptr<TextureLayer>> pendingTextures;
+    PendingLoads<std::shared_ptr<Model>> pendingModels;
+    AssetLoader::Stats stats;
+};
+
+static LoaderData sData;
+
+// RGBA8 pixels and their mip chain, both made on the worker and freed with the
+// last closure that holds them
+struct TextureImage{
+    DecodedImage image;
+    std::vector<MipLevel> mips;
+};
+
+static std::shared_ptr<TextureImage> decodeImage(const std::string& path){
+    auto texture = std::make_shared<TextureImage>();
+    if (!ImageDecoder::decode(path, 4, texture->image))
+        return nullptr;
+    texture->mips = MipGenerator::generate(texture->image.pixels, texture->image.width, texture->image.height);
+    return texture;
+}
+
+static void beginLoad(){
+    sData.pending++;
+    std::lock_guard<std::mutex> lock(sData.mutex);
+    sData.decoding++;
+}
+
+template <typename T>
+static void finish(Asset<T>& asset, AssetState state){
+    asset.state.store(state, std::memory_order_release);
+    sData.pending--;
+}
+
+// already in the cache, nothing to load
+template <typename T>
+static AssetHandle<T> loaded(T value){
+    auto asset = std::make_shared<Asset<T>>();
+    asset->value = std::move(value);
+    asset->state.store(AssetState::Ready, std::memory_order_release);
+    return asset;
+}
+
+// a second request for something still loading gets the first one's handle. a failed
+// load is forgotten, so the next request tries again
+template <typename T>
+static AssetHandle<T> findPending(PendingLoads<T>& loads, const std::string& key){
+    auto it = loads.find(key);
+    if (it == loads.end())
+        return nullptr;
+    AssetHandle<T> asset = it->second.lock();
+    if (asset && asset->state.load(std::memory_order_acquire) != AssetState::Failed)
+        return asset;
+    loads.erase(it);
+    return nullptr;
+}
+
+// ends a worker's part of a load, queueing its upload unless it failed. the handle
+// moves into the queue, so a worker never drops the last reference to gl objects
+template <typename T>
+static void endDecode(AssetHandle<T> asset, std::function<void(Asset<T>&)> upload){
+    if (upload)
+        asset->state.store(AssetState::Uploading, std::memory_order_release);
+    else
+        finish(*asset, AssetState::Failed);
+
+    std::lock_guard<std::mutex> lock(sData.mutex);
+    if (upload){
+        sData.uploads.push_back([asset = std::move(asset), upload = std::move(upload)]{
+            upload(*asset);
+            finish(*asset, AssetState::Ready);
+        });
+    }
+    if (--sData.decoding == 0)
+        sData.idle.notify_all();
+}
+
+void AssetLoader::shutdown(){
+    std::unique_lock<std::mutex> lock(sData.mutex);
+    sData.idle.wait(lock, []{ return sData.decoding == 0; });
+    sData.pending -= (unsigned int)sData.uploads.size();
+    sData.uploads.clear();
+    sData.pendingTextures.clear();
+    sData.pendingModels.clear();
+}
+
+AssetHandle<std::shared_ptr<TextureLayer>> AssetLoader::loadTexture(const std::string& path){
+    if (std::shared_ptr<TextureLayer> texture = ResourceCache::findTextureLayer(path))
+        return loaded(texture);
+    if (AssetHandle<std::shared_ptr<TextureLayer>> pending = findPending(sData.pendingTextures, path))
+        return pending;
+
+    auto asset = std::make_shared<Asset<std::shared_ptr<TextureLayer>>>();
+    AssetHandle<std::shared_ptr<TextureLayer>> result = asset;
+    sData.pendingTextures[path] = asset;
+    beginLoad();
+    // the layer is streamed, TextureStreamer decodes it once it is drawn. only the
+    // header is read here, for the size of the page it goes to
+    ThreadPool::submit([asset, path]() mutable{
+        int width, height;
+        if (!ImageDecoder::getSize(path, width, height)){
+            endDecode<std::shared_ptr<TextureLayer>>(std::move(asset), nullptr);
+            return;
+        }
+        endDecode<std::shared_ptr<TextureLayer>>(std::move(asset), [path, width, height](Asset<std::shared_ptr<TextureLayer>>& asset){
+            asset.value = ResourceCache::addTextureLayer(path, TextureManager::add(width, height, path));
+            sData.pendingTextures.erase(path);
+        });
+    });
+    return result;
+}
+
+AssetHandle<std::shared_ptr<Model>> AssetLoader::loadModel(const std::string& objPath, const std::string& texturePath, bool alphaOn){
+    if (std::shared_ptr<Model> model = ResourceCache::findModel(objPath, texturePath, alphaOn))
+        return loaded(model);
+    std::string key = objPath + "|" + texturePath + (alphaOn ? "|rgba" : "|rgb");
+    if (AssetHandle<std::shared_ptr<Model>> pending = findPending(sData.pendingModels, key))
+        return pending;
+    // only whether it is cached goes to the worker, never the handle itself
+    bool decodeTexture = ResourceCache::findTexture(texturePath, alphaOn) == nullptr;
+
+    auto asset = std::make_shared<Asset<std::shared_ptr<Model>>>();
+    AssetHandle<std::shared_ptr<Model>> result = asset;
+    sData.pendingModels[key] = asset;
+    beginLoad();
+    ThreadPool::submit([asset, objPath, texturePath, alphaOn, decodeTexture, key]() mutable{
+        // a stale or missing cache is parsed and cooked right here, on the worker.
+        // cooked textures only get mapped, their blocks go to gl as they are
+        auto mesh = std::make_shared<CookedMesh>();
+        std::shared_ptr<TextureImage> image;
+        std::shared_ptr<CompressedTexture> compressed;
+        if (decodeTexture && CompressedTexture::isCompressedPath(texturePath)){
+            compressed = std::make_shared<CompressedTexture>();
+            if (!compressed->load(texturePath))
+                compressed = nullptr;
+        } else if (decodeTexture){
+            image = decodeImage(texturePath);
+        }
+        if (!mesh->load(objPath) || (decodeTexture && !image && !compressed)){
+            endDecode<std::shared_ptr<Model>>(std::move(asset), nullptr);
+            return;
+        }
+        endDecode<std::shared_ptr<Model>>(std::move(asset), [objPath, texturePath, alphaOn, mesh, image, compressed, key](Asset<std::shared_ptr<Model>>& asset){
+            // a texture that was cached when the load started may have been freed since
+            std::shared_ptr<Texture2D> texture;
+            if (image)
+                texture = ResourceCache::addTexture(texturePath, alphaOn, Texture2D{image->image, image->mips, alphaOn});
+            else if (compressed)
+                texture = ResourceCache::addTexture(texturePath, alphaOn, Texture2D{*compressed});
+            else
+                texture = ResourceCache::getTexture(texturePath, alphaOn);
+            auto model = std::make_shared<Model>();
+            model->setTexture(texture);
+            model->upload(*mesh);
+            asset.value = ResourceCache::addModel(objPath, texturePath, alphaOn, model);
+            sData.pendingModels.erase(key);
+        });
+    });
+    return result;
+}
+
+void AssetLoader::update(double budgetMilliseconds){
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&]{
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    while (true){
+        std::function<void()> upload;
+        {
+            std::lock_guard<std::mutex> lock(sData.mutex);
+            if (sData.uploads.empty())
+                break;
+            upload = std::move(sData.uploads.front());
+            sData.uploads.pop_front();
+        }
+        upload();
+        sData.stats.uploads++;
+        if (elapsed() >= budgetMilliseconds)
+            break;
+    }
+
+    double spent = elapsed();
+    sData.stats.uploadMilliseconds += spent;
+    sData.stats.longestUpdateMilliseconds = std::max(sData.stats.longestUpdateMilliseconds, spent);
+}
+
+unsigned int AssetLoader::getPendingCount(){
+    return sData.pending.load();
+}
+
+const AssetLoader::Stats& AssetLoader::getStats(){
+    return sData.stats;
+}
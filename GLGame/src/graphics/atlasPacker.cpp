@@ -0,0 +1,271 @@
+#include "graphics/atlasPacker.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include "core/threadPool.hpp"
+#include "graphics/imageDecoder.hpp"
+
+static const char MAGIC[4] = {'G', 'L', 'G', 'A'};
+static const uint32_t PAGE_ALIGNMENT = 16;
+
+struct PackRect{
+    int x, y, width, height;
+};
+
+static bool contains(const PackRect& outer, const PackRect& inner){
+    return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.width <= outer.x + outer.width && inner.y + inner.height <= outer.y + outer.height;
+}
+
+// one page's free space as the list of every maximal empty rect. they overlap, a
+// placement is cut out of each one it touches
+class MaxRectsBin{
+public:
+    MaxRectsBin(int width, int height) : freeRects{{0, 0, width, height}} {}
+
+    bool insert(int width, int height, PackRect& placed){
+        int bestShortSide = INT_MAX, bestLongSide = INT_MAX;
+        for (const PackRect& free : freeRects){
+            if (free.width < width || free.height < height)
+                continue;
+            int shortSide = std::min(free.width - width, free.height - height);
+            int longSide = std::max(free.width - width, free.height - height);
+            if (shortSide < bestShortSide || (shortSide == bestShortSide && longSide < bestLongSide)){
+                placed = PackRect{free.x, free.y, width, height};
+                bestShortSide = shortSide;
+                bestLongSide = longSide;
+            }
+        }
+        if (bestShortSide == INT_MAX)
+            return false;
+
+        std::vector<PackRect> split;
+        for (const PackRect& free : freeRects){
+            if (placed.x >= free.x + free.width || placed.x + placed.width <= free.x || placed.y >= free.y + free.height || placed.y + placed.height <= free.y){
+                split.push_back(free);
+                continue;
+            }
+            if (placed.x > free.x)
+                split.push_back({free.x, free.y, placed.x - free.x, free.height});
+            if (placed.x + placed.width < free.x + free.width)
+                split.push_back({placed.x + placed.width, free.y, free.x + free.width - placed.x - placed.width, free.height});
+            if (placed.y > free.y)
+                split.push_back({free.x, free.y, free.width, placed.y - free.y});
+            if (placed.y + placed.height < free.y + free.height)
+                split.push_back({free.x, placed.y + placed.height, free.width, free.y + free.height - placed.y - placed.height});
+        }
+
+        // a rect inside another adds nothing
+        freeRects.clear();
+        for (size_t i = 0; i < split.size(); i++){
+            bool redundant = false;
+            for (size_t j = 0; j < split.size() && !redundant; j++)
+                redundant = i != j && contains(split[j], split[i]) && (!contains(split[i], split[j]) || j < i);
+            if (!redundant)
+                freeRects.push_back(split[i]);
+        }
+        return true;
+    }
+
+private:
+    std::vector<PackRect> freeRects;
+};
+
+static int nextPowerOfTwo(int value){
+    int power = 1;
+    while (power < value)
+        power *= 2;
+    return power;
+}
+
+// every rect not marked NOT_PACKED on one width x height page, placements only
+// written when all of them fit
+static bool packPage(const std::vector<glm::ivec2>& sizes, const std::vector<size_t>& order, int width, int height, AtlasLayout& layout){
+    MaxRectsBin bin(width, height);
+    std::vector<AtlasPlacement> placements = layout.placements;
+    for (size_t i : order){
+        PackRect placed;
+        if (placements[i].page == AtlasPacker::NOT_PACKED)
+            continue;
+        if (!bin.insert(sizes[i].x, sizes[i].y, placed))
+            return false;
+        placements[i] = AtlasPlacement{0, placed.x, placed.y};
+    }
+    layout.placements.swap(placements);
+    layout.pageWidth = width;
+    layout.pageHeight = height;
+    return true;
+}
+
+static int alignUp(int value, int alignment){
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+AtlasLayout AtlasPacker::pack(const std::vector<glm::ivec2>& sizes, int maxPageSize, int alignment){
+    AtlasLayout layout;
+    layout.placements.resize(sizes.size());
+    alignment = std::max(alignment, 1);
+
+    // biggest first, small rects fill the gaps they leave
+    std::vector<size_t> order(sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){
+        int sideA = std::max(sizes[a].x, sizes[a].y), sideB = std::max(sizes[b].x, sizes[b].y);
+        return sideA != sideB ? sideA > sideB : sizes[a].x * sizes[a].y > sizes[b].x * sizes[b].y;
+    });
+
+    glm::ivec2 largest = glm::ivec2(alignment);
+    long long area = 0;
+    for (size_t i : order){
+        if (sizes[i].x > maxPageSize || sizes[i].y > maxPageSize){
+            layout.placements[i].page = NOT_PACKED;
+            continue;
+        }
+        largest = glm::max(largest, sizes[i]);
+        area += (long long)sizes[i].x * sizes[i].y;
+    }
+
+    // the single page with the least area that holds everything. every width is
+    // tried, each with the lowest height that fits found by bisection
+    int minWidth = alignUp(largest.x, alignment), minHeight = alignUp(largest.y, alignment);
+    long long bestArea = LLONG_MAX;
+    AtlasLayout best;
+    for (int width = minWidth; width <= maxPageSize && (long long)width * minHeight < bestArea; width += alignment){
+        // only heights that beat the best page so far are worth a try
+        AtlasLayout candidate = layout;
+        int high = (int)std::min<long long>(maxPageSize, (bestArea - 1) / width) / alignment;
+        if (high * alignment < minHeight || !packPage(sizes, order, width, high * alignment, candidate))
+            continue;
+        // heights counted in alignment steps, the lowest that fits lies in [low, high]
+        int low = std::max(minHeight, (int)std::min<long long>((area + width - 1) / width, maxPageSize)) / alignment;
+        while (low < high){
+            int middle = low + (high - low) / 2;
+            if (packPage(sizes, order, width, middle * alignment, candidate))
+                high = middle;
+            else
+                low = middle + 1;
+        }
+        packPage(sizes, order, width, high * alignment, candidate);
+        bestArea = (long long)width * high * alignment;
+        best = candidate;
+    }
+    if (bestArea != LLONG_MAX){
+        best.pageCount = sizes.empty() ? 0 : 1;
+        return best;
+    }
+    layout.pageWidth = layout.pageHeight = maxPageSize;
+
+    // full size pages, each rect goes to the first one with room
+    std::vector<MaxRectsBin> bins;
+    for (size_t i : order){
+        if (layout.placements[i].page == NOT_PACKED)
+            continue;
+        PackRect placed;
+        size_t page = 0;
+        while (page < bins.size() && !bins[page].insert(sizes[i].x, sizes[i].y, placed))
+            page++;
+        if (page == bins.size()){
+            bins.emplace_back(maxPageSize, maxPageSize);
+            bins.back().insert(sizes[i].x, sizes[i].y, placed);
+        }
+        layout.placements[i] = AtlasPlacement{(uint16_t)page, placed.x, placed.y};
+    }
+    layout.pageCount = (unsigned int)bins.size();
+    return layout;
+}
+
+static std::string getSpriteName(const std::string& path){
+    size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+bool AtlasPacker::cook(const std::vector<std::string>& imagePaths, const std::string& path, int maxPageSize, int gutter, int padding){
+    std::vector<DecodedImage> images = ImageDecoder::decodeAll(imagePaths, 4);
+    int alignment = nextPowerOfTwo(std::max(gutter, 1));
+    std::vector<glm::ivec2> cells(images.size());
+    for (size_t i = 0; i < images.size(); i++){
+        if (images[i].isEmpty())
+            return false;
+        if (getSpriteName(imagePaths[i]).size() >= sizeof(AtlasSpriteRecord::name)){
+            std::cout << "sprite name too long: " << imagePaths[i] << std::endl;
+            return false;
+        }
+        glm::ivec2 size = glm::ivec2(images[i].width, images[i].height) + 2 * gutter + padding;
+        cells[i] = (size + alignment - 1) / alignment * alignment;
+    }
+
+    AtlasLayout layout = pack(cells, maxPageSize, alignment);
+    for (size_t i = 0; i < images.size(); i++){
+        if (layout.placements[i].page == NOT_PACKED){
+            std::cout << "sprite doesn't fit a " << maxPageSize << " page: " << imagePaths[i] << std::endl;
+            return false;
+        }
+    }
+
+    AtlasFileHeader header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.pageWidth = (uint32_t)layout.pageWidth;
+    header.pageHeight = (uint32_t)layout.pageHeight;
+    header.pageCount = layout.pageCount;
+    header.spriteCount = (uint32_t)images.size();
+    size_t recordsEnd = sizeof(AtlasFileHeader) + sizeof(AtlasSpriteRecord) * images.size();
+    header.pageOffset = (uint32_t)((recordsEnd + PAGE_ALIGNMENT - 1) / PAGE_ALIGNMENT * PAGE_ALIGNMENT);
+    header.levelCount = 1;
+    while ((1 << header.levelCount) <= alignment)
+        header.levelCount++;
+
+    size_t pageBytes = (size_t)layout.pageWidth * layout.pageHeight * 4;
+    std::vector<uint8_t> file(header.pageOffset + pageBytes * layout.pageCount, 0);
+    memcpy(file.data(), &header, sizeof(header));
+
+    // sprites don't overlap, so they are copied in parallel. the gutter repeats the
+    // nearest edge texel, what bilinear filtering and the smaller mips read past the edge
+    ThreadPool::parallelFor(images.size(), 1, [&](unsigned int, size_t begin, size_t end){
+        for (size_t i = begin; i < end; i++){
+            const DecodedImage& image = images[i];
+            const AtlasPlacement& placement = layout.placements[i];
+            uint8_t* page = file.data() + header.pageOffset + pageBytes * placement.page;
+            for (int y = -gutter; y < image.height + gutter; y++){
+                int sourceY = std::min(std::max(y, 0), image.height - 1);
+                uint8_t* row = page + ((size_t)(placement.y + gutter + y) * layout.pageWidth + placement.x + gutter) * 4;
+                for (int x = -gutter; x < image.width + gutter; x++){
+                    int sourceX = std::min(std::max(x, 0), image.width - 1);
+                    memcpy(row + x * 4, image.pixels + ((size_t)sourceY * image.width + sourceX) * 4, 4);
+                }
+            }
+
+            AtlasSpriteRecord record{};
+            std::string name = getSpriteName(imagePaths[i]);
+            memcpy(record.name, name.c_str(), name.size());
+            record.page = placement.page;
+            record.x = (uint32_t)(placement.x + gutter);
+            record.y = (uint32_t)(placement.y + gutter);
+            record.width = (uint32_t)image.width;
+            record.height = (uint32_t)image.height;
+            memcpy(file.data() + sizeof(AtlasFileHeader) + sizeof(AtlasSpriteRecord) * i, &record, sizeof(record));
+        }
+    });
+
+    // same as the other cooked files, written aside and renamed so a half written file never loads
+    std::string temporaryPath = path + ".tmp";
+    FILE* out = fopen(temporaryPath.c_str(), "wb");
+    if (!out){
+        std::cout << "unable to write atlas: " << path << std::endl;
+        return false;
+    }
+    bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+    written = fclose(out) == 0 && written;
+    std::remove(path.c_str());
+    if (!written || std::rename(temporaryPath.c_str(), path.c_str()) != 0){
+        std::remove(temporaryPath.c_str());
+        std::cout << "unable to write atlas: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -1,71 +1,107 @@
 #include "graphics/batchRenderer2D.hpp"
+#include "graphics/batchVertex.hpp"
+#include "graphics/textureArray.hpp"
+#include "graphics/vertexKernels.hpp"
+#include "core/threadPool.hpp"
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstring>
 #include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include <random>
 
 static const unsigned int MAX_QUADS = 10000;
 static const unsigned int MAX_VERTICES = MAX_QUADS * 4;
 static const unsigned int MAX_INDICES = MAX_QUADS * 6;
-static const unsigned int MAX_TEXTURES = 16;
-
-struct Vertex{
-    glm::vec3 position;
-    glm::vec4 color;
-    glm::vec2 texCoord;
-    glm::vec3 normal;
-    float texIndex;
-};
+// below this many quads per thread handing out the work costs more than it saves
+static const unsigned int MIN_PARALLEL_QUADS = 512;
+
+static const uint32_t UV_00 = packTexCoord(0.0f, 0.0f);
+static const uint32_t UV_10 = packTexCoord(1.0f, 0.0f);
+static const uint32_t UV_11 = packTexCoord(1.0f, 1.0f);
+static const uint32_t UV_01 = packTexCoord(0.0f, 1.0f);
+static const uint32_t FULL_TEXTURE[4] = {UV_00, UV_10, UV_11, UV_01};
 
-struct RendererData{
+struct QuadRendererData{
     unsigned int vao = 0;
-    unsigned int vbo = 0;
+    StreamBuffer vertexStream;
     unsigned int ibo = 0;
 
-    unsigned int whiteTexture = 0;
-
     unsigned int indexCount = 0;
 
-    Vertex* quadBuffer = nullptr;
-    Vertex* quadBufferPtr = nullptr;
+    BatchVertex* quadBuffer = nullptr;
+    BatchVertex* quadBufferPtr = nullptr;
+
+    // texture array page sampled by the current batch, 0 while only white layers are used
+    uint16_t texturePage = 0;
 
-    std::array<unsigned int, MAX_TEXTURES> textureSlots;
-    unsigned int textureSlotIndex = 1;
+    Frustum frustum;
+    TileScratch visibleTiles;
+    std::vector<BatchRenderer2D::QuadWriter> writers;
 
     BatchRenderer2D::Stats renderStats;
 };
 
-static RendererData sData;
+static QuadRendererData sData;
+
+// a batch samples a single texture array page, white layers fit on any page
+static bool usesOtherPage(const TextureLayer& texture){
+    return texture.layer != 0 && sData.texturePage != 0 && sData.texturePage != texture.page;
+}
+
+// copies quads built by drawParallel into the batch, flushing like drawQuad does
+// when the batch is full or samples another page
+static void appendQuads(const BatchVertex* vertices, unsigned int count, uint16_t page){
+    while (count > 0){
+        if (sData.indexCount >= MAX_INDICES || (page != 0 && sData.texturePage != 0 && sData.texturePage != page)){
+            BatchRenderer2D::endBatch();
+            BatchRenderer2D::flush();
+            BatchRenderer2D::startBatch();
+        }
+        if (page != 0)
+            sData.texturePage = page;
+
+        unsigned int quads = std::min(MAX_QUADS - sData.indexCount / 6, count);
+        memcpy((void*)sData.quadBufferPtr, vertices, sizeof(BatchVertex) * 4 * quads);
+        sData.quadBufferPtr += quads * 4;
+        sData.indexCount += quads * 6;
+        sData.renderStats.quadCount += quads;
+        vertices += quads * 4;
+        count -= quads;
+    }
+}
+
+static bool cullQuad(const glm::vec2& position, const glm::vec2& size){
+    if (sData.frustum.isBoxVisible(glm::vec3(position, 0.0f), glm::vec3(position + size, 0.0f)))
+        return false;
+    sData.renderStats.culled++;
+    return true;
+}
+
+static bool cullTile(const glm::vec2& position, const glm::vec2& size, bool rotated){
+    glm::vec3 min, max;
+    tileBounds(position.x, position.y, size.x, size.y, rotated, min, max);
+    if (sData.frustum.isBoxVisible(min, max))
+        return false;
+    sData.renderStats.culled++;
+    return true;
+}
 
-void BatchRenderer2D::init(){
-    if(sData.quadBuffer != nullptr)
+void BatchRenderer2D::init(UploadMode mode){
+    if(sData.vao != 0)
         return;
-    sData.quadBuffer = new Vertex[MAX_VERTICES];
 
     glGenVertexArrays(1, &sData.vao);
-    glGenBuffers(1, &sData.vbo);
     glGenBuffers(1, &sData.ibo);
 
     glBindVertexArray(sData.vao);
 
-    glBindBuffer(GL_ARRAY_BUFFER, sData.vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * MAX_QUADS * 4, nullptr, GL_DYNAMIC_DRAW);
-
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, position)));
-    glEnableVertexAttribArray(0);
-    // color attribute
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, color)));
-    glEnableVertexAttribArray(1);
-    // texture coord attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, texCoord)));
-    glEnableVertexAttribArray(2);
-    // texture index attribute
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, texIndex)));
-    glEnableVertexAttribArray(3);
-    // normal vector attribute
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, normal)));
-    glEnableVertexAttribArray(4);
+    sData.vertexStream.init(sizeof(BatchVertex) * MAX_VERTICES, mode);
+
+    setupBatchVertexAttributes();
 
     unsigned int indices[MAX_INDICES];
     unsigned int offset = 0;
@@ -84,99 +120,93 @@ void BatchRenderer2D::init(){
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sData.ibo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
     
-    // create a default white texture
-    glGenTextures(1, &sData.whiteTexture);
-    glBindTexture(GL_TEXTURE_2D, sData.whiteTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    unsigned int color = 0xffffffff;
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &color);
-
-    sData.textureSlots[0] = sData.whiteTexture;
-    for(int i = 1; i < MAX_TEXTURES; i++)
-        sData.textureSlots[i] = 0;
+    TextureManager::init();
 }
 
 void BatchRenderer2D::shutdown(){
     glDeleteVertexArrays(1, &sData.vao);
-    glDeleteBuffers(1, &sData.vbo);
     glDeleteBuffers(1, &sData.ibo);
+    sData.vertexStream.destroy();
 
-    glDeleteTextures(1, &sData.whiteTexture);
-
-    delete[] sData.quadBuffer;
+    sData.vao = 0;
+    sData.quadBuffer = nullptr;
+    sData.quadBufferPtr = nullptr;
 }
 
 void BatchRenderer2D::startBatch(){
+    // vertices are written straight into the stream buffer's memory
+    sData.quadBuffer = (BatchVertex*)sData.vertexStream.map();
     sData.quadBufferPtr = sData.quadBuffer;
 }
 
 void BatchRenderer2D::endBatch(){
     GLsizeiptr size = (uint8_t*)sData.quadBufferPtr - (uint8_t*)sData.quadBuffer;
-    glBindBuffer(GL_ARRAY_BUFFER, sData.vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, size, sData.quadBuffer);
+    sData.vertexStream.unmap(size);
+    sData.renderStats.bytesUploaded += size;
+    sData.renderStats.bytesSaved += size / sizeof(BatchVertex) * (UNPACKED_VERTEX_SIZE - sizeof(BatchVertex));
 }
 
 void BatchRenderer2D::flush(){
-    for (unsigned int i = 0; i < sData.textureSlotIndex; i++){
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, sData.textureSlots[i]);
-    }
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, TextureManager::getArrayID(sData.texturePage));
 
     glBindVertexArray(sData.vao);
-    glDrawElements(GL_TRIANGLES, sData.indexCount, GL_UNSIGNED_INT, nullptr);
+    GLint baseVertex = (GLint)(sData.vertexStream.getOffset() / sizeof(BatchVertex));
+    glDrawElementsBaseVertex(GL_TRIANGLES, sData.indexCount, GL_UNSIGNED_INT, nullptr, baseVertex);
+    sData.vertexStream.fence();
     sData.renderStats.drawCalls++;
 
     sData.indexCount = 0;
-    sData.textureSlotIndex = 1;
-    //std::cout << sData.whiteTexture << std::endl;
+    sData.texturePage = 0;
+}
+
+void BatchRenderer2D::setFrustum(const Frustum& frustum){
+    sData.frustum = frustum;
 }
 
 void BatchRenderer2D::setupShaderSampler(Shader& shader){
     shader.use();
-    int samplers[MAX_TEXTURES];
-    for(int i = 0; i < MAX_TEXTURES; i++)
-        samplers[i] = i;
-    shader.setTextures("u_Textures", samplers, MAX_TEXTURES);
+    shader.setInt("u_TextureArray", 0);
 }
 
 void BatchRenderer2D::drawQuad(const glm::vec2& position, const glm::vec2& size, const glm::vec4& color){
+    if (cullQuad(position, size))
+        return;
     if (sData.indexCount >= MAX_INDICES){
         endBatch();
         flush();
         startBatch();
     }
 
-    float textureIndex = 0.0f;
+    uint16_t textureIndex = 0;
+    uint32_t packedColor = packColor(color);
 
     sData.quadBufferPtr->position = {position.x, position.y, 0.0f};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_00;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 0.0f, 1.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Z;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {position.x + size.x, position.y, 0.0f};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_10;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 0.0f, 1.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Z;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, 0.0f};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_11;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 0.0f, 1.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Z;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {position.x, position.y + size.y, 0.0f};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_01;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 0.0f, 1.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Z;
     sData.quadBufferPtr++;
 
     sData.indexCount += 6;
@@ -184,40 +214,43 @@ void BatchRenderer2D::drawQuad(const glm::vec2& position, const glm::vec2& size,
 }
 
 void BatchRenderer2D::drawTile(const glm::vec2& position, const glm::vec2& size, const glm::vec4& color){
+    if (cullTile(position, size, false))
+        return;
     if (sData.indexCount >= MAX_INDICES){
         endBatch();
         flush();
         startBatch();
     }
 
-    float textureIndex = 0.0f;
+    uint16_t textureIndex = 0;
+    uint32_t packedColor = packColor(color);
 
     sData.quadBufferPtr->position = {position.x, 0.0f, position.y + size.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_00;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {position.x + size.x, 0.0f, position.y + size.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_10;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {position.x + size.x, 0.0f, position.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_11;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {position.x, 0.0f, position.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_01;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.indexCount += 6;
@@ -225,13 +258,17 @@ void BatchRenderer2D::drawTile(const glm::vec2& position, const glm::vec2& size,
 }
 
 void BatchRenderer2D::drawTile(const glm::vec2& position, const glm::vec2& size, const glm::vec4& color, float rotation){
+    if (cullTile(position, size, true))
+        return;
     if (sData.indexCount >= MAX_INDICES){
         endBatch();
         flush();
         startBatch();
     }
     
-    glm::mat2 r = glm::mat2(glm::cos(rotation), glm::sin(rotation), -glm::sin(rotation), glm::cos(rotation));
+    float cosR = glm::cos(rotation);
+    float sinR = glm::sin(rotation);
+    glm::mat2 r = glm::mat2(cosR, sinR, -sinR, cosR);
     float halfWidth = size.x * 0.5f;
     float halfHeight = size.y * 0.5f;
     glm::vec2 translation = glm::vec2(position.x + size.x / 2, position.y + size.y / 2);
@@ -240,160 +277,149 @@ void BatchRenderer2D::drawTile(const glm::vec2& position, const glm::vec2& size,
     glm::vec2 bottomRight = r * glm::vec2(halfWidth, halfHeight) + translation;
     glm::vec2 bottomLeft = r * glm::vec2(-halfWidth, halfHeight) + translation;
 
-    float textureIndex = 0.0f;
+    uint16_t textureIndex = 0;
+    uint32_t packedColor = packColor(color);
 
     sData.quadBufferPtr->position = {bottomLeft.x, 0.0f, bottomLeft.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_00;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {bottomRight.x, 0.0f, bottomRight.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_10;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {topRight.x, 0.0f, topRight.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_11;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {topLeft.x, 0.0f, topLeft.y,};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_01;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.indexCount += 6;
     sData.renderStats.quadCount++;
 }
 
-void BatchRenderer2D::drawQuad(const glm::vec2& position, const glm::vec2& size, unsigned int textureID){
-    if (sData.indexCount >= MAX_INDICES || sData.textureSlotIndex >= MAX_TEXTURES - 1){
+void BatchRenderer2D::drawQuad(const glm::vec2& position, const glm::vec2& size, const TextureLayer& texture){
+    if (cullQuad(position, size))
+        return;
+    if (sData.indexCount >= MAX_INDICES || usesOtherPage(texture)){
         endBatch();
         flush();
         startBatch();
     }
 
-    constexpr glm::vec4 color = {1.0f, 1.0f, 1.0f, 1.0f};
-
-    float textureIndex = 0.0f;
-    for (unsigned int i = 1; i < sData.textureSlotIndex; i++) {
-        if (sData.textureSlots[i] == textureID){
-            textureIndex = (float)i;
-            break;
-        }
-    }
+    constexpr uint32_t packedColor = 0xffffffff;
 
-    if (textureIndex == 0.0f){
-        textureIndex = (float)sData.textureSlotIndex;
-        sData.textureSlots[sData.textureSlotIndex] = textureID;
-        sData.textureSlotIndex++;
-    }
+    if (texture.layer != 0)
+        sData.texturePage = texture.page;
+    uint16_t textureIndex = texture.layer;
 
     sData.quadBufferPtr->position = {position.x, position.y, 0.0f};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_00;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 0.0f, 1.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Z;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {position.x + size.x, position.y, 0.0f};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_10;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 0.0f, 1.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Z;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, 0.0f};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_11;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 0.0f, 1.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Z;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {position.x, position.y + size.y, 0.0f};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_01;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 0.0f, 1.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Z;
     sData.quadBufferPtr++;
 
     sData.indexCount += 6;
     sData.renderStats.quadCount++;
 }
 
-void BatchRenderer2D::drawTile(const glm::vec2& position, const glm::vec2& size, unsigned int textureID){
-     if (sData.indexCount >= MAX_INDICES || sData.textureSlotIndex >= MAX_TEXTURES - 1){
+void BatchRenderer2D::drawTile(const glm::vec2& position, const glm::vec2& size, const TextureLayer& texture){
+    if (cullTile(position, size, false))
+        return;
+     if (sData.indexCount >= MAX_INDICES || usesOtherPage(texture)){
         endBatch();
         flush();
         startBatch();
     }
 
-    constexpr glm::vec4 color = {1.0f, 1.0f, 1.0f, 1.0f};
+    constexpr uint32_t packedColor = 0xffffffff;
 
-    float textureIndex = 0.0f;
-    for (unsigned int i = 1; i < sData.textureSlotIndex; i++) {
-        if (sData.textureSlots[i] == textureID){
-            textureIndex = (float)i;
-            break;
-        }
-    }
-
-    if (textureIndex == 0.0f){
-        textureIndex = (float)sData.textureSlotIndex;
-        sData.textureSlots[sData.textureSlotIndex] = textureID;
-        sData.textureSlotIndex++;
-    }
+    if (texture.layer != 0)
+        sData.texturePage = texture.page;
+    uint16_t textureIndex = texture.layer;
 
     sData.quadBufferPtr->position = {position.x, 0.0f, position.y + size.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_00;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {position.x + size.x, 0.0f, position.y + size.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_10;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {position.x + size.x, 0.0f, position.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_11;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {position.x, 0.0f, position.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_01;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.indexCount += 6;
     sData.renderStats.quadCount++;
 }
 
-void BatchRenderer2D::drawTile(const glm::vec2& position, const glm::vec2& size, unsigned int textureID, float rotation){
-    if (sData.indexCount >= MAX_INDICES || sData.textureSlotIndex >= MAX_TEXTURES - 1){
+void BatchRenderer2D::drawTile(const glm::vec2& position, const glm::vec2& size, const TextureLayer& texture, float rotation){
+    if (cullTile(position, size, true))
+        return;
+    if (sData.indexCount >= MAX_INDICES || usesOtherPage(texture)){
         endBatch();
         flush();
         startBatch();
     }
 
-    constexpr glm::vec4 color = {1.0f, 1.0f, 1.0f, 1.0f};
+    constexpr uint32_t packedColor = 0xffffffff;
 
-    glm::mat2 r = glm::mat2(glm::cos(rotation), glm::sin(rotation), -glm::sin(rotation), glm::cos(rotation));
+    float cosR = glm::cos(rotation);
+    float sinR = glm::sin(rotation);
+    glm::mat2 r = glm::mat2(cosR, sinR, -sinR, cosR);
     float halfWidth = size.x * 0.5f;
     float halfHeight = size.y * 0.5f;
     glm::vec2 translation = glm::vec2(position.x + size.x / 2, position.y + size.y / 2);
@@ -402,56 +428,332 @@ void BatchRenderer2D::drawTile(const glm::vec2& position, const glm::vec2& size,
     glm::vec2 bottomRight = r * glm::vec2(halfWidth, halfHeight) + translation;
     glm::vec2 bottomLeft = r * glm::vec2(-halfWidth, halfHeight) + translation;
 
-    float textureIndex = 0.0f;
-    for (unsigned int i = 1; i < sData.textureSlotIndex; i++) {
-        if (sData.textureSlots[i] == textureID){
-            textureIndex = (float)i;
-            break;
-        }
-    }
-
-    if (textureIndex == 0.0f){
-        textureIndex = (float)sData.textureSlotIndex;
-        sData.textureSlots[sData.textureSlotIndex] = textureID;
-        sData.textureSlotIndex++;
-    }
+    if (texture.layer != 0)
+        sData.texturePage = texture.page;
+    uint16_t textureIndex = texture.layer;
 
     sData.quadBufferPtr->position = {bottomLeft.x, 0.0f, bottomLeft.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_00;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {bottomRight.x, 0.0f, bottomRight.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_10;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {topRight.x, 0.0f, topRight.y};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_11;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.quadBufferPtr->position = {topLeft.x, 0.0f, topLeft.y,};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
+    sData.quadBufferPtr->color = packedColor;
+    sData.quadBufferPtr->texCoord = UV_01;
     sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0.0f, 1.0f, 0.0f};
+    sData.quadBufferPtr->normalIndex = NORMAL_POS_Y;
     sData.quadBufferPtr++;
 
     sData.indexCount += 6;
     sData.renderStats.quadCount++;
 }
 
+void BatchRenderer2D::drawTiles(const TileArrays& tiles){
+    if (sData.frustum.isEnabled()){
+        TileArrays visible = cullTiles(tiles, sData.frustum, sData.visibleTiles);
+        sData.renderStats.culled += (unsigned int)(tiles.count - visible.count);
+        drawVisibleTiles(visible);
+        return;
+    }
+    drawVisibleTiles(tiles);
+}
+
+void BatchRenderer2D::drawVisibleTiles(const TileArrays& tiles){
+    size_t done = 0;
+    while (done < tiles.count){
+        bool otherPage = tiles.textureLayers && tiles.texturePage != 0 && sData.texturePage != 0 && sData.texturePage != tiles.texturePage;
+        if (sData.indexCount >= MAX_INDICES || otherPage){
+            endBatch();
+            flush();
+            startBatch();
+        }
+        if (tiles.textureLayers && tiles.texturePage != 0)
+            sData.texturePage = tiles.texturePage;
+
+        size_t count = std::min<size_t>(MAX_QUADS - sData.indexCount / 6, tiles.count - done);
+        BatchVertex* vertices = sData.quadBufferPtr;
+        ThreadPool::parallelFor(count, MIN_PARALLEL_QUADS, [&](unsigned int, size_t begin, size_t end){
+            expandTiles(vertices + begin * 4, tiles, done + begin, end - begin);
+        });
+
+        sData.quadBufferPtr += count * 4;
+        sData.indexCount += (unsigned int)count * 6;
+        sData.renderStats.quadCount += (unsigned int)count;
+        done += count;
+    }
+}
+
+static void writeQuad(BatchVertex* v, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3,
+                      uint32_t color, uint16_t textureIndex, uint8_t normalIndex, const uint32_t* texCoords = FULL_TEXTURE){
+    const glm::vec3* positions[4] = {&p0, &p1, &p2, &p3};
+    for (int i = 0; i < 4; i++){
+        v[i].position = *positions[i];
+        v[i].color = color;
+        v[i].texCoord = texCoords[i];
+        v[i].texIndex = textureIndex;
+        v[i].normalIndex = normalIndex;
+        v[i].padding = 0;
+    }
+}
+
+void BatchRenderer2D::drawQuad(const glm::vec2& position, const glm::vec2& size, const AtlasSprite& sprite){
+    if (cullQuad(position, size))
+        return;
+    if (sData.indexCount >= MAX_INDICES || usesOtherPage(sprite.texture)){
+        endBatch();
+        flush();
+        startBatch();
+    }
+    if (sprite.texture.layer != 0)
+        sData.texturePage = sprite.texture.page;
+
+    writeQuad(sData.quadBufferPtr, {position.x, position.y, 0.0f}, {position.x + size.x, position.y, 0.0f},
+              {position.x + size.x, position.y + size.y, 0.0f}, {position.x, position.y + size.y, 0.0f},
+              0xffffffff, sprite.texture.layer, NORMAL_POS_Z, sprite.texCoords);
+    sData.quadBufferPtr += 4;
+    sData.indexCount += 6;
+    sData.renderStats.quadCount++;
+}
+
+void BatchRenderer2D::drawTile(const glm::vec2& position, const glm::vec2& size, const AtlasSprite& sprite){
+    if (cullTile(position, size, false))
+        return;
+    if (sData.indexCount >= MAX_INDICES || usesOtherPage(sprite.texture)){
+        endBatch();
+        flush();
+        startBatch();
+    }
+    if (sprite.texture.layer != 0)
+        sData.texturePage = sprite.texture.page;
+
+    writeQuad(sData.quadBufferPtr, {position.x, 0.0f, position.y + size.y}, {position.x + size.x, 0.0f, position.y + size.y},
+              {position.x + size.x, 0.0f, position.y}, {position.x, 0.0f, position.y},
+              0xffffffff, sprite.texture.layer, NORMAL_POS_Y, sprite.texCoords);
+    sData.quadBufferPtr += 4;
+    sData.indexCount += 6;
+    sData.renderStats.quadCount++;
+}
+
+void BatchRenderer2D::QuadWriter::begin(unsigned int maxQuads){
+    this->maxQuads = maxQuads;
+    if (vertices.size() < maxQuads * 4)
+        vertices.resize(maxQuads * 4);
+    runs.clear();
+    quadCount = 0;
+    texturePage = 0;
+    culled = 0;
+}
+
+// white layers fit on any page, every other page change starts a new run
+uint16_t BatchRenderer2D::QuadWriter::resolve(const TextureLayer& texture){
+    if (texture.layer == 0)
+        return 0;
+    if (texturePage != texture.page){
+        texturePage = texture.page;
+        runs.push_back({quadCount, texture.page});
+    }
+    return texture.layer;
+}
+
+bool BatchRenderer2D::QuadWriter::cull(const glm::vec3& min, const glm::vec3& max){
+    if (sData.frustum.isBoxVisible(min, max))
+        return false;
+    culled++;
+    return true;
+}
+
+void BatchRenderer2D::QuadWriter::drawQuad(const glm::vec2& position, const glm::vec2& size, const glm::vec4& color){
+    if (quadCount == maxQuads || cull(glm::vec3(position, 0.0f), glm::vec3(position + size, 0.0f)))
+        return;
+    writeQuad(next(), {position.x, position.y, 0.0f}, {position.x + size.x, position.y, 0.0f},
+              {position.x + size.x, position.y + size.y, 0.0f}, {position.x, position.y + size.y, 0.0f},
+              packColor(color), 0, NORMAL_POS_Z);
+}
+
+void BatchRenderer2D::QuadWriter::drawQuad(const glm::vec2& position, const glm::vec2& size, const TextureLayer& texture){
+    if (quadCount == maxQuads || cull(glm::vec3(position, 0.0f), glm::vec3(position + size, 0.0f)))
+        return;
+    uint16_t layer = resolve(texture);
+    writeQuad(next(), {position.x, position.y, 0.0f}, {position.x + size.x, position.y, 0.0f},
+              {position.x + size.x, position.y + size.y, 0.0f}, {position.x, position.y + size.y, 0.0f},
+              0xffffffff, layer, NORMAL_POS_Z);
+}
+
+void BatchRenderer2D::QuadWriter::drawTile(const glm::vec2& position, const glm::vec2& size, const glm::vec4& color){
+    if (quadCount == maxQuads || cull(glm::vec3(position.x, 0.0f, position.y), glm::vec3(position.x + size.x, 0.0f, position.y + size.y)))
+        return;
+    writeQuad(next(), {position.x, 0.0f, position.y + size.y}, {position.x + size.x, 0.0f, position.y + size.y},
+              {position.x + size.x, 0.0f, position.y}, {position.x, 0.0f, position.y},
+              packColor(color), 0, NORMAL_POS_Y);
+}
+
+void BatchRenderer2D::QuadWriter::drawTile(const glm::vec2& position, const glm::vec2& size, const TextureLayer& texture){
+    if (quadCount == maxQuads || cull(glm::vec3(position.x, 0.0f, position.y), glm::vec3(position.x + size.x, 0.0f, position.y + size.y)))
+        return;
+    uint16_t layer = resolve(texture);
+    writeQuad(next(), {position.x, 0.0f, position.y + size.y}, {position.x + size.x, 0.0f, position.y + size.y},
+              {position.x + size.x, 0.0f, position.y}, {position.x, 0.0f, position.y},
+              0xffffffff, layer, NORMAL_POS_Y);
+}
+
+void BatchRenderer2D::QuadWriter::drawQuad(const glm::vec2& position, const glm::vec2& size, const AtlasSprite& sprite){
+    if (quadCount == maxQuads || cull(glm::vec3(position, 0.0f), glm::vec3(position + size, 0.0f)))
+        return;
+    uint16_t layer = resolve(sprite.texture);
+    writeQuad(next(), {position.x, position.y, 0.0f}, {position.x + size.x, position.y, 0.0f},
+              {position.x + size.x, position.y + size.y, 0.0f}, {position.x, position.y + size.y, 0.0f},
+              0xffffffff, layer, NORMAL_POS_Z, sprite.texCoords);
+}
+
+void BatchRenderer2D::QuadWriter::drawTile(const glm::vec2& position, const glm::vec2& size, const AtlasSprite& sprite){
+    if (quadCount == maxQuads || cull(glm::vec3(position.x, 0.0f, position.y), glm::vec3(position.x + size.x, 0.0f, position.y + size.y)))
+        return;
+    uint16_t layer = resolve(sprite.texture);
+    writeQuad(next(), {position.x, 0.0f, position.y + size.y}, {position.x + size.x, 0.0f, position.y + size.y},
+              {position.x + size.x, 0.0f, position.y}, {position.x, 0.0f, position.y},
+              0xffffffff, layer, NORMAL_POS_Y, sprite.texCoords);
+}
+
+void BatchRenderer2D::drawParallel(unsigned int quadCount, const std::function<void(QuadWriter& writer, unsigned int begin, unsigned int end)>& build){
+    std::vector<QuadWriter>& writers = sData.writers;
+    unsigned int done = 0;
+
+    // a batch's worth at a time, so the scratch stays the size of one batch
+    while (done < quadCount){
+        unsigned int count = std::min(MAX_QUADS, quadCount - done);
+        unsigned int rangeCount = ThreadPool::getRangeCount(count, MIN_PARALLEL_QUADS);
+        if (writers.size() < rangeCount)
+            writers.resize(rangeCount);
+
+        ThreadPool::parallelFor(count, MIN_PARALLEL_QUADS, [&](unsigned int range, size_t begin, size_t end){
+            QuadWriter& writer = writers[range];
+            writer.begin((unsigned int)(end - begin));
+            build(writer, done + (unsigned int)begin, done + (unsigned int)end);
+        });
+
+        // the ranges go into the batch in order, the white quads in front of a
+        // writer's first run fit whatever page the batch already samples
+        for (unsigned int range = 0; range < rangeCount; range++){
+            QuadWriter& writer = writers[range];
+            sData.renderStats.culled += writer.culled;
+            unsigned int first = 0;
+            uint16_t page = 0;
+            for (const QuadWriter::PageRun& run : writer.runs){
+                appendQuads(writer.vertices.data() + first * 4, run.firstQuad - first, page);
+                first = run.firstQuad;
+                page = run.page;
+            }
+            appendQuads(writer.vertices.data() + first * 4, writer.quadCount - first, page);
+        }
+        done += count;
+    }
+}
+
 void BatchRenderer2D::resetStats(){
     memset(&sData.renderStats, 0, sizeof(Stats));
 }
 
 const BatchRenderer2D::Stats& BatchRenderer2D::getStats(){
     return sData.renderStats;
+}
+
+void BatchRenderer2D::benchmarkKernels(unsigned int count, unsigned int iterations){
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> x(count), y(count), width(count), height(count), rotations(count);
+    std::vector<glm::vec4> colors(count);
+    std::vector<uint32_t> packedColors(count);
+    for (unsigned int i = 0; i < count; i++){
+        x[i] = unit(random) * 100.0f;
+        y[i] = unit(random) * 100.0f;
+        width[i] = 0.1f + unit(random);
+        height[i] = 0.1f + unit(random);
+        rotations[i] = unit(random) * glm::two_pi<float>();
+        colors[i] = glm::vec4(unit(random), unit(random), unit(random), 1.0f);
+        packedColors[i] = packColor(colors[i]);
+    }
+    iterations = std::max(iterations, 1u);
+
+    // drawTile writes wherever the batch points, which is a plain vector here, and
+    // the batch never fills up, so nothing reaches gl
+    Frustum frustum(glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 200.0f) *
+                    glm::lookAt(glm::vec3(25.0f, 30.0f, 25.0f), glm::vec3(25.0f, 0.0f, 25.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
+
+    QuadRendererData saved;
+    std::swap(saved, sData);
+    for (bool rotated : {false, true}){
+        TileArrays tiles;
+        tiles.count = count;
+        tiles.x = x.data();
+        tiles.y = y.data();
+        tiles.width = width.data();
+        tiles.height = height.data();
+        tiles.colors = packedColors.data();
+        tiles.rotations = rotated ? rotations.data() : nullptr;
+
+        // drawTile leaves the padding alone, both start out zeroed
+        std::vector<BatchVertex> scalar((size_t)count * 4), kernel((size_t)count * 4);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int iteration = 0; iteration < iterations; iteration++){
+            for (unsigned int first = 0; first < count; first += MAX_QUADS){
+                sData.quadBufferPtr = scalar.data() + (size_t)first * 4;
+                sData.indexCount = 0;
+                for (unsigned int i = first; i < std::min(first + MAX_QUADS, count); i++){
+                    if (rotated)
+                        drawTile(glm::vec2(x[i], y[i]), glm::vec2(width[i], height[i]), colors[i], rotations[i]);
+                    else
+                        drawTile(glm::vec2(x[i], y[i]), glm::vec2(width[i], height[i]), colors[i]);
+                }
+            }
+        }
+        double scalarMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned int iteration = 0; iteration < iterations; iteration++)
+            expandTiles(kernel.data(), tiles, 0, count);
+        double kernelMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+        bool identical = memcmp(scalar.data(), kernel.data(), sizeof(BatchVertex) * scalar.size()) == 0;
+        std::cout << count << (rotated ? " rotated tiles: " : " tiles: ") << scalarMilliseconds << " ms drawTile, "
+                  << kernelMilliseconds << " ms expandTiles, " << (identical ? "identical" : "DIFFERENT") << std::endl;
+
+        // a corner of the field in view, one box per test against four per iteration
+        std::vector<float> perBox;
+        start = std::chrono::steady_clock::now();
+        for (unsigned int iteration = 0; iteration < iterations; iteration++){
+            perBox.clear();
+            for (unsigned int i = 0; i < count; i++){
+                glm::vec3 min, max;
+                tileBounds(x[i], y[i], width[i], height[i], rotated, min, max);
+                if (frustum.isBoxVisible(min, max))
+                    perBox.push_back(x[i]);
+            }
+        }
+        double perBoxMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+        TileScratch visible;
+        start = std::chrono::steady_clock::now();
+        for (unsigned int iteration = 0; iteration < iterations; iteration++)
+            cullTiles(tiles, frustum, visible);
+        double cullMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+        std::cout << count << (rotated ? " rotated tiles" : " tiles") << " culled to " << visible.x.size() << ": " << perBoxMilliseconds
+                  << " ms isBoxVisible, " << cullMilliseconds << " ms cullTiles, " << (perBox == visible.x ? "identical" : "DIFFERENT") << std::endl;
+    }
+    std::swap(saved, sData);
 }
\ No newline at end of file
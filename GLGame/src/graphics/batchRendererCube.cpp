@@ -1,71 +1,121 @@
 #include "graphics/batchRendererCube.hpp"
+#include "graphics/batchVertex.hpp"
+#include "graphics/textureArray.hpp"
+#include "graphics/vertexKernels.hpp"
+#include "core/threadPool.hpp"
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstring>
 #include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include <random>
 
 static const unsigned int MAX_CUBES = 1000;
 static const unsigned int MAX_VERTICES = MAX_CUBES * 24;
 static const unsigned int MAX_INDICES = MAX_CUBES * 36;
-static const unsigned int MAX_TEXTURES = 16;
+static const unsigned int MAX_INSTANCES = 65536;
+// below this many cubes per thread handing out the work costs more than it saves
+static const unsigned int MIN_PARALLEL_CUBES = 256;
 
-struct Vertex{
+// one record per cube in instanced mode, expanded against the unit cube by cubeInstanced.vs
+struct CubeInstance{
     glm::vec3 position;
-    glm::vec4 color;
-    glm::vec2 texCoord;
-    glm::vec3 normal;
-    float texIndex;
+    glm::vec3 size;
+    uint32_t color;
+    uint16_t texIndex;
+    uint16_t padding;
 };
 
-struct RendererData{
+struct CubeRendererData{
     unsigned int vao = 0;
-    unsigned int vbo = 0;
+    StreamBuffer vertexStream;
     unsigned int ibo = 0;
 
-    unsigned int whiteTexture = 0;
+    bool instanced = false;
+    unsigned int unitCubeVbo = 0;
+    StreamBuffer instanceStream;
+    CubeInstance* instanceBuffer = nullptr;
+    CubeInstance* instanceBufferPtr = nullptr;
+    unsigned int instanceCount = 0;
 
     unsigned int indexCount = 0;
 
-    Vertex* quadBuffer = nullptr;
-    Vertex* quadBufferPtr = nullptr;
+    BatchVertex* quadBuffer = nullptr;
+    BatchVertex* quadBufferPtr = nullptr;
 
-    std::array<unsigned int, MAX_TEXTURES> textureSlots;
-    unsigned int textureSlotIndex = 1;
+    // texture array page sampled by the current batch, 0 while only white layers are used
+    uint16_t texturePage = 0;
+
+    Frustum frustum;
+    CubeScratch visibleCubes;
+    std::vector<BatchRendererCube::CubeWriter> writers;
 
     BatchRendererCube::Stats renderStats;
 };
 
-static RendererData sData;
-
-void BatchRendererCube::init(){
-    if(sData.quadBuffer != nullptr)
-        return;
-    sData.quadBuffer = new Vertex[MAX_VERTICES];
+static CubeRendererData sData;
 
-    glGenVertexArrays(1, &sData.vao);
-    glGenBuffers(1, &sData.vbo);
-    glGenBuffers(1, &sData.ibo);
-
-    glBindVertexArray(sData.vao);
+// a batch samples a single texture array page, white layers fit on any page
+static bool usesOtherPage(const TextureLayer& texture){
+    return texture.layer != 0 && sData.texturePage != 0 && sData.texturePage != texture.page;
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, sData.vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * MAX_CUBES * 4, nullptr, GL_DYNAMIC_DRAW);
+static bool cullCube(const glm::vec3& position, const glm::vec3& size){
+    if (sData.frustum.isBoxVisible(position, position + size))
+        return false;
+    sData.renderStats.culled++;
+    return true;
+}
 
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, position)));
-    glEnableVertexAttribArray(0);
+// per instance attributes have to be re-pointed at the ring segment that is being drawn
+static void setupInstanceAttributes(size_t offset){
+    glBindBuffer(GL_ARRAY_BUFFER, sData.instanceStream.getID());
     // color attribute
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, color)));
-    glEnableVertexAttribArray(1);
-    // texture coord attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, texCoord)));
-    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CubeInstance), (const void*)(offset + offsetof(CubeInstance, color)));
     // texture index attribute
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, texIndex)));
-    glEnableVertexAttribArray(3);
-    // normal vector attribute
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, normal)));
-    glEnableVertexAttribArray(4);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_SHORT, sizeof(CubeInstance), (const void*)(offset + offsetof(CubeInstance, texIndex)));
+    // cube position attribute
+    glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(CubeInstance), (const void*)(offset + offsetof(CubeInstance, position)));
+    // cube size attribute
+    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(CubeInstance), (const void*)(offset + offsetof(CubeInstance, size)));
+}
+
+static void initInstanced(UploadMode mode){
+    BatchVertex unitCube[24];
+    expandCube(unitCube, glm::vec3(0.0f), glm::vec3(1.0f), 0xffffffff, 0);
+
+    glGenBuffers(1, &sData.unitCubeVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, sData.unitCubeVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(unitCube), unitCube, GL_STATIC_DRAW);
+    setupBatchVertexAttributes();
+
+    sData.instanceStream.init(sizeof(CubeInstance) * MAX_INSTANCES, mode);
+    setupInstanceAttributes(0);
+    for (unsigned int location : {1, 3, 5, 6}){
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+
+    unsigned int indices[36];
+    for (unsigned int i = 0; i < 6; i++){
+        indices[i * 6 + 0] = i * 4 + 0;
+        indices[i * 6 + 1] = i * 4 + 1;
+        indices[i * 6 + 2] = i * 4 + 2;
+        indices[i * 6 + 3] = i * 4 + 2;
+        indices[i * 6 + 4] = i * 4 + 3;
+        indices[i * 6 + 5] = i * 4 + 0;
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sData.ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+}
+
+static void initBatched(UploadMode mode){
+    sData.vertexStream.init(sizeof(BatchVertex) * MAX_VERTICES, mode);
+
+    setupBatchVertexAttributes();
 
     unsigned int indices[MAX_INDICES];
     unsigned int offset = 0;
@@ -118,408 +168,447 @@ void BatchRendererCube::init(){
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sData.ibo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+}
+
+void BatchRendererCube::init(UploadMode uploadMode, Mode mode){
+    if(sData.vao != 0)
+        return;
+    sData.instanced = mode == Mode::Instanced;
+
+    glGenVertexArrays(1, &sData.vao);
+    glGenBuffers(1, &sData.ibo);
+
+    glBindVertexArray(sData.vao);
+
+    if (sData.instanced)
+        initInstanced(uploadMode);
+    else
+        initBatched(uploadMode);
     
-    // create a default white texture
-    glGenTextures(1, &sData.whiteTexture);
-    glBindTexture(GL_TEXTURE_2D, sData.whiteTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    unsigned int color = 0xffffffff;
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &color);
-
-    sData.textureSlots[0] = sData.whiteTexture;
-    for(int i = 1; i < MAX_TEXTURES; i++)
-        sData.textureSlots[i] = 0;
+    TextureManager::init();
 }
 
 void BatchRendererCube::shutdown(){
     glDeleteVertexArrays(1, &sData.vao);
-    glDeleteBuffers(1, &sData.vbo);
     glDeleteBuffers(1, &sData.ibo);
+    if (sData.instanced){
+        glDeleteBuffers(1, &sData.unitCubeVbo);
+        sData.instanceStream.destroy();
+    } else {
+        sData.vertexStream.destroy();
+    }
 
-    glDeleteTextures(1, &sData.whiteTexture);
-
-    delete[] sData.quadBuffer;
+    sData.vao = 0;
+    sData.unitCubeVbo = 0;
+    sData.quadBuffer = nullptr;
+    sData.quadBufferPtr = nullptr;
+    sData.instanceBuffer = nullptr;
+    sData.instanceBufferPtr = nullptr;
 }
 
 void BatchRendererCube::startBatch(){
+    if (sData.instanced){
+        sData.instanceBuffer = (CubeInstance*)sData.instanceStream.map();
+        sData.instanceBufferPtr = sData.instanceBuffer;
+        return;
+    }
+    // vertices are written straight into the stream buffer's memory
+    sData.quadBuffer = (BatchVertex*)sData.vertexStream.map();
     sData.quadBufferPtr = sData.quadBuffer;
 }
 
 void BatchRendererCube::endBatch(){
+    if (sData.instanced){
+        GLsizeiptr size = (uint8_t*)sData.instanceBufferPtr - (uint8_t*)sData.instanceBuffer;
+        sData.instanceStream.unmap(size);
+        sData.renderStats.bytesUploaded += size;
+        return;
+    }
     GLsizeiptr size = (uint8_t*)sData.quadBufferPtr - (uint8_t*)sData.quadBuffer;
-    glBindBuffer(GL_ARRAY_BUFFER, sData.vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, size, sData.quadBuffer);
+    sData.vertexStream.unmap(size);
+    sData.renderStats.bytesUploaded += size;
+    sData.renderStats.bytesSaved += size / sizeof(BatchVertex) * (UNPACKED_VERTEX_SIZE - sizeof(BatchVertex));
 }
 
 void BatchRendererCube::flush(){
-    for (unsigned int i = 0; i < sData.textureSlotIndex; i++){
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, sData.textureSlots[i]);
-    }
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, TextureManager::getArrayID(sData.texturePage));
 
     glBindVertexArray(sData.vao);
-    glDrawElements(GL_TRIANGLES, sData.indexCount, GL_UNSIGNED_INT, nullptr);
+    if (sData.instanced){
+        setupInstanceAttributes(sData.instanceStream.getOffset());
+        glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr, sData.instanceCount);
+        sData.instanceStream.fence();
+        sData.renderStats.drawCalls++;
+
+        sData.instanceCount = 0;
+        sData.texturePage = 0;
+        return;
+    }
+    GLint baseVertex = (GLint)(sData.vertexStream.getOffset() / sizeof(BatchVertex));
+    glDrawElementsBaseVertex(GL_TRIANGLES, sData.indexCount, GL_UNSIGNED_INT, nullptr, baseVertex);
+    sData.vertexStream.fence();
     sData.renderStats.drawCalls++;
 
     sData.indexCount = 0;
-    sData.textureSlotIndex = 1;
-    //std::cout << sData.whiteTexture << std::endl;
+    sData.texturePage = 0;
+}
+
+void BatchRendererCube::setFrustum(const Frustum& frustum){
+    sData.frustum = frustum;
 }
 
 void BatchRendererCube::setupShaderSampler(Shader& shader){
     shader.use();
-    int samplers[MAX_TEXTURES];
-    for(int i = 0; i < MAX_TEXTURES; i++)
-        samplers[i] = i;
-    shader.setTextures("u_Textures", samplers, MAX_TEXTURES);
+    shader.setInt("u_TextureArray", 0);
+}
+
+static void drawInstance(const glm::vec3& position, const glm::vec3& size, uint32_t color, uint16_t textureIndex){
+    sData.instanceBufferPtr->position = position;
+    sData.instanceBufferPtr->size = size;
+    sData.instanceBufferPtr->color = color;
+    sData.instanceBufferPtr->texIndex = textureIndex;
+    sData.instanceBufferPtr++;
+
+    sData.instanceCount++;
 }
 
 void BatchRendererCube::drawCube(const glm::vec3& position, const glm::vec3& size, const glm::vec4& color){
+    if (cullCube(position, size))
+        return;
+
+    if (sData.instanced){
+        if (sData.instanceCount >= MAX_INSTANCES){
+            endBatch();
+            flush();
+            startBatch();
+        }
+        drawInstance(position, size, packColor(color), 0);
+        sData.renderStats.quadCount++;
+        return;
+    }
+
     if (sData.indexCount >= MAX_INDICES){
         endBatch();
         flush();
         startBatch();
     }
 
-    float textureIndex = 0.0f;
-
-    //front
-    sData.quadBufferPtr->position = {position.x, position.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, 1};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, 1};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, 1};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y + size.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, 1};
-    sData.quadBufferPtr++;
-    //right
-    sData.quadBufferPtr->position = {position.x + size.x, position.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {1, 0, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {1, 0, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {1, 0, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {1, 0, 0};
-    sData.quadBufferPtr++;
-    //left
-    sData.quadBufferPtr->position = {position.x, position.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {-1, 0, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {-1, 0, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y + size.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {-1, 0, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y + size.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {-1, 0, 0};
-    sData.quadBufferPtr++;
-    //top
-    sData.quadBufferPtr->position = {position.x, position.y + size.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 1, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 1, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 1, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y + size.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 1, 0};
-    sData.quadBufferPtr++;
-    //bottom
-    sData.quadBufferPtr->position = {position.x + size.x, position.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, -1, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, -1, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, -1, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, -1, 0};
-    sData.quadBufferPtr++;
-    //back
-    sData.quadBufferPtr->position = {position.x + size.x, position.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, -1};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, -1};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y + size.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, -1};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, -1};
-    sData.quadBufferPtr++;
-
+    expandCube(sData.quadBufferPtr, position, size, packColor(color), 0);
+    sData.quadBufferPtr += 24;
 
     sData.indexCount += 36;
     sData.renderStats.quadCount++;
 }
 
-void BatchRendererCube::drawCube(const glm::vec3& position, const glm::vec3& size, unsigned int textureID){
-    if (sData.indexCount >= MAX_INDICES || sData.textureSlotIndex >= MAX_TEXTURES - 1){
+void BatchRendererCube::drawCube(const glm::vec3& position, const glm::vec3& size, const TextureLayer& texture){
+    if (cullCube(position, size))
+        return;
+
+    bool batchFull = sData.instanced ? sData.instanceCount >= MAX_INSTANCES : sData.indexCount >= MAX_INDICES;
+    if (batchFull || usesOtherPage(texture)){
         endBatch();
         flush();
         startBatch();
     }
 
-    constexpr glm::vec4 color = {1.0f, 1.0f, 1.0f, 1.0f};
+    constexpr uint32_t packedColor = 0xffffffff;
 
-    float textureIndex = 0.0f;
-    for (unsigned int i = 1; i < sData.textureSlotIndex; i++) {
-        if (sData.textureSlots[i] == textureID){
-            textureIndex = (float)i;
-            break;
-        }
-    }
+    if (texture.layer != 0)
+        sData.texturePage = texture.page;
+    uint16_t textureIndex = texture.layer;
 
-    if (textureIndex == 0.0f){
-        textureIndex = (float)sData.textureSlotIndex;
-        sData.textureSlots[sData.textureSlotIndex] = textureID;
-        sData.textureSlotIndex++;
+    if (sData.instanced){
+        drawInstance(position, size, packedColor, textureIndex);
+        sData.renderStats.quadCount++;
+        return;
     }
 
-    //front
-    sData.quadBufferPtr->position = {position.x, position.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, 1};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, 1};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, 1};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y + size.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, 1};
-    sData.quadBufferPtr++;
-    //right
-    sData.quadBufferPtr->position = {position.x + size.x, position.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {1, 0, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {1, 0, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {1, 0, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {1, 0, 0};
-    sData.quadBufferPtr++;
-    //left
-    sData.quadBufferPtr->position = {position.x, position.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {-1, 0, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {-1, 0, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y + size.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {-1, 0, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y + size.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {-1, 0, 0};
-    sData.quadBufferPtr++;
-    //top
-    sData.quadBufferPtr->position = {position.x, position.y + size.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 1, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 1, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 1, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y + size.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 1, 0};
-    sData.quadBufferPtr++;
-    //bottom
-    sData.quadBufferPtr->position = {position.x + size.x, position.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, -1, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y, position.z + size.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, -1, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, -1, 0};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, -1, 0};
-    sData.quadBufferPtr++;
-    //back
-    sData.quadBufferPtr->position = {position.x + size.x, position.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, -1};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 0.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, -1};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x, position.y + size.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {1.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, -1};
-    sData.quadBufferPtr++;
-    sData.quadBufferPtr->position = {position.x + size.x, position.y + size.y, position.z};
-    sData.quadBufferPtr->color = color;
-    sData.quadBufferPtr->texCoord = {0.0f, 1.0f};
-    sData.quadBufferPtr->texIndex = textureIndex;
-    sData.quadBufferPtr->normal = {0, 0, -1};
-    sData.quadBufferPtr++;
+    expandCube(sData.quadBufferPtr, position, size, packedColor, textureIndex);
+    sData.quadBufferPtr += 24;
 
     sData.indexCount += 36;
     sData.renderStats.quadCount++;
 }
 
+void BatchRendererCube::drawCubes(const CubeArrays& cubes){
+    if (sData.frustum.isEnabled()){
+        CubeArrays visible = cullCubes(cubes, sData.frustum, sData.visibleCubes);
+        sData.renderStats.culled += (unsigned int)(cubes.count - visible.count);
+        drawVisibleCubes(visible);
+        return;
+    }
+    drawVisibleCubes(cubes);
+}
+
+void BatchRendererCube::drawVisibleCubes(const CubeArrays& cubes){
+    size_t done = 0;
+    while (done < cubes.count){
+        bool batchFull = sData.instanced ? sData.instanceCount >= MAX_INSTANCES : sData.indexCount >= MAX_INDICES;
+        bool otherPage = cubes.textureLayers && cubes.texturePage != 0 && sData.texturePage != 0 && sData.texturePage != cubes.texturePage;
+        if (batchFull || otherPage){
+            endBatch();
+            flush();
+            startBatch();
+        }
+        if (cubes.textureLayers && cubes.texturePage != 0)
+            sData.texturePage = cubes.texturePage;
+
+        size_t room = sData.instanced ? MAX_INSTANCES - sData.instanceCount : MAX_CUBES - sData.indexCount / 36;
+        size_t count = std::min(room, cubes.count - done);
+
+        if (sData.instanced){
+            CubeInstance* instances = sData.instanceBufferPtr;
+            ThreadPool::parallelFor(count, MIN_PARALLEL_CUBES, [&](unsigned int, size_t begin, size_t end){
+                for (size_t i = begin; i < end; i++){
+                    size_t cube = done + i;
+                    instances[i].position = {cubes.x[cube], cubes.y[cube], cubes.z[cube]};
+                    instances[i].size = {cubes.width[cube], cubes.height[cube], cubes.depth[cube]};
+                    instances[i].color = cubes.colors ? cubes.colors[cube] : 0xffffffff;
+                    instances[i].texIndex = cubes.textureLayers ? cubes.textureLayers[cube] : 0;
+                    instances[i].padding = 0;
+                }
+            });
+            sData.instanceBufferPtr += count;
+            sData.instanceCount += (unsigned int)count;
+        } else {
+            BatchVertex* vertices = sData.quadBufferPtr;
+            ThreadPool::parallelFor(count, MIN_PARALLEL_CUBES, [&](unsigned int, size_t begin, size_t end){
+                expandCubes(vertices + begin * 24, cubes, done + begin, end - begin);
+            });
+            sData.quadBufferPtr += count * 24;
+            sData.indexCount += (unsigned int)count * 36;
+        }
+
+        sData.renderStats.quadCount += (unsigned int)count;
+        done += count;
+    }
+}
+
+void BatchRendererCube::CubeWriter::begin(unsigned int maxCubes, bool instanced){
+    this->maxCubes = maxCubes;
+    this->instanced = instanced;
+    if (instanced && instances.size() < maxCubes)
+        instances.resize(maxCubes);
+    if (!instanced && vertices.size() < maxCubes * 24)
+        vertices.resize(maxCubes * 24);
+    runs.clear();
+    cubeCount = 0;
+    texturePage = 0;
+    culled = 0;
+}
+
+// white layers fit on any page, every other page change starts a new run
+uint16_t BatchRendererCube::CubeWriter::resolve(const TextureLayer& texture){
+    if (texture.layer == 0)
+        return 0;
+    if (texturePage != texture.page){
+        texturePage = texture.page;
+        runs.push_back({cubeCount, texture.page});
+    }
+    return texture.layer;
+}
+
+void BatchRendererCube::CubeWriter::write(const glm::vec3& position, const glm::vec3& size, uint32_t color, uint16_t textureIndex){
+    if (instanced){
+        CubeInstance& instance = instances[cubeCount++];
+        instance.position = position;
+        instance.size = size;
+        instance.color = color;
+        instance.texIndex = textureIndex;
+        instance.padding = 0;
+        return;
+    }
+    expandCube(vertices.data() + cubeCount++ * 24, position, size, color, textureIndex);
+}
+
+void BatchRendererCube::CubeWriter::drawCube(const glm::vec3& position, const glm::vec3& size, const glm::vec4& color){
+    if (cubeCount == maxCubes)
+        return;
+    if (!sData.frustum.isBoxVisible(position, position + size)){
+        culled++;
+        return;
+    }
+    write(position, size, packColor(color), 0);
+}
+
+void BatchRendererCube::CubeWriter::drawCube(const glm::vec3& position, const glm::vec3& size, const TextureLayer& texture){
+    if (cubeCount == maxCubes)
+        return;
+    if (!sData.frustum.isBoxVisible(position, position + size)){
+        culled++;
+        return;
+    }
+    write(position, size, 0xffffffff, resolve(texture));
+}
+
+// copies cubes built by drawParallel into the batch, flushing like drawCube does
+// when the batch is full or samples another page. one of vertices and instances
+// is set, depending on the mode
+static void appendCubes(const BatchVertex* vertices, const CubeInstance* instances, unsigned int count, uint16_t page){
+    while (count > 0){
+        bool full = sData.instanced ? sData.instanceCount >= MAX_INSTANCES : sData.indexCount >= MAX_INDICES;
+        if (full || (page != 0 && sData.texturePage != 0 && sData.texturePage != page)){
+            BatchRendererCube::endBatch();
+            BatchRendererCube::flush();
+            BatchRendererCube::startBatch();
+        }
+        if (page != 0)
+            sData.texturePage = page;
+
+        unsigned int cubes;
+        if (instances){
+            cubes = std::min(MAX_INSTANCES - sData.instanceCount, count);
+            memcpy((void*)sData.instanceBufferPtr, instances, sizeof(CubeInstance) * cubes);
+            sData.instanceBufferPtr += cubes;
+            sData.instanceCount += cubes;
+            instances += cubes;
+        } else {
+            cubes = std::min(MAX_CUBES - sData.indexCount / 36, count);
+            memcpy((void*)sData.quadBufferPtr, vertices, sizeof(BatchVertex) * 24 * cubes);
+            sData.quadBufferPtr += cubes * 24;
+            sData.indexCount += cubes * 36;
+            vertices += cubes * 24;
+        }
+        sData.renderStats.quadCount += cubes;
+        count -= cubes;
+    }
+}
+
+void BatchRendererCube::drawParallel(unsigned int cubeCount, const std::function<void(CubeWriter& writer, unsigned int begin, unsigned int end)>& build){
+    std::vector<CubeWriter>& writers = sData.writers;
+    unsigned int done = 0;
+
+    // a batch's worth at a time, so the scratch stays the size of one batch
+    unsigned int batchSize = sData.instanced ? MAX_INSTANCES : MAX_CUBES;
+    while (done < cubeCount){
+        unsigned int count = std::min(batchSize, cubeCount - done);
+        unsigned int rangeCount = ThreadPool::getRangeCount(count, MIN_PARALLEL_CUBES);
+        if (writers.size() < rangeCount)
+            writers.resize(rangeCount);
+
+        ThreadPool::parallelFor(count, MIN_PARALLEL_CUBES, [&](unsigned int range, size_t begin, size_t end){
+            CubeWriter& writer = writers[range];
+            writer.begin((unsigned int)(end - begin), sData.instanced);
+            build(writer, done + (unsigned int)begin, done + (unsigned int)end);
+        });
+
+        // the ranges go into the batch in order, the white cubes in front of a
+        // writer's first run fit whatever page the batch already samples
+        for (unsigned int range = 0; range < rangeCount; range++){
+            CubeWriter& writer = writers[range];
+            sData.renderStats.culled += writer.culled;
+            unsigned int first = 0;
+            uint16_t page = 0;
+            auto append = [&](unsigned int last){
+                if (writer.instanced)
+                    appendCubes(nullptr, writer.instances.data() + first, last - first, page);
+                else
+                    appendCubes(writer.vertices.data() + first * 24, nullptr, last - first, page);
+            };
+            for (const CubeWriter::PageRun& run : writer.runs){
+                append(run.firstCube);
+                first = run.firstCube;
+                page = run.page;
+            }
+            append(writer.cubeCount);
+        }
+        done += count;
+    }
+}
+
 void BatchRendererCube::resetStats(){
     memset(&sData.renderStats, 0, sizeof(Stats));
-}
\ No newline at end of file
+}
+
+const BatchRendererCube::Stats& BatchRendererCube::getStats(){
+    return sData.renderStats;
+}
+
+void BatchRendererCube::benchmarkKernels(unsigned int count, unsigned int iterations){
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> x(count), y(count), z(count), width(count), height(count), depth(count);
+    std::vector<glm::vec4> colors(count);
+    std::vector<uint32_t> packedColors(count);
+    for (unsigned int i = 0; i < count; i++){
+        x[i] = unit(random) * 100.0f;
+        y[i] = unit(random) * 10.0f;
+        z[i] = unit(random) * 100.0f;
+        width[i] = 0.1f + unit(random);
+        height[i] = 0.1f + unit(random);
+        depth[i] = 0.1f + unit(random);
+        colors[i] = glm::vec4(unit(random), unit(random), unit(random), 1.0f);
+        packedColors[i] = packColor(colors[i]);
+    }
+    CubeArrays cubes;
+    cubes.count = count;
+    cubes.x = x.data();
+    cubes.y = y.data();
+    cubes.z = z.data();
+    cubes.width = width.data();
+    cubes.height = height.data();
+    cubes.depth = depth.data();
+    cubes.colors = packedColors.data();
+    iterations = std::max(iterations, 1u);
+    auto elapsed = [](std::chrono::steady_clock::time_point start, unsigned int iterations){
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+    };
+
+    // batched drawCube writes wherever the batch points, which is a plain vector here,
+    // and the batch never fills up, so nothing reaches gl
+    std::vector<BatchVertex> batched((size_t)count * 24), scalar((size_t)count * 24), kernel((size_t)count * 24);
+    CubeRendererData saved;
+    std::swap(saved, sData);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int iteration = 0; iteration < iterations; iteration++){
+        for (unsigned int first = 0; first < count; first += MAX_CUBES){
+            sData.quadBufferPtr = batched.data() + (size_t)first * 24;
+            sData.indexCount = 0;
+            for (unsigned int i = first; i < std::min(first + MAX_CUBES, count); i++)
+                drawCube(glm::vec3(x[i], y[i], z[i]), glm::vec3(width[i], height[i], depth[i]), colors[i]);
+        }
+    }
+    double batchedMilliseconds = elapsed(start, iterations);
+    std::swap(saved, sData);
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned int iteration = 0; iteration < iterations; iteration++){
+        for (unsigned int i = 0; i < count; i++)
+            expandCubeScalar(scalar.data() + (size_t)i * 24, glm::vec3(x[i], y[i], z[i]), glm::vec3(width[i], height[i], depth[i]), packedColors[i], 0);
+    }
+    double scalarMilliseconds = elapsed(start, iterations);
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned int iteration = 0; iteration < iterations; iteration++)
+        expandCubes(kernel.data(), cubes, 0, count);
+    double kernelMilliseconds = elapsed(start, iterations);
+
+    size_t bytes = sizeof(BatchVertex) * kernel.size();
+    bool identical = memcmp(batched.data(), scalar.data(), bytes) == 0 && memcmp(scalar.data(), kernel.data(), bytes) == 0;
+    std::cout << count << " cubes: " << batchedMilliseconds << " ms drawCube, " << scalarMilliseconds << " ms scalar, "
+              << kernelMilliseconds << " ms expandCubes, " << (identical ? "identical" : "DIFFERENT") << std::endl;
+
+    // a corner of the field in view, one box per test against four per iteration
+    Frustum frustum(glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 200.0f) *
+                    glm::lookAt(glm::vec3(25.0f, 30.0f, 25.0f), glm::vec3(25.0f, 0.0f, 25.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
+    std::vector<float> perBox;
+    start = std::chrono::steady_clock::now();
+    for (unsigned int iteration = 0; iteration < iterations; iteration++){
+        perBox.clear();
+        for (unsigned int i = 0; i < count; i++){
+            glm::vec3 min = glm::vec3(x[i], y[i], z[i]);
+            if (frustum.isBoxVisible(min, min + glm::vec3(width[i], height[i], depth[i])))
+                perBox.push_back(x[i]);
+        }
+    }
+    double perBoxMilliseconds = elapsed(start, iterations);
+
+    CubeScratch visible;
+    start = std::chrono::steady_clock::now();
+    for (unsigned int iteration = 0; iteration < iterations; iteration++)
+        cullCubes(cubes, frustum, visible);
+    double cullMilliseconds = elapsed(start, iterations);
+    std::cout << count << " cubes culled to " << visible.x.size() << ": " << perBoxMilliseconds << " ms isBoxVisible, "
+              << cullMilliseconds << " ms cullCubes, " << (perBox == visible.x ? "identical" : "DIFFERENT") << std::endl;
+}
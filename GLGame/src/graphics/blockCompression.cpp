@@ -0,0 +1,539 @@
+#include "graphics/blockCompression.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <glm/glm.hpp>
+#include "core/threadPool.hpp"
+#include "graphics/imageDecoder.hpp"
+
+// how far along the endpoints each of BC7's 16 palette entries sits, in 64ths
+static const int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+// the same for BC1's palette entries, index 0 is the first endpoint and 1 the second
+static const float BC1_WEIGHTS[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+// bits packed from the lowest bit of the first byte up, as every bc format stores them
+struct BitWriter{
+    uint8_t* out;
+    unsigned int position = 0;
+
+    void write(uint32_t value, unsigned int bits){
+        for (unsigned int i = 0; i < bits; i++, position++){
+            if ((value >> i) & 1)
+                out[position >> 3] |= (uint8_t)(1 << (position & 7));
+        }
+    }
+};
+
+struct BitReader{
+    const uint8_t* in;
+    unsigned int position = 0;
+
+    uint32_t read(unsigned int bits){
+        uint32_t value = 0;
+        for (unsigned int i = 0; i < bits; i++, position++)
+            value |= (uint32_t)((in[position >> 3] >> (position & 7)) & 1) << i;
+        return value;
+    }
+};
+
+static float squaredError(const glm::vec4& a, const uint8_t* b){
+    glm::vec4 d = a - glm::vec4(b[0], b[1], b[2], b[3]);
+    return glm::dot(d, d);
+}
+
+static float squaredColorError(const glm::vec4& a, const uint8_t* b){
+    glm::vec3 d = glm::vec3(a) - glm::vec3(b[0], b[1], b[2]);
+    return glm::dot(d, d);
+}
+
+// the block's pixels as floats. alpha is zeroed when only the colour gets fitted
+static void loadBlock(const uint8_t* rgba, glm::vec4* pixels, bool alpha){
+    for (int i = 0; i < 16; i++)
+        pixels[i] = glm::vec4(rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2], alpha ? rgba[i * 4 + 3] : 0.0f);
+}
+
+static glm::vec4 getMean(const glm::vec4* pixels){
+    glm::vec4 mean(0.0f);
+    for (int i = 0; i < 16; i++)
+        mean += pixels[i];
+    return mean / 16.0f;
+}
+
+// direction the pixels spread the most in, by power iteration on their covariance.
+// zero when the block is a single colour
+static glm::vec4 getPrincipalAxis(const glm::vec4* pixels, const glm::vec4& mean){
+    glm::mat4 covariance(0.0f);
+    glm::vec4 low(255.0f), high(0.0f);
+    for (int i = 0; i < 16; i++){
+        glm::vec4 d = pixels[i] - mean;
+        covariance += glm::outerProduct(d, d);
+        low = glm::min(low, pixels[i]);
+        high = glm::max(high, pixels[i]);
+    }
+    glm::vec4 axis = high - low;
+    if (glm::dot(axis, axis) < 1e-4f)
+        return glm::vec4(0.0f);
+    for (int i = 0; i < 8; i++){
+        glm::vec4 next = covariance * axis;
+        float length = glm::length(next);
+        if (length < 1e-6f)
+            break;
+        axis = next / length;
+    }
+    return glm::normalize(axis);
+}
+
+// the ends of the pixels' extent along axis
+static void fitAxis(const glm::vec4* pixels, const glm::vec4& mean, const glm::vec4& axis, glm::vec4& low, glm::vec4& high){
+    float minT = 0.0f, maxT = 0.0f;
+    for (int i = 0; i < 16; i++){
+        float t = glm::dot(pixels[i] - mean, axis);
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    low = glm::clamp(mean + axis * minT, 0.0f, 255.0f);
+    high = glm::clamp(mean + axis * maxT, 0.0f, 255.0f);
+}
+
+// endpoints a and b that minimise the squared error of pixels placed at weights
+// between them. false when the weights can't pin both down, e.g. all the same
+static bool fitEndpoints(const glm::vec4* pixels, const float* weights, glm::vec4& a, glm::vec4& b){
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    glm::vec4 ax(0.0f), bx(0.0f);
+    for (int i = 0; i < 16; i++){
+        float t = weights[i], s = 1.0f - t;
+        aa += s * s;
+        ab += s * t;
+        bb += t * t;
+        ax += s * pixels[i];
+        bx += t * pixels[i];
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f)
+        return false;
+    a = glm::clamp((ax * bb - bx * ab) / determinant, 0.0f, 255.0f);
+    b = glm::clamp((bx * aa - ax * ab) / determinant, 0.0f, 255.0f);
+    return true;
+}
+
+static uint16_t to565(const glm::vec4& color){
+    int r = (int)std::lround(color.r * 31.0f / 255.0f);
+    int g = (int)std::lround(color.g * 63.0f / 255.0f);
+    int b = (int)std::lround(color.b * 31.0f / 255.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void from565(uint16_t color, int* out){
+    int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+// the colours a BC1 block can pick from. BC3's colour block always has four,
+// BC1 drops to three and transparent black when c0 <= c1
+static void colorPalette(uint16_t c0, uint16_t c1, bool fourColors, uint8_t palette[4][4]){
+    int e0[3], e1[3];
+    from565(c0, e0);
+    from565(c1, e1);
+    for (int c = 0; c < 3; c++){
+        palette[0][c] = (uint8_t)e0[c];
+        palette[1][c] = (uint8_t)e1[c];
+        if (fourColors || c0 > c1){
+            palette[2][c] = (uint8_t)((2 * e0[c] + e1[c]) / 3);
+            palette[3][c] = (uint8_t)((e0[c] + 2 * e1[c]) / 3);
+        } else {
+            palette[2][c] = (uint8_t)((e0[c] + e1[c]) / 2);
+            palette[3][c] = 0;
+        }
+    }
+    for (int i = 0; i < 4; i++)
+        palette[i][3] = 255;
+    if (!fourColors && c0 <= c1)
+        palette[3][3] = 0;
+}
+
+// the 8 byte colour block shared by BC1 and BC3, always in four colour mode
+static void encodeColor(const uint8_t* rgba, uint8_t* block){
+    glm::vec4 pixels[16];
+    loadBlock(rgba, pixels, false);
+    glm::vec4 mean = getMean(pixels);
+    glm::vec4 low, high;
+    fitAxis(pixels, mean, getPrincipalAxis(pixels, mean), low, high);
+
+    float bestError = std::numeric_limits<float>::max();
+    uint16_t bestC0 = 0, bestC1 = 0;
+    uint8_t bestIndices[16] = {};
+    for (int iteration = 0; iteration < 3; iteration++){
+        uint16_t c0 = to565(high), c1 = to565(low);
+        if (c0 < c1)
+            std::swap(c0, c1);
+        uint8_t palette[4][4];
+        colorPalette(c0, c1, true, palette);
+        // equal endpoints read as three colour mode, where index 3 is black
+        int usable = c0 == c1 ? 1 : 4;
+
+        float error = 0.0f;
+        uint8_t indices[16];
+        float weights[16];
+        for (int i = 0; i < 16; i++){
+            float nearest = std::numeric_limits<float>::max();
+            for (int j = 0; j < usable; j++){
+                float e = squaredColorError(pixels[i], palette[j]);
+                if (e < nearest){
+                    nearest = e;
+                    indices[i] = (uint8_t)j;
+                }
+            }
+            error += nearest;
+            weights[i] = BC1_WEIGHTS[indices[i]];
+        }
+        if (error < bestError){
+            bestError = error;
+            bestC0 = c0;
+            bestC1 = c1;
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+        // the palette runs from c0 to c1, so the fit's first endpoint is the high one
+        if (bestError == 0.0f || !fitEndpoints(pixels, weights, high, low))
+            break;
+    }
+
+    memset(block, 0, 8);
+    BitWriter writer{block};
+    writer.write(bestC0, 16);
+    writer.write(bestC1, 16);
+    for (int i = 0; i < 16; i++)
+        writer.write(bestIndices[i], 2);
+}
+
+static void decodeColor(const uint8_t* block, bool fourColors, uint8_t* rgba){
+    BitReader reader{block};
+    uint16_t c0 = (uint16_t)reader.read(16);
+    uint16_t c1 = (uint16_t)reader.read(16);
+    uint8_t palette[4][4];
+    colorPalette(c0, c1, fourColors, palette);
+    for (int i = 0; i < 16; i++)
+        memcpy(rgba + i * 4, palette[reader.read(2)], 4);
+}
+
+// BC3's alpha values. a0 > a1 spreads 8 levels between them, otherwise 6 with 0 and 255 added
+static void alphaPalette(int a0, int a1, int palette[8]){
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1){
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    } else {
+        for (int i = 1; i < 5; i++)
+            palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static int pickAlphaIndices(const uint8_t* rgba, int a0, int a1, uint8_t* indices){
+    int palette[8];
+    alphaPalette(a0, a1, palette);
+    int error = 0;
+    for (int i = 0; i < 16; i++){
+        int nearest = std::numeric_limits<int>::max();
+        for (int j = 0; j < 8; j++){
+            int d = rgba[i * 4 + 3] - palette[j];
+            if (d * d < nearest){
+                nearest = d * d;
+                indices[i] = (uint8_t)j;
+            }
+        }
+        error += nearest;
+    }
+    return error;
+}
+
+// tries the 8 level mode over the full range and the 6 level mode over the
+// values between the extremes, which blocks with cut out edges prefer
+static void encodeAlpha(const uint8_t* rgba, uint8_t* block){
+    int low = 255, high = 0, innerLow = 255, innerHigh = 0;
+    for (int i = 0; i < 16; i++){
+        int a = rgba[i * 4 + 3];
+        low = std::min(low, a);
+        high = std::max(high, a);
+        if (a != 0 && a != 255){
+            innerLow = std::min(innerLow, a);
+            innerHigh = std::max(innerHigh, a);
+        }
+    }
+    if (innerLow > innerHigh)
+        innerLow = innerHigh = 0;
+
+    uint8_t indices[16], innerIndices[16];
+    int a0 = high, a1 = low;
+    int error = pickAlphaIndices(rgba, a0, a1, indices);
+    if (pickAlphaIndices(rgba, innerLow, innerHigh, innerIndices) < error){
+        a0 = innerLow;
+        a1 = innerHigh;
+        memcpy(indices, innerIndices, sizeof(indices));
+    }
+
+    memset(block, 0, 8);
+    BitWriter writer{block};
+    writer.write((uint32_t)a0, 8);
+    writer.write((uint32_t)a1, 8);
+    for (int i = 0; i < 16; i++)
+        writer.write(indices[i], 3);
+}
+
+static void decodeAlpha(const uint8_t* block, uint8_t* rgba){
+    BitReader reader{block};
+    int a0 = (int)reader.read(8);
+    int a1 = (int)reader.read(8);
+    int palette[8];
+    alphaPalette(a0, a1, palette);
+    for (int i = 0; i < 16; i++)
+        rgba[i * 4 + 3] = (uint8_t)palette[reader.read(3)];
+}
+
+// BC7 mode 6 endpoints are 7 bits a channel plus a p bit, the shared lowest bit
+static void quantizeBc7(const glm::vec4& endpoint, int p, int* out){
+    for (int c = 0; c < 4; c++){
+        int value = (int)std::lround((endpoint[c] - p) * 0.5f);
+        out[c] = (std::clamp(value, 0, 127) << 1) | p;
+    }
+}
+
+static void bc7Palette(const int* e0, const int* e1, uint8_t palette[16][4]){
+    for (int i = 0; i < 16; i++){
+        for (int c = 0; c < 4; c++)
+            palette[i][c] = (uint8_t)(((64 - BC7_WEIGHTS[i]) * e0[c] + BC7_WEIGHTS[i] * e1[c] + 32) >> 6);
+    }
+}
+
+// nearest palette entries for the block. the entries lie on a line, so each pixel
+// only checks the ones next to its projection onto it
+static float pickBc7Indices(const glm::vec4* pixels, const int* e0, const int* e1, uint8_t* indices){
+    uint8_t palette[16][4];
+    bc7Palette(e0, e1, palette);
+    glm::vec4 start(e0[0], e0[1], e0[2], e0[3]);
+    glm::vec4 direction = glm::vec4(e1[0], e1[1], e1[2], e1[3]) - start;
+    float lengthSquared = glm::dot(direction, direction);
+
+    float error = 0.0f;
+    for (int i = 0; i < 16; i++){
+        float t = lengthSquared > 0.0f ? glm::dot(pixels[i] - start, direction) / lengthSquared : 0.0f;
+        int guess = std::clamp((int)std::lround(t * 15.0f), 0, 15);
+        float nearest = std::numeric_limits<float>::max();
+        for (int j = std::max(guess - 1, 0); j <= std::min(guess + 1, 15); j++){
+            float e = squaredError(pixels[i], palette[j]);
+            if (e < nearest){
+                nearest = e;
+                indices[i] = (uint8_t)j;
+            }
+        }
+        error += nearest;
+    }
+    return error;
+}
+
+static void encodeBc7(const uint8_t* rgba, uint8_t* block){
+    glm::vec4 pixels[16];
+    loadBlock(rgba, pixels, true);
+    glm::vec4 mean = getMean(pixels);
+    glm::vec4 low, high;
+    fitAxis(pixels, mean, getPrincipalAxis(pixels, mean), low, high);
+
+    float bestError = std::numeric_limits<float>::max();
+    int best0[4] = {}, best1[4] = {};
+    uint8_t bestIndices[16] = {};
+    for (int iteration = 0; iteration < 3; iteration++){
+        // every pairing of p bits, each moves its endpoint's whole lattice
+        for (int p = 0; p < 4; p++){
+            int e0[4], e1[4];
+            uint8_t indices[16];
+            quantizeBc7(low, p & 1, e0);
+            quantizeBc7(high, p >> 1, e1);
+            float error = pickBc7Indices(pixels, e0, e1, indices);
+            if (error < bestError){
+                bestError = error;
+                memcpy(best0, e0, sizeof(e0));
+                memcpy(best1, e1, sizeof(e1));
+                memcpy(bestIndices, indices, sizeof(indices));
+            }
+        }
+        float weights[16];
+        for (int i = 0; i < 16; i++)
+            weights[i] = BC7_WEIGHTS[bestIndices[i]] / 64.0f;
+        if (bestError == 0.0f || !fitEndpoints(pixels, weights, low, high))
+            break;
+    }
+
+    // the first pixel's index is stored without its top bit, so it has to be below 8
+    if (bestIndices[0] >= 8){
+        std::swap(best0, best1);
+        for (int i = 0; i < 16; i++)
+            bestIndices[i] = (uint8_t)(15 - bestIndices[i]);
+    }
+
+    memset(block, 0, 16);
+    BitWriter writer{block};
+    writer.write(1 << 6, 7);
+    for (int c = 0; c < 4; c++){
+        writer.write((uint32_t)best0[c] >> 1, 7);
+        writer.write((uint32_t)best1[c] >> 1, 7);
+    }
+    writer.write((uint32_t)best0[0] & 1, 1);
+    writer.write((uint32_t)best1[0] & 1, 1);
+    writer.write(bestIndices[0], 3);
+    for (int i = 1; i < 16; i++)
+        writer.write(bestIndices[i], 4);
+}
+
+// mode 6 only, the one the encoder writes. blocks in other modes come out transparent black
+static void decodeBc7(const uint8_t* block, uint8_t* rgba){
+    BitReader reader{block};
+    if (reader.read(7) != (1 << 6)){
+        memset(rgba, 0, 64);
+        return;
+    }
+    int e0[4], e1[4];
+    for (int c = 0; c < 4; c++){
+        e0[c] = (int)reader.read(7) << 1;
+        e1[c] = (int)reader.read(7) << 1;
+    }
+    int p0 = (int)reader.read(1), p1 = (int)reader.read(1);
+    for (int c = 0; c < 4; c++){
+        e0[c] |= p0;
+        e1[c] |= p1;
+    }
+    uint8_t palette[16][4];
+    bc7Palette(e0, e1, palette);
+    for (int i = 0; i < 16; i++)
+        memcpy(rgba + i * 4, palette[reader.read(i == 0 ? 3 : 4)], 4);
+}
+
+size_t BlockCompression::getBlockBytes(BlockFormat format){
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t BlockCompression::getImageBytes(BlockFormat format, int width, int height){
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockBytes(format);
+}
+
+const char* BlockCompression::getName(BlockFormat format){
+    switch (format){
+    case BlockFormat::BC1: return "bc1";
+    case BlockFormat::BC3: return "bc3";
+    case BlockFormat::BC7: return "bc7";
+    }
+    return "unknown";
+}
+
+void BlockCompression::encodeBlock(BlockFormat format, const uint8_t* rgba, uint8_t* block){
+    switch (format){
+    case BlockFormat::BC1:
+        encodeColor(rgba, block);
+        break;
+    case BlockFormat::BC3:
+        encodeAlpha(rgba, block);
+        encodeColor(rgba, block + 8);
+        break;
+    case BlockFormat::BC7:
+        encodeBc7(rgba, block);
+        break;
+    }
+}
+
+void BlockCompression::decodeBlock(BlockFormat format, const uint8_t* block, uint8_t* rgba){
+    switch (format){
+    case BlockFormat::BC1:
+        decodeColor(block, false, rgba);
+        break;
+    case BlockFormat::BC3:
+        decodeColor(block + 8, true, rgba);
+        decodeAlpha(block, rgba);
+        break;
+    case BlockFormat::BC7:
+        decodeBc7(block, rgba);
+        break;
+    }
+}
+
+std::vector<uint8_t> BlockCompression::encode(BlockFormat format, const uint8_t* rgba, int width, int height){
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    size_t blockBytes = getBlockBytes(format);
+    std::vector<uint8_t> blocks(getImageBytes(format, width, height));
+    ThreadPool::parallelFor((size_t)blocksY, 4, [&](unsigned int, size_t begin, size_t end){
+        uint8_t pixels[64];
+        for (size_t by = begin; by < end; by++){
+            for (int bx = 0; bx < blocksX; bx++){
+                for (int y = 0; y < 4; y++){
+                    int sourceY = std::min((int)by * 4 + y, height - 1);
+                    for (int x = 0; x < 4; x++){
+                        int sourceX = std::min(bx * 4 + x, width - 1);
+                        memcpy(pixels + (y * 4 + x) * 4, rgba + ((size_t)sourceY * width + sourceX) * 4, 4);
+                    }
+                }
+                encodeBlock(format, pixels, blocks.data() + (by * blocksX + bx) * blockBytes);
+            }
+        }
+    });
+    return blocks;
+}
+
+std::vector<uint8_t> BlockCompression::decode(BlockFormat format, const uint8_t* blocks, int width, int height){
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    size_t blockBytes = getBlockBytes(format);
+    std::vector<uint8_t> rgba((size_t)width * height * 4);
+    uint8_t pixels[64];
+    for (int by = 0; by < blocksY; by++){
+        for (int bx = 0; bx < blocksX; bx++){
+            decodeBlock(format, blocks + ((size_t)by * blocksX + bx) * blockBytes, pixels);
+            for (int y = 0; y < 4 && by * 4 + y < height; y++){
+                for (int x = 0; x < 4 && bx * 4 + x < width; x++)
+                    memcpy(rgba.data() + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4, pixels + (y * 4 + x) * 4, 4);
+            }
+        }
+    }
+    return rgba;
+}
+
+double BlockCompression::psnr(const uint8_t* a, const uint8_t* b, size_t pixels, bool alpha){
+    int channels = alpha ? 4 : 3;
+    double sum = 0.0;
+    for (size_t i = 0; i < pixels; i++){
+        for (int c = 0; c < channels; c++){
+            double d = (double)a[i * 4 + c] - b[i * 4 + c];
+            sum += d * d;
+        }
+    }
+    double mse = sum / ((double)pixels * channels);
+    return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+}
+
+void BlockCompression::benchmark(const std::string& imagePath, unsigned int iterations){
+    DecodedImage image;
+    if (!ImageDecoder::decode(imagePath, 4, image))
+        return;
+    size_t pixels = (size_t)image.width * image.height;
+    std::cout << imagePath << ": " << image.width << "x" << image.height << ", "
+              << ThreadPool::getThreadCount() << " threads" << std::endl;
+
+    for (BlockFormat format : {BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC7}){
+        std::vector<uint8_t> blocks;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < std::max(iterations, 1u); i++)
+            blocks = encode(format, image.pixels, image.width, image.height);
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / std::max(iterations, 1u);
+
+        std::vector<uint8_t> decoded = decode(format, blocks.data(), image.width, image.height);
+        std::cout << getName(format) << ": " << milliseconds << " ms, "
+                  << pixels / (milliseconds * 1000.0) << " megapixels/s, psnr "
+                  << psnr(image.pixels, decoded.data(), pixels, false) << " dB rgb";
+        if (format != BlockFormat::BC1)
+            std::cout << ", " << psnr(image.pixels, decoded.data(), pixels, true) << " dB rgba";
+        std::cout << ", " << pixels * 4.0 / blocks.size() << "x smaller than rgba8" << std::endl;
+    }
+}
@@ -0,0 +1,144 @@
+#include "graphics/compressedTexture.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "graphics/imageDecoder.hpp"
+
+static const char MAGIC[4] = {'G', 'L', 'G', 'T'};
+// levels start on a 16 byte boundary, the size of the bigger blocks
+static const uint32_t LEVEL_ALIGNMENT = 16;
+
+struct CompressedTextureHeader{
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    CompressedTextureLevel levels[CompressedTexture::MAX_LEVELS];
+};
+
+static bool isValid(const CompressedTextureHeader& header, size_t fileSize){
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != CompressedTexture::VERSION)
+        return false;
+    BlockFormat format = (BlockFormat)header.format;
+    if (format != BlockFormat::BC1 && format != BlockFormat::BC3 && format != BlockFormat::BC7)
+        return false;
+    if (header.levelCount == 0 || header.levelCount > CompressedTexture::MAX_LEVELS)
+        return false;
+    for (uint32_t i = 0; i < header.levelCount; i++){
+        const CompressedTextureLevel& level = header.levels[i];
+        if (level.width == 0 || level.height == 0 || level.offset % LEVEL_ALIGNMENT != 0)
+            return false;
+        if (level.size != BlockCompression::getImageBytes(format, (int)level.width, (int)level.height))
+            return false;
+        if ((size_t)level.offset + level.size > fileSize)
+            return false;
+    }
+    return true;
+}
+
+bool CompressedTexture::load(const std::string& path){
+    close();
+    if (!file.open(path)){
+        std::cout << "unable to open file: " << path << std::endl;
+        return false;
+    }
+    const CompressedTextureHeader* mapped = (const CompressedTextureHeader*)file.getData();
+    if (file.getSize() < sizeof(CompressedTextureHeader) || !isValid(*mapped, file.getSize())){
+        std::cout << "not a compressed texture: " << path << std::endl;
+        file.close();
+        return false;
+    }
+    header = mapped;
+    return true;
+}
+
+void CompressedTexture::close(){
+    file.close();
+    header = nullptr;
+}
+
+BlockFormat CompressedTexture::getFormat() const{
+    return header ? (BlockFormat)header->format : BlockFormat::BC1;
+}
+
+int CompressedTexture::getWidth() const{
+    return header ? (int)header->width : 0;
+}
+
+int CompressedTexture::getHeight() const{
+    return header ? (int)header->height : 0;
+}
+
+uint32_t CompressedTexture::getLevelCount() const{
+    return header ? header->levelCount : 0;
+}
+
+CompressedTextureLevel CompressedTexture::getLevel(uint32_t level) const{
+    return header && level < header->levelCount ? header->levels[level] : CompressedTextureLevel{0, 0, 0, 0};
+}
+
+const uint8_t* CompressedTexture::getLevelData(uint32_t level) const{
+    return header && level < header->levelCount ? (const uint8_t*)file.getData() + header->levels[level].offset : nullptr;
+}
+
+size_t CompressedTexture::getBytes() const{
+    size_t bytes = 0;
+    for (uint32_t i = 0; i < getLevelCount(); i++)
+        bytes += header->levels[i].size;
+    return bytes;
+}
+
+bool CompressedTexture::cook(const DecodedImage& image, BlockFormat format, const std::string& path, MipFilter filter, bool srgb){
+    if (image.isEmpty() || image.channels != 4){
+        std::cout << "unable to cook texture: " << path << " needs rgba pixels" << std::endl;
+        return false;
+    }
+
+    CompressedTextureHeader header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.format = (uint32_t)format;
+    header.width = (uint32_t)image.width;
+    header.height = (uint32_t)image.height;
+
+    std::vector<uint8_t> file(sizeof(CompressedTextureHeader));
+    std::vector<MipLevel> mips = MipGenerator::generate(image.pixels, image.width, image.height, filter, srgb);
+    if (mips.size() + 1 > MAX_LEVELS)
+        mips.resize(MAX_LEVELS - 1);
+    for (size_t i = 0; i <= mips.size(); i++){
+        const uint8_t* pixels = i == 0 ? image.pixels : mips[i - 1].pixels.data();
+        int width = i == 0 ? image.width : mips[i - 1].width;
+        int height = i == 0 ? image.height : mips[i - 1].height;
+        std::vector<uint8_t> blocks = BlockCompression::encode(format, pixels, width, height);
+        file.resize((file.size() + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT * LEVEL_ALIGNMENT);
+        header.levels[header.levelCount++] = CompressedTextureLevel{(uint32_t)file.size(), (uint32_t)blocks.size(), (uint32_t)width, (uint32_t)height};
+        file.insert(file.end(), blocks.begin(), blocks.end());
+    }
+    memcpy(file.data(), &header, sizeof(header));
+
+    // same as the mesh cache, written aside and renamed so a half written file never loads
+    std::string temporaryPath = path + ".tmp";
+    FILE* out = fopen(temporaryPath.c_str(), "wb");
+    if (!out){
+        std::cout << "unable to write compressed texture: " << path << std::endl;
+        return false;
+    }
+    bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+    written = fclose(out) == 0 && written;
+    std::remove(path.c_str());
+    if (!written || std::rename(temporaryPath.c_str(), path.c_str()) != 0){
+        std::remove(temporaryPath.c_str());
+        std::cout << "unable to write compressed texture: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CompressedTexture::isCompressedPath(const std::string& path){
+    static const std::string EXTENSION = ".ctex";
+    return path.size() >= EXTENSION.size() && path.compare(path.size() - EXTENSION.size(), EXTENSION.size(), EXTENSION) == 0;
+}
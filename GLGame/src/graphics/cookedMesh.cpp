@@ -0,0 +1,375 @@
+#include "graphics/cookedMesh.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "graphics/meshOptimizer.hpp"
+#include "graphics/objLoader.hpp"
+
+static const char MAGIC[4] = {'G', 'L', 'G', 'M'};
+static const uint32_t VERTEX_STRIDE = sizeof(CookedVertex);
+static_assert(sizeof(CookedVertex) == 16, "Model's attribute offsets assume 16 byte vertices");
+
+struct CookedMeshHeader{
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t vertexStride;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t lodCount;
+    MeshLod lods[CookedMesh::MAX_LODS];
+    float sphereCenter[3];
+    float sphereRadius;
+    uint64_t bvhNodeOffset;
+    uint64_t bvhTriangleOffset;
+    uint32_t bvhNodeCount;
+    uint32_t bvhTriangleCount;
+};
+
+// every level of detail keeps at least this fraction of the one before, or the
+// simplifier is stuck and there are no more levels
+static const float MIN_LOD_REDUCTION = 0.9f;
+
+static bool isValid(const CookedMeshHeader& header, size_t fileSize, uint64_t sourceHash, uint64_t sourceSize){
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != CookedMesh::VERSION)
+        return false;
+    if (header.sourceHash != sourceHash || header.sourceSize != sourceSize || header.vertexStride != VERTEX_STRIDE)
+        return false;
+    uint64_t vertexEnd = header.vertexOffset + (uint64_t)header.vertexCount * VERTEX_STRIDE;
+    if (header.indexSize != sizeof(uint16_t) && header.indexSize != sizeof(uint32_t))
+        return false;
+    uint64_t indexEnd = header.indexOffset + (uint64_t)header.indexCount * header.indexSize;
+    if (header.vertexOffset < sizeof(CookedMeshHeader) || vertexEnd > fileSize || header.indexOffset < vertexEnd || indexEnd > fileSize)
+        return false;
+    if (header.lodCount == 0 || header.lodCount > CookedMesh::MAX_LODS)
+        return false;
+    for (uint32_t i = 0; i < header.lodCount; i++)
+        if ((uint64_t)header.lods[i].firstIndex + header.lods[i].indexCount > header.indexCount)
+            return false;
+    uint64_t nodeEnd = header.bvhNodeOffset + (uint64_t)header.bvhNodeCount * sizeof(BvhNode);
+    uint64_t triangleEnd = header.bvhTriangleOffset + (uint64_t)header.bvhTriangleCount * sizeof(BvhTriangle);
+    if (header.bvhNodeOffset < indexEnd || nodeEnd > fileSize || header.bvhTriangleOffset < nodeEnd || triangleEnd > fileSize)
+        return false;
+    if (header.bvhNodeOffset % alignof(BvhNode) != 0 || header.bvhTriangleOffset % alignof(BvhTriangle) != 0)
+        return false;
+    return true;
+}
+
+// round to nearest even, out of range values saturate to infinity and tiny ones flush to zero
+static uint16_t toHalf(float value){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    uint32_t magnitude = bits & 0x7fffffff;
+    if (magnitude >= 0x7f800000)
+        return sign | (magnitude > 0x7f800000 ? 0x7e00 : 0x7c00);
+    if (magnitude >= 0x477ff000)
+        return sign | 0x7c00;
+    if (magnitude < 0x38800000)
+        return sign;
+    uint32_t half = (magnitude >> 13) - (112 << 10);
+    uint32_t rest = magnitude & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return sign | (uint16_t)half;
+}
+
+static int16_t toSnorm(float value){
+    return (int16_t)std::lround(glm::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+// the unit sphere folded onto the octahedron |x| + |y| + |z| = 1, lower half
+// unfolded over the corners of the square
+static void encodeOctahedral(const glm::vec3& normal, int16_t* encoded){
+    float length = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+    glm::vec2 folded = length > 0.0f ? glm::vec2(normal) / length : glm::vec2(0.0f);
+    if (length > 0.0f && normal.z < 0.0f){
+        glm::vec2 sign = glm::vec2(folded.x >= 0.0f ? 1.0f : -1.0f, folded.y >= 0.0f ? 1.0f : -1.0f);
+        folded = (1.0f - glm::abs(glm::vec2(folded.y, folded.x))) * sign;
+    }
+    encoded[0] = toSnorm(folded.x);
+    encoded[1] = toSnorm(folded.y);
+}
+
+std::string CookedMesh::getCookedPath(const std::string& objPath){
+    size_t dot = objPath.find_last_of('.');
+    size_t slash = objPath.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return objPath + ".mesh";
+    return objPath.substr(0, dot) + ".mesh";
+}
+
+uint64_t CookedMesh::hash(const char* data, size_t size){
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++){
+        hash ^= (uint8_t)data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool CookedMesh::load(const std::string& objPath){
+    close();
+
+    MappedFile source;
+    if (!source.open(objPath)){
+        std::cout << "unable to open file: " << objPath << std::endl;
+        return false;
+    }
+    uint64_t sourceHash = hash(source.getData(), source.getSize());
+    uint64_t sourceSize = source.getSize();
+    source.close();
+
+    std::string cookedPath = getCookedPath(objPath);
+    if (file.open(cookedPath) && file.getSize() >= sizeof(CookedMeshHeader)){
+        const CookedMeshHeader* mapped = (const CookedMeshHeader*)file.getData();
+        if (isValid(*mapped, file.getSize(), sourceHash, sourceSize)){
+            header = mapped;
+            return true;
+        }
+    }
+    file.close();
+
+    return cook(objPath, cookedPath, sourceHash, sourceSize);
+}
+
+bool CookedMesh::cook(const std::string& objPath, const std::string& cookedPath, uint64_t sourceHash, uint64_t sourceSize){
+    std::vector<float> vertexArray;
+    std::vector<int> indexArray;
+    if (!OBJLoader::loadFromFile(objPath, vertexArray, indexArray))
+        return false;
+
+    // obj face order is whatever the exporter wrote, reorder once here for the gpu's caches
+    size_t vertexCount = vertexArray.size() / 8;
+    float acmrBefore = computeACMR(indexArray, vertexCount);
+    optimizeVertexCache(indexArray, vertexCount);
+    optimizeOverdraw(indexArray, vertexArray, 8);
+    float acmrAfter = computeACMR(indexArray, vertexCount);
+
+    // each level halves the triangles of the one before
+    std::vector<MeshLod> lods = {MeshLod{0, (uint32_t)indexArray.size(), 0.0f}};
+    std::vector<int> previous = indexArray;
+    std::vector<int> simplified;
+    while (lods.size() < MAX_LODS){
+        float error = simplifyMesh(simplified, previous, vertexArray, 8, previous.size() / 2);
+        if (simplified.empty() || simplified.size() > previous.size() * MIN_LOD_REDUCTION)
+            break;
+        optimizeVertexCache(simplified, vertexCount);
+        lods.push_back(MeshLod{(uint32_t)indexArray.size(), (uint32_t)simplified.size(), lods.back().error + error});
+        indexArray.insert(indexArray.end(), simplified.begin(), simplified.end());
+        previous.swap(simplified);
+    }
+    // vertices follow the full detail level's order, the others mostly reuse them
+    optimizeVertexFetch(vertexArray, indexArray, 8);
+
+    std::cout << "cooked " << cookedPath << ": ";
+    for (size_t i = 0; i < lods.size(); i++)
+        std::cout << (i == 0 ? "" : "/") << lods[i].indexCount / 3;
+    std::cout << " triangles, acmr " << acmrBefore << " -> " << acmrAfter << std::endl;
+
+    glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+    for (size_t i = 0; i + 2 < vertexArray.size(); i += 8){
+        glm::vec3 position = glm::vec3(vertexArray[i], vertexArray[i + 1], vertexArray[i + 2]);
+        boundsMin = i == 0 ? position : glm::min(boundsMin, position);
+        boundsMax = i == 0 ? position : glm::max(boundsMax, position);
+    }
+
+    // centered on the box, which is never far from the smallest sphere
+    glm::vec3 sphereCenter = (boundsMin + boundsMax) * 0.5f;
+    float sphereRadius = 0.0f;
+    for (size_t i = 0; i + 2 < vertexArray.size(); i += 8)
+        sphereRadius = glm::max(sphereRadius, glm::length(glm::vec3(vertexArray[i], vertexArray[i + 1], vertexArray[i + 2]) - sphereCenter));
+
+    // picking hits the full detail level, on the float positions before quantization
+    MeshBvh bvh;
+    bvh.build(vertexArray, 8, indexArray.data(), lods[0].indexCount);
+
+    // positions become fractions of the bounds, the shaders scale them back
+    std::vector<CookedVertex> packed(vertexArray.size() / 8);
+    glm::vec3 extent = boundsMax - boundsMin;
+    for (size_t i = 0; i < packed.size(); i++){
+        const float* vertex = &vertexArray[i * 8];
+        CookedVertex& out = packed[i];
+        for (int axis = 0; axis < 3; axis++){
+            float fraction = extent[axis] > 0.0f ? (vertex[axis] - boundsMin[axis]) / extent[axis] : 0.0f;
+            out.position[axis] = (uint16_t)std::lround(glm::clamp(fraction, 0.0f, 1.0f) * 65535.0f);
+        }
+        out.padding = 0;
+        out.texCoord[0] = toHalf(vertex[3]);
+        out.texCoord[1] = toHalf(vertex[4]);
+        encodeOctahedral(glm::vec3(vertex[5], vertex[6], vertex[7]), out.normal);
+    }
+    // no primitive restart, so 0xffff is an ordinary index
+    uint32_t indexSize = packed.size() <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    CookedMeshHeader cookedHeader{};
+    memcpy(cookedHeader.magic, MAGIC, sizeof(MAGIC));
+    cookedHeader.version = VERSION;
+    cookedHeader.sourceHash = sourceHash;
+    cookedHeader.sourceSize = sourceSize;
+    cookedHeader.vertexStride = VERTEX_STRIDE;
+    cookedHeader.vertexCount = (uint32_t)packed.size();
+    cookedHeader.indexCount = (uint32_t)indexArray.size();
+    cookedHeader.indexSize = indexSize;
+    cookedHeader.vertexOffset = sizeof(CookedMeshHeader);
+    cookedHeader.indexOffset = cookedHeader.vertexOffset + (uint64_t)cookedHeader.vertexCount * VERTEX_STRIDE;
+    uint64_t indexEnd = cookedHeader.indexOffset + (uint64_t)cookedHeader.indexCount * indexSize;
+    cookedHeader.bvhNodeOffset = (indexEnd + 7) & ~(uint64_t)7;
+    cookedHeader.bvhNodeCount = (uint32_t)bvh.getNodes().size();
+    cookedHeader.bvhTriangleOffset = cookedHeader.bvhNodeOffset + (uint64_t)cookedHeader.bvhNodeCount * sizeof(BvhNode);
+    cookedHeader.bvhTriangleCount = (uint32_t)bvh.getTriangles().size();
+    cookedHeader.lodCount = (uint32_t)lods.size();
+    for (size_t i = 0; i < lods.size(); i++)
+        cookedHeader.lods[i] = lods[i];
+
+    memcpy(cookedHeader.boundsMin, &boundsMin[0], sizeof(cookedHeader.boundsMin));
+    memcpy(cookedHeader.boundsMax, &boundsMax[0], sizeof(cookedHeader.boundsMax));
+    memcpy(cookedHeader.sphereCenter, &sphereCenter[0], sizeof(cookedHeader.sphereCenter));
+    cookedHeader.sphereRadius = sphereRadius;
+
+    image.resize(cookedHeader.bvhTriangleOffset + (size_t)cookedHeader.bvhTriangleCount * sizeof(BvhTriangle));
+    memcpy(image.data(), &cookedHeader, sizeof(cookedHeader));
+    if (!packed.empty())
+        memcpy(image.data() + cookedHeader.vertexOffset, packed.data(), packed.size() * sizeof(CookedVertex));
+    for (size_t i = 0; i < indexArray.size(); i++){
+        char* destination = image.data() + cookedHeader.indexOffset + i * indexSize;
+        if (indexSize == sizeof(uint16_t)){
+            uint16_t index = (uint16_t)indexArray[i];
+            memcpy(destination, &index, sizeof(index));
+        } else {
+            uint32_t index = (uint32_t)indexArray[i];
+            memcpy(destination, &index, sizeof(index));
+        }
+    }
+    if (!bvh.isEmpty()){
+        memcpy(image.data() + cookedHeader.bvhNodeOffset, bvh.getNodes().data(), bvh.getNodes().size() * sizeof(BvhNode));
+        memcpy(image.data() + cookedHeader.bvhTriangleOffset, bvh.getTriangles().data(), bvh.getTriangles().size() * sizeof(BvhTriangle));
+    }
+    header = (const CookedMeshHeader*)image.data();
+    cooked = true;
+
+    // written beside the obj and renamed into place, a half written cache is never picked up.
+    // failing to write only costs the next start another parse
+    std::string temporaryPath = cookedPath + ".tmp";
+    FILE* out = fopen(temporaryPath.c_str(), "wb");
+    if (!out){
+        std::cout << "unable to write cooked mesh: " << cookedPath << std::endl;
+        return true;
+    }
+    bool written = fwrite(image.data(), 1, image.size(), out) == image.size();
+    written = fclose(out) == 0 && written;
+    std::remove(cookedPath.c_str());
+    if (!written || std::rename(temporaryPath.c_str(), cookedPath.c_str()) != 0){
+        std::remove(temporaryPath.c_str());
+        std::cout << "unable to write cooked mesh: " << cookedPath << std::endl;
+    }
+    return true;
+}
+
+void CookedMesh::close(){
+    file.close();
+    image.clear();
+    image.shrink_to_fit();
+    header = nullptr;
+    cooked = false;
+}
+
+const char* CookedMesh::getBytes() const{
+    return (const char*)header;
+}
+
+const CookedVertex* CookedMesh::getVertices() const{
+    return header ? (const CookedVertex*)(getBytes() + header->vertexOffset) : nullptr;
+}
+
+const void* CookedMesh::getIndices() const{
+    return header ? getBytes() + header->indexOffset : nullptr;
+}
+
+uint32_t CookedMesh::getVertexCount() const{
+    return header ? header->vertexCount : 0;
+}
+
+uint32_t CookedMesh::getIndexSize() const{
+    return header ? header->indexSize : sizeof(uint32_t);
+}
+
+uint32_t CookedMesh::getIndexCount() const{
+    return header ? header->indexCount : 0;
+}
+
+uint32_t CookedMesh::getLodCount() const{
+    return header ? header->lodCount : 0;
+}
+
+MeshLod CookedMesh::getLod(uint32_t lod) const{
+    return header && lod < header->lodCount ? header->lods[lod] : MeshLod{0, 0, 0.0f};
+}
+
+glm::vec3 CookedMesh::getBoundsMin() const{
+    return header ? glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]) : glm::vec3(0.0f);
+}
+
+glm::vec3 CookedMesh::getBoundsMax() const{
+    return header ? glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]) : glm::vec3(0.0f);
+}
+
+glm::vec3 CookedMesh::getBoundingSphereCenter() const{
+    return header ? glm::vec3(header->sphereCenter[0], header->sphereCenter[1], header->sphereCenter[2]) : glm::vec3(0.0f);
+}
+
+float CookedMesh::getBoundingSphereRadius() const{
+    return header ? header->sphereRadius : 0.0f;
+}
+
+const BvhNode* CookedMesh::getBvhNodes() const{
+    return header ? (const BvhNode*)(getBytes() + header->bvhNodeOffset) : nullptr;
+}
+
+uint32_t CookedMesh::getBvhNodeCount() const{
+    return header ? header->bvhNodeCount : 0;
+}
+
+const BvhTriangle* CookedMesh::getBvhTriangles() const{
+    return header ? (const BvhTriangle*)(getBytes() + header->bvhTriangleOffset) : nullptr;
+}
+
+uint32_t CookedMesh::getBvhTriangleCount() const{
+    return header ? header->bvhTriangleCount : 0;
+}
+
+void CookedMesh::benchmark(const std::string& objPath, unsigned int iterations){
+    auto now = []{ return std::chrono::steady_clock::now(); };
+    auto milliseconds = [](std::chrono::steady_clock::duration duration){
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+
+    std::remove(getCookedPath(objPath).c_str());
+    CookedMesh mesh;
+    auto start = now();
+    if (!mesh.load(objPath))
+        return;
+    double cold = milliseconds(now() - start);
+    bool cookedCold = mesh.wasCooked();
+
+    unsigned int hits = 0;
+    start = now();
+    for (unsigned int i = 0; i < iterations; i++){
+        mesh.load(objPath);
+        hits += mesh.wasCooked() ? 0 : 1;
+    }
+    double warm = iterations > 0 ? milliseconds(now() - start) / iterations : 0.0;
+
+    std::cout << objPath << ": " << mesh.getVertexCount() << " vertices, " << mesh.getLodCount() << " levels of detail" << std::endl;
+    std::cout << "cold load (parse and cook): " << cold << " ms" << (cookedCold ? "" : " (cache was not rebuilt)") << std::endl;
+    std::cout << "warm load (hash and map): " << warm << " ms, " << hits << "/" << iterations << " cache hits" << std::endl;
+}
@@ -0,0 +1,92 @@
+#include "graphics/frustum.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_SSE2
+#include <emmintrin.h>
+#endif
+
+Frustum::Frustum(const glm::mat4& viewProjection){
+    set(viewProjection);
+}
+
+void Frustum::set(const glm::mat4& viewProjection){
+    // glm is column major, row i of the matrix is m[0][i], m[1][i], m[2][i], m[3][i]
+    const glm::mat4& m = viewProjection;
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+    planes[0] = rows[3] + rows[0];  // left
+    planes[1] = rows[3] - rows[0];  // right
+    planes[2] = rows[3] + rows[1];  // bottom
+    planes[3] = rows[3] - rows[1];  // top
+    planes[4] = rows[3] + rows[2];  // near
+    planes[5] = rows[3] - rows[2];  // far
+
+    for (int i = 0; i < 8; i++){
+        glm::vec4 plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        if (i < 6){
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+            plane = planes[i];
+        }
+        planeX[i] = plane.x;
+        planeY[i] = plane.y;
+        planeZ[i] = plane.z;
+        planeW[i] = plane.w;
+    }
+    enabled = true;
+}
+
+bool Frustum::isBoxVisible(const glm::vec3& min, const glm::vec3& max) const{
+    if (!enabled)
+        return true;
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extents = (max - min) * 0.5f;
+
+#ifdef FRUSTUM_SSE2
+    // distance of the center plus the box's projected radius, negative means outside
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    __m128 ex = _mm_set1_ps(extents.x), ey = _mm_set1_ps(extents.y), ez = _mm_set1_ps(extents.z);
+    for (int group = 0; group < 8; group += 4){
+        __m128 nx = _mm_load_ps(planeX + group);
+        __m128 ny = _mm_load_ps(planeY + group);
+        __m128 nz = _mm_load_ps(planeZ + group);
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                                     _mm_add_ps(_mm_mul_ps(nz, cz), _mm_load_ps(planeW + group)));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(nx, absMask), ex), _mm_mul_ps(_mm_and_ps(ny, absMask), ey)),
+                                   _mm_mul_ps(_mm_and_ps(nz, absMask), ez));
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps())) != 0)
+            return false;
+    }
+    return true;
+#else
+    for (const glm::vec4& plane : planes){
+        float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+        float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+        if (distance + radius < 0.0f)
+            return false;
+    }
+    return true;
+#endif
+}
+
+bool Frustum::isBoxVisible(const glm::vec3& min, const glm::vec3& max, const glm::mat4& transform) const{
+    if (!enabled)
+        return true;
+    // world space box around the transformed one (Arvo)
+    glm::vec3 center = glm::vec3(transform * glm::vec4((min + max) * 0.5f, 1.0f));
+    glm::vec3 extents = (max - min) * 0.5f;
+    glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])));
+    glm::vec3 worldExtents = absolute * extents;
+    return isBoxVisible(center - worldExtents, center + worldExtents);
+}
+
+bool Frustum::isSphereVisible(const glm::vec3& center, float radius) const{
+    if (!enabled)
+        return true;
+    for (const glm::vec4& plane : planes)
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    return true;
+}
@@ -0,0 +1,121 @@
+#include "graphics/imageDecoder.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <utility>
+#include "core/threadPool.hpp"
+#include "graphics/stb_image.h"
+
+DecodedImage::DecodedImage(DecodedImage&& other) noexcept
+    : pixels(other.pixels), width(other.width), height(other.height), channels(other.channels){
+    other.pixels = nullptr;
+}
+
+DecodedImage& DecodedImage::operator=(DecodedImage&& other) noexcept{
+    std::swap(pixels, other.pixels);
+    std::swap(width, other.width);
+    std::swap(height, other.height);
+    std::swap(channels, other.channels);
+    return *this;
+}
+
+DecodedImage::~DecodedImage(){
+    stbi_image_free(pixels);
+}
+
+bool ImageDecoder::decode(const std::string& path, int channels, DecodedImage& image){
+    int fileChannels;
+    stbi_set_flip_vertically_on_load_thread(true);
+    image = DecodedImage{};
+    image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &fileChannels, channels);
+    if (!image.pixels){
+        std::cout << "Failed to load texture: " << path << std::endl;
+        return false;
+    }
+    image.channels = channels != 0 ? channels : fileChannels;
+    return true;
+}
+
+bool ImageDecoder::getSize(const std::string& path, int& width, int& height){
+    int fileChannels;
+    if (!stbi_info(path.c_str(), &width, &height, &fileChannels)){
+        std::cout << "Failed to load texture: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::vector<DecodedImage> ImageDecoder::decodeAll(const std::vector<std::string>& paths, int channels){
+    std::vector<DecodedImage> images(paths.size());
+    // images differ a lot in size, so every range takes the next one as it gets
+    // free instead of owning a fixed slice
+    std::atomic<size_t> next{0};
+    ThreadPool::parallelFor(ThreadPool::getRangeCount(paths.size(), 1), 1, [&](unsigned int, size_t, size_t){
+        for (size_t i = next++; i < paths.size(); i = next++)
+            decode(paths[i], channels, images[i]);
+    });
+    return images;
+}
+
+static uint64_t checksum(const std::vector<DecodedImage>& images){
+    uint64_t hash = 14695981039346656037ull;
+    for (const DecodedImage& image : images){
+        size_t size = (size_t)image.width * image.height * image.channels;
+        for (size_t i = 0; i < size; i += 61){
+            hash ^= image.pixels[i];
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+void ImageDecoder::benchmark(const std::string& directory, unsigned int iterations){
+    std::vector<std::string> files;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)){
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c){ return (char)std::tolower(c); });
+        if (extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".bmp" || extension == ".tga")
+            files.push_back(entry.path().string());
+    }
+    if (files.empty()){
+        std::cout << "no images in " << directory << std::endl;
+        return;
+    }
+    std::sort(files.begin(), files.end());
+
+    std::vector<std::string> paths;
+    for (unsigned int i = 0; i < std::max(iterations, 1u); i++)
+        paths.insert(paths.end(), files.begin(), files.end());
+
+    auto now = []{ return std::chrono::steady_clock::now(); };
+    auto milliseconds = [](std::chrono::steady_clock::duration duration){
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+
+    auto start = now();
+    std::vector<DecodedImage> serial(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+        decode(paths[i], 4, serial[i]);
+    double serialTime = milliseconds(now() - start);
+
+    start = now();
+    std::vector<DecodedImage> parallel = decodeAll(paths, 4);
+    double parallelTime = milliseconds(now() - start);
+
+    size_t pixels = 0;
+    for (const DecodedImage& image : serial)
+        pixels += (size_t)image.width * image.height;
+
+    std::cout << directory << ": " << files.size() << " images x " << iterations << ", "
+              << pixels / 1.0e6 << " megapixels" << std::endl;
+    std::cout << "one thread: " << serialTime << " ms" << std::endl;
+    std::cout << ThreadPool::getThreadCount() << " threads: " << parallelTime << " ms, "
+              << (parallelTime > 0.0 ? serialTime / parallelTime : 0.0) << "x, pixels "
+              << (checksum(serial) == checksum(parallel) ? "match" : "differ") << std::endl;
+}
@@ -0,0 +1,526 @@
+#include "graphics/meshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+// fifo cache of the size most hardware is assumed to have, only used to measure
+static const unsigned int FIFO_CACHE_SIZE = 16;
+// lru cache size and score curve from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+static const int LRU_CACHE_SIZE = 32;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+static const int MAX_VALENCE_SCORE = 64;
+
+// a fifo cache as timestamps. a vertex is cached when it missed within the last
+// cacheSize misses; reset() makes every vertex miss again
+class FifoCache{
+public:
+    FifoCache(size_t vertexCount, unsigned int cacheSize) : cacheSize(cacheSize), time(cacheSize + 1), stamps(vertexCount, 0){}
+
+    // true when the vertex had to be transformed
+    bool access(int vertex){
+        if (time - stamps[vertex] <= cacheSize)
+            return false;
+        stamps[vertex] = time++;
+        return true;
+    }
+
+    void reset(){
+        time += cacheSize + 1;
+    }
+
+private:
+    unsigned int cacheSize;
+    unsigned int time;
+    std::vector<unsigned int> stamps;
+};
+
+float computeACMR(const std::vector<int>& indices, size_t vertexCount, unsigned int cacheSize){
+    if (indices.size() < 3)
+        return 0.0f;
+    FifoCache cache(vertexCount, cacheSize);
+    size_t misses = 0;
+    for (int index : indices)
+        misses += cache.access(index) ? 1 : 0;
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+struct ScoreTables{
+    float cache[LRU_CACHE_SIZE];
+    float valence[MAX_VALENCE_SCORE];
+
+    ScoreTables(){
+        for (int i = 0; i < LRU_CACHE_SIZE; i++){
+            // the last triangle's vertices get a fixed score so it isn't simply repeated
+            if (i < 3)
+                cache[i] = LAST_TRIANGLE_SCORE;
+            else
+                cache[i] = std::pow(1.0f - (float)(i - 3) / (LRU_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+        }
+        valence[0] = 0.0f;
+        for (int i = 1; i < MAX_VALENCE_SCORE; i++)
+            valence[i] = VALENCE_BOOST_SCALE * std::pow((float)i, -VALENCE_BOOST_POWER);
+    }
+
+    // vertices with few triangles left are preferred so they leave the cache for good
+    float score(int cachePosition, unsigned int remaining) const{
+        if (remaining == 0)
+            return -1.0f;
+        float result = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+        return result + valence[std::min<unsigned int>(remaining, MAX_VALENCE_SCORE - 1)];
+    }
+};
+
+void optimizeVertexCache(std::vector<int>& indices, size_t vertexCount){
+    static const ScoreTables tables;
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // triangles of every vertex, the first `remaining` entries are not emitted yet
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        remaining[indices[i]]++;
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<unsigned int> filled(vertexCount, 0);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++){
+            int v = indices[t * 3 + k];
+            adjacency[offsets[v] + filled[v]++] = (unsigned int)t;
+        }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = tables.score(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+    std::vector<int> output;
+    output.reserve(triangleCount * 3);
+    int cache[LRU_CACHE_SIZE + 3];
+    int cacheCount = 0;
+    int newCache[LRU_CACHE_SIZE + 3];
+
+    size_t best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+    size_t scanFrom = 0;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++){
+        // no candidate in the cache, continue with the next untouched triangle in file order
+        if (best == triangleCount){
+            while (emitted[scanFrom])
+                scanFrom++;
+            best = scanFrom;
+        }
+        const int* triangle = &indices[best * 3];
+        output.insert(output.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        // the triangle's vertices move to the front, the rest keep their order
+        int newCount = 0;
+        for (int k = 0; k < 3; k++){
+            int v = triangle[k];
+            newCache[newCount++] = v;
+            unsigned int* list = &adjacency[offsets[v]];
+            for (unsigned int i = 0; i < remaining[v]; i++)
+                if (list[i] == best){
+                    std::swap(list[i], list[remaining[v] - 1]);
+                    remaining[v]--;
+                    break;
+                }
+        }
+        for (int i = 0; i < cacheCount; i++){
+            int v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                newCache[newCount++] = v;
+        }
+        // whatever falls off the end scores as uncached again
+        for (int i = LRU_CACHE_SIZE; i < newCount; i++)
+            cachePosition[newCache[i]] = -1;
+        cacheCount = std::min(newCount, LRU_CACHE_SIZE);
+
+        float bestScore = -1.0f;
+        best = triangleCount;
+        for (int i = 0; i < newCount; i++){
+            int v = newCache[i];
+            if (i < LRU_CACHE_SIZE){
+                cache[i] = v;
+                cachePosition[v] = i;
+            }
+            float score = tables.score(cachePosition[v], remaining[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            const unsigned int* list = &adjacency[offsets[v]];
+            for (unsigned int j = 0; j < remaining[v]; j++){
+                unsigned int t = list[j];
+                triangleScore[t] += delta;
+                if (triangleScore[t] > bestScore){
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+    indices.swap(output);
+}
+
+void optimizeOverdraw(std::vector<int>& indices, const std::vector<float>& vertices, size_t floatsPerVertex, float threshold){
+    size_t triangleCount = indices.size() / 3;
+    size_t vertexCount = vertices.size() / floatsPerVertex;
+    if (triangleCount < 2)
+        return;
+
+    // a triangle missing all three vertices starts over with a cold cache, so the
+    // order of the clusters between those points barely changes the acmr
+    std::vector<size_t> hardBoundaries;
+    FifoCache cache(vertexCount, FIFO_CACHE_SIZE);
+    for (size_t t = 0; t < triangleCount; t++){
+        int misses = 0;
+        for (int k = 0; k < 3; k++)
+            misses += cache.access(indices[t * 3 + k]) ? 1 : 0;
+        if (t == 0 || misses == 3)
+            hardBoundaries.push_back(t);
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    // hard clusters are split further, from a cold cache, as soon as the piece so far
+    // is within threshold of the whole cluster's acmr
+    std::vector<size_t> boundaries;
+    for (size_t c = 0; c + 1 < hardBoundaries.size(); c++){
+        size_t start = hardBoundaries[c];
+        size_t end = hardBoundaries[c + 1];
+
+        cache.reset();
+        size_t clusterMisses = 0;
+        for (size_t t = start; t < end; t++)
+            for (int k = 0; k < 3; k++)
+                clusterMisses += cache.access(indices[t * 3 + k]) ? 1 : 0;
+        float target = threshold * (float)clusterMisses / (float)(end - start);
+
+        cache.reset();
+        size_t misses = 0;
+        size_t pieceStart = start;
+        boundaries.push_back(start);
+        for (size_t t = start; t < end; t++){
+            for (int k = 0; k < 3; k++)
+                misses += cache.access(indices[t * 3 + k]) ? 1 : 0;
+            if (t + 1 < end && (float)misses <= target * (float)(t + 1 - pieceStart)){
+                boundaries.push_back(t + 1);
+                pieceStart = t + 1;
+                misses = 0;
+                cache.reset();
+            }
+        }
+    }
+    boundaries.push_back(triangleCount);
+
+    auto position = [&](int index){
+        const float* p = &vertices[(size_t)index * floatsPerVertex];
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // area weighted centroid and normal of each cluster and of the whole mesh
+    size_t clusterCount = boundaries.size() - 1;
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++){
+        float clusterArea = 0.0f;
+        for (size_t t = boundaries[c]; t < boundaries[c + 1]; t++){
+            glm::vec3 a = position(indices[t * 3]);
+            glm::vec3 b = position(indices[t * 3 + 1]);
+            glm::vec3 d = position(indices[t * 3 + 2]);
+            glm::vec3 normal = glm::cross(b - a, d - a);
+            float area = glm::length(normal);
+            centroids[c] += (a + b + d) * (area / 3.0f);
+            normals[c] += normal;
+            clusterArea += area;
+        }
+        meshCentroid += centroids[c];
+        meshArea += clusterArea;
+        if (clusterArea > 0.0f)
+            centroids[c] /= clusterArea;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // clusters facing away from the middle are likely in front of the rest
+    std::vector<float> keys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++){
+        float length = glm::length(normals[c]);
+        keys[c] = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+    }
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){ return keys[a] > keys[b]; });
+
+    std::vector<int> output;
+    output.reserve(indices.size());
+    for (size_t c : order)
+        output.insert(output.end(), indices.begin() + boundaries[c] * 3, indices.begin() + boundaries[c + 1] * 3);
+    indices.swap(output);
+}
+
+void optimizeVertexFetch(std::vector<float>& vertices, std::vector<int>& indices, size_t floatsPerVertex){
+    size_t vertexCount = vertices.size() / floatsPerVertex;
+    std::vector<int> remap(vertexCount, -1);
+    std::vector<float> output;
+    output.reserve(vertices.size());
+
+    int next = 0;
+    for (int& index : indices){
+        if (remap[index] < 0){
+            remap[index] = next++;
+            const float* vertex = &vertices[(size_t)index * floatsPerVertex];
+            output.insert(output.end(), vertex, vertex + floatsPerVertex);
+        }
+        index = remap[index];
+    }
+    vertices.swap(output);
+}
+
+// symmetric 4x4 matrix summing squared distances to planes (Garland and Heckbert)
+struct Quadric{
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+    void addPlane(const glm::dvec3& normal, double distance, double weight){
+        a2 += weight * normal.x * normal.x; ab += weight * normal.x * normal.y; ac += weight * normal.x * normal.z; ad += weight * normal.x * distance;
+        b2 += weight * normal.y * normal.y; bc += weight * normal.y * normal.z; bd += weight * normal.y * distance;
+        c2 += weight * normal.z * normal.z; cd += weight * normal.z * distance;
+        d2 += weight * distance * distance;
+    }
+
+    void add(const Quadric& other){
+        a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad; b2 += other.b2;
+        bc += other.bc; bd += other.bd; c2 += other.c2; cd += other.cd; d2 += other.d2;
+    }
+
+    double error(const glm::dvec3& p) const{
+        double result = a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x
+                      + b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+                      + c2 * p.z * p.z + 2 * cd * p.z + d2;
+        return result > 0.0 ? result : 0.0;
+    }
+};
+
+struct Collapse{
+    int from, to;
+    double cost;
+};
+
+// edges on the mesh border keep a perpendicular plane with this weight so they don't shrink
+static const double BORDER_WEIGHT = 10.0;
+// a collapse may turn no remaining triangle by more than about 80 degrees
+static const double MIN_FLIP_COSINE = 0.2;
+
+static uint64_t edgeKey(int a, int b){
+    return a < b ? ((uint64_t)a << 32 | (uint32_t)b) : ((uint64_t)b << 32 | (uint32_t)a);
+}
+
+float simplifyMesh(std::vector<int>& destination, const std::vector<int>& indices, const std::vector<float>& vertices, size_t floatsPerVertex, size_t targetIndexCount){
+    size_t vertexCount = vertices.size() / floatsPerVertex;
+    auto position = [&](int vertex){
+        const float* p = &vertices[(size_t)vertex * floatsPerVertex];
+        return glm::dvec3(p[0], p[1], p[2]);
+    };
+
+    // vertices split only by their uvs or normals share one position, collapses move
+    // whole positions and every split vertex along with them
+    std::vector<int> sorted(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        sorted[v] = (int)v;
+    auto positionLess = [&](int a, int b){
+        const float* p = &vertices[(size_t)a * floatsPerVertex];
+        const float* q = &vertices[(size_t)b * floatsPerVertex];
+        return p[0] != q[0] ? p[0] < q[0] : (p[1] != q[1] ? p[1] < q[1] : p[2] < q[2]);
+    };
+    std::sort(sorted.begin(), sorted.end(), positionLess);
+    std::vector<int> group(vertexCount);
+    std::vector<unsigned int> groupOffsets;
+    for (size_t i = 0; i < vertexCount; i++){
+        if (i == 0 || positionLess(sorted[i - 1], sorted[i]))
+            groupOffsets.push_back((unsigned int)i);
+        group[sorted[i]] = (int)groupOffsets.size() - 1;
+    }
+    size_t groupCount = groupOffsets.size();
+    groupOffsets.push_back((unsigned int)vertexCount);
+
+    auto isDegenerate = [&](const int* triangle){
+        int a = group[triangle[0]], b = group[triangle[1]], c = group[triangle[2]];
+        return a == b || b == c || c == a;
+    };
+
+    destination.clear();
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        if (!isDegenerate(&indices[t]))
+            destination.insert(destination.end(), indices.begin() + t, indices.begin() + t + 3);
+
+    std::unordered_map<uint64_t, int> edgeCounts;
+    auto countEdges = [&]{
+        edgeCounts.clear();
+        for (size_t t = 0; t < destination.size(); t += 3)
+            for (int k = 0; k < 3; k++)
+                edgeCounts[edgeKey(group[destination[t + k]], group[destination[t + (k + 1) % 3]])]++;
+    };
+
+    std::vector<Quadric> quadrics(groupCount);
+    countEdges();
+    for (size_t t = 0; t < destination.size(); t += 3){
+        glm::dvec3 p[3] = {position(destination[t]), position(destination[t + 1]), position(destination[t + 2])};
+        glm::dvec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+        double length = glm::length(normal);
+        if (length == 0.0)
+            continue;
+        normal /= length;
+        for (int k = 0; k < 3; k++)
+            quadrics[group[destination[t + k]]].addPlane(normal, -glm::dot(normal, p[0]), 1.0);
+
+        for (int k = 0; k < 3; k++){
+            int a = group[destination[t + k]], b = group[destination[t + (k + 1) % 3]];
+            if (edgeCounts[edgeKey(a, b)] != 1)
+                continue;
+            glm::dvec3 border = glm::cross(p[(k + 1) % 3] - p[k], normal);
+            double borderLength = glm::length(border);
+            if (borderLength == 0.0)
+                continue;
+            border /= borderLength;
+            quadrics[a].addPlane(border, -glm::dot(border, p[k]), BORDER_WEIGHT);
+            quadrics[b].addPlane(border, -glm::dot(border, p[k]), BORDER_WEIGHT);
+        }
+    }
+
+    // the split vertex at position `to` whose uv and normal are closest to `vertex`
+    auto closestVertex = [&](int vertex, int to){
+        const float* attributes = &vertices[(size_t)vertex * floatsPerVertex];
+        int best = sorted[groupOffsets[to]];
+        float bestDistance = -1.0f;
+        for (unsigned int i = groupOffsets[to]; i < groupOffsets[to + 1]; i++){
+            const float* other = &vertices[(size_t)sorted[i] * floatsPerVertex];
+            float distance = 0.0f;
+            for (size_t f = 3; f < floatsPerVertex; f++)
+                distance += (attributes[f] - other[f]) * (attributes[f] - other[f]);
+            if (bestDistance < 0.0f || distance < bestDistance){
+                bestDistance = distance;
+                best = sorted[i];
+            }
+        }
+        return best;
+    };
+
+    double maxCost = 0.0;
+    std::vector<bool> border(groupCount), locked(groupCount);
+    std::vector<unsigned int> triangleOffsets(groupCount + 1), triangleList, filled;
+    std::vector<Collapse> collapses;
+
+    // every pass collapses the cheapest edges whose ends no earlier collapse of the
+    // same pass touched, so their costs are still exact
+    while (destination.size() > targetIndexCount){
+        size_t triangleCount = destination.size() / 3;
+
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (int index : destination)
+            triangleOffsets[group[index] + 1]++;
+        for (size_t g = 0; g < groupCount; g++)
+            triangleOffsets[g + 1] += triangleOffsets[g];
+        triangleList.resize(destination.size());
+        filled.assign(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (size_t i = 0; i < destination.size(); i++)
+            triangleList[filled[group[destination[i]]]++] = (unsigned int)(i / 3);
+
+        countEdges();
+        std::fill(border.begin(), border.end(), false);
+        for (size_t t = 0; t < destination.size(); t += 3)
+            for (int k = 0; k < 3; k++){
+                int a = group[destination[t + k]], b = group[destination[t + (k + 1) % 3]];
+                if (edgeCounts[edgeKey(a, b)] == 1)
+                    border[a] = border[b] = true;
+            }
+
+        // border positions only slide along the border
+        collapses.clear();
+        for (size_t t = 0; t < destination.size(); t += 3)
+            for (int k = 0; k < 3; k++){
+                int a = group[destination[t + k]], b = group[destination[t + (k + 1) % 3]];
+                bool borderEdge = edgeCounts[edgeKey(a, b)] == 1;
+                if (!border[a] || (borderEdge && border[b]))
+                    collapses.push_back(Collapse{a, b, quadrics[a].error(position(sorted[groupOffsets[b]]))});
+                if (!border[b] || (borderEdge && border[a]))
+                    collapses.push_back(Collapse{b, a, quadrics[b].error(position(sorted[groupOffsets[a]]))});
+            }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b){ return a.cost < b.cost; });
+
+        std::fill(locked.begin(), locked.end(), false);
+        size_t toRemove = (destination.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0;
+        for (const Collapse& collapse : collapses){
+            if (removed >= toRemove)
+                break;
+            if (locked[collapse.from] || locked[collapse.to])
+                continue;
+
+            // refuse collapses that fold a remaining triangle over
+            glm::dvec3 target = position(sorted[groupOffsets[collapse.to]]);
+            bool flips = false;
+            for (unsigned int i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1] && !flips; i++){
+                const int* triangle = &destination[triangleList[i] * 3];
+                if (isDegenerate(triangle))
+                    continue;
+                glm::dvec3 before[3], after[3];
+                bool touchesTarget = false;
+                for (int k = 0; k < 3; k++){
+                    before[k] = position(triangle[k]);
+                    after[k] = group[triangle[k]] == collapse.from ? target : before[k];
+                    touchesTarget |= group[triangle[k]] == collapse.to;
+                }
+                if (touchesTarget)
+                    continue;
+                glm::dvec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::dvec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                double lengths = glm::length(n0) * glm::length(n1);
+                flips = lengths == 0.0 || glm::dot(n0, n1) < MIN_FLIP_COSINE * lengths;
+            }
+            if (flips)
+                continue;
+
+            for (unsigned int i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1]; i++){
+                int* triangle = &destination[triangleList[i] * 3];
+                if (isDegenerate(triangle))
+                    continue;
+                for (int k = 0; k < 3; k++)
+                    if (group[triangle[k]] == collapse.from)
+                        triangle[k] = closestVertex(triangle[k], collapse.to);
+                removed += isDegenerate(triangle) ? 1 : 0;
+            }
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            maxCost = std::max(maxCost, collapse.cost);
+            locked[collapse.from] = locked[collapse.to] = true;
+        }
+
+        size_t write = 0;
+        for (size_t t = 0; t < destination.size(); t += 3){
+            if (isDegenerate(&destination[t]))
+                continue;
+            for (int k = 0; k < 3; k++)
+                destination[write + k] = destination[t + k];
+            write += 3;
+        }
+        destination.resize(write);
+        if (write / 3 == triangleCount)
+            break;
+    }
+    return (float)std::sqrt(maxCost);
+}
@@ -0,0 +1,270 @@
+#include "graphics/mipGenerator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include "core/threadPool.hpp"
+#include "graphics/imageDecoder.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_GENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+// entries of the linear to 8 bit table, fine enough that the steep start of the
+// srgb curve still lands on the right value
+static const int ENCODE_TABLE_SIZE = 16384;
+static const int KAISER_TAPS = 8;
+static const float KAISER_ALPHA = 4.0f;
+// rows a parallelFor range gets at least
+static const size_t MIN_ROWS = 16;
+
+// a texel while it is being filtered, rgba floats in 0..1
+#ifdef MIP_GENERATOR_SSE2
+typedef __m128 Texel;
+
+static inline Texel loadTexel(const float* p){ return _mm_loadu_ps(p); }
+static inline void storeTexel(float* p, Texel t){ _mm_storeu_ps(p, t); }
+static inline Texel zeroTexel(){ return _mm_setzero_ps(); }
+static inline Texel addTexels(Texel a, Texel b){ return _mm_add_ps(a, b); }
+static inline Texel scaleTexel(Texel t, float s){ return _mm_mul_ps(t, _mm_set1_ps(s)); }
+// the kaiser's negative lobes overshoot, and premultiplied colour can't exceed alpha
+static inline Texel clampTexel(Texel t, bool premultiplied){
+    t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return premultiplied ? _mm_min_ps(t, _mm_shuffle_ps(t, t, _MM_SHUFFLE(3, 3, 3, 3))) : t;
+}
+#else
+struct Texel{
+    float v[4];
+};
+
+static inline Texel loadTexel(const float* p){ return Texel{{p[0], p[1], p[2], p[3]}}; }
+static inline void storeTexel(float* p, Texel t){ std::copy(t.v, t.v + 4, p); }
+static inline Texel zeroTexel(){ return Texel{{0.0f, 0.0f, 0.0f, 0.0f}}; }
+static inline Texel addTexels(Texel a, Texel b){
+    return Texel{{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+}
+static inline Texel scaleTexel(Texel t, float s){ return Texel{{t.v[0] * s, t.v[1] * s, t.v[2] * s, t.v[3] * s}}; }
+static inline Texel clampTexel(Texel t, bool premultiplied){
+    for (int c = 0; c < 4; c++)
+        t.v[c] = std::min(std::max(t.v[c], 0.0f), 1.0f);
+    for (int c = 0; premultiplied && c < 3; c++)
+        t.v[c] = std::min(t.v[c], t.v[3]);
+    return t;
+}
+#endif
+
+struct FloatImage{
+    int width = 0;
+    int height = 0;
+    std::vector<float> texels;
+
+    void resize(int w, int h){
+        width = w;
+        height = h;
+        texels.resize((size_t)w * h * 4);
+    }
+    float* row(int y){ return texels.data() + (size_t)y * width * 4; }
+    const float* row(int y) const{ return texels.data() + (size_t)y * width * 4; }
+};
+
+// 8 bit values to linear floats and back, the srgb curve or a straight line
+struct ColorTables{
+    float toLinear[256];
+    uint8_t toEncoded[ENCODE_TABLE_SIZE];
+
+    explicit ColorTables(bool srgb){
+        for (int i = 0; i < 256; i++){
+            float c = i / 255.0f;
+            toLinear[i] = !srgb ? c : c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < ENCODE_TABLE_SIZE; i++){
+            float c = i / (float)(ENCODE_TABLE_SIZE - 1);
+            float encoded = !srgb ? c : c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+            toEncoded[i] = (uint8_t)std::lround(std::min(std::max(encoded, 0.0f), 1.0f) * 255.0f);
+        }
+    }
+
+    uint8_t encode(float linear) const{
+        return toEncoded[(int)(std::min(std::max(linear, 0.0f), 1.0f) * (ENCODE_TABLE_SIZE - 1) + 0.5f)];
+    }
+};
+
+static const ColorTables& getTables(bool srgb){
+    static const ColorTables srgbTables(true), linearTables(false);
+    return srgb ? srgbTables : linearTables;
+}
+
+// modified bessel function of the first kind, order 0, which shapes the kaiser window
+static double besselI0(double x){
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++){
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// sinc at half the source rate under a kaiser window, the taps sitting at
+// -3.5 .. 3.5 source texels from the target texel's centre
+static void getKaiserWeights(float* weights){
+    const double pi = 3.14159265358979323846;
+    double total = 0.0, raw[KAISER_TAPS];
+    for (int i = 0; i < KAISER_TAPS; i++){
+        double d = i - (KAISER_TAPS - 1) * 0.5;
+        double x = d * 0.5;
+        double sinc = x == 0.0 ? 1.0 : std::sin(pi * x) / (pi * x);
+        double r = d / (KAISER_TAPS * 0.5);
+        raw[i] = sinc * besselI0(KAISER_ALPHA * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(KAISER_ALPHA);
+        total += raw[i];
+    }
+    for (int i = 0; i < KAISER_TAPS; i++)
+        weights[i] = (float)(raw[i] / total);
+}
+
+static void boxFilter(const FloatImage& source, FloatImage& target, bool premultiplied){
+    ThreadPool::parallelFor((size_t)target.height, MIN_ROWS, [&](unsigned int, size_t begin, size_t end){
+        for (size_t y = begin; y < end; y++){
+            const float* row0 = source.row(std::min((int)y * 2, source.height - 1));
+            const float* row1 = source.row(std::min((int)y * 2 + 1, source.height - 1));
+            float* out = target.row((int)y);
+            for (int x = 0; x < target.width; x++){
+                int x0 = std::min(x * 2, source.width - 1) * 4, x1 = std::min(x * 2 + 1, source.width - 1) * 4;
+                Texel sum = addTexels(addTexels(loadTexel(row0 + x0), loadTexel(row0 + x1)), addTexels(loadTexel(row1 + x0), loadTexel(row1 + x1)));
+                storeTexel(out + x * 4, clampTexel(scaleTexel(sum, 0.25f), premultiplied));
+            }
+        }
+    });
+}
+
+// separable, across the rows first and then down the columns. a side that is
+// already 1 texel is copied instead of filtered
+static void kaiserFilter(const FloatImage& source, FloatImage& target, FloatImage& scratch, bool premultiplied){
+    float weights[KAISER_TAPS];
+    getKaiserWeights(weights);
+    const int first = -(KAISER_TAPS / 2 - 1);
+
+    scratch.resize(target.width, source.height);
+    ThreadPool::parallelFor((size_t)source.height, MIN_ROWS, [&](unsigned int, size_t begin, size_t end){
+        for (size_t y = begin; y < end; y++){
+            const float* in = source.row((int)y);
+            float* out = scratch.row((int)y);
+            if (source.width == 1){
+                storeTexel(out, loadTexel(in));
+                continue;
+            }
+            for (int x = 0; x < target.width; x++){
+                Texel sum = zeroTexel();
+                for (int t = 0; t < KAISER_TAPS; t++){
+                    int sourceX = std::min(std::max(x * 2 + first + t, 0), source.width - 1);
+                    sum = addTexels(sum, scaleTexel(loadTexel(in + sourceX * 4), weights[t]));
+                }
+                storeTexel(out + x * 4, sum);
+            }
+        }
+    });
+
+    ThreadPool::parallelFor((size_t)target.height, MIN_ROWS, [&](unsigned int, size_t begin, size_t end){
+        for (size_t y = begin; y < end; y++){
+            float* out = target.row((int)y);
+            if (source.height == 1){
+                for (int x = 0; x < target.width; x++)
+                    storeTexel(out + x * 4, clampTexel(loadTexel(scratch.row(0) + x * 4), premultiplied));
+                continue;
+            }
+            const float* rows[KAISER_TAPS];
+            for (int t = 0; t < KAISER_TAPS; t++)
+                rows[t] = scratch.row(std::min(std::max((int)y * 2 + first + t, 0), source.height - 1));
+            for (int x = 0; x < target.width; x++){
+                Texel sum = zeroTexel();
+                for (int t = 0; t < KAISER_TAPS; t++)
+                    sum = addTexels(sum, scaleTexel(loadTexel(rows[t] + x * 4), weights[t]));
+                storeTexel(out + x * 4, clampTexel(sum, premultiplied));
+            }
+        }
+    });
+}
+
+unsigned int MipGenerator::getLevelCount(int width, int height){
+    unsigned int levels = 1;
+    while (width > 1 || height > 1){
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+        levels++;
+    }
+    return levels;
+}
+
+std::vector<MipLevel> MipGenerator::generate(const uint8_t* rgba, int width, int height, MipFilter filter, bool srgb){
+    std::vector<MipLevel> levels;
+    if (!rgba || width <= 0 || height <= 0)
+        return levels;
+    const ColorTables& tables = getTables(srgb);
+
+    // colour weighted by alpha, and for images with any transparency the plain
+    // colour too, which is all a texel that ends up fully transparent can keep
+    FloatImage premultiplied, straight, next, scratch;
+    premultiplied.resize(width, height);
+    bool opaque = true;
+    for (size_t i = 0; i < (size_t)width * height; i++){
+        float alpha = rgba[i * 4 + 3] / 255.0f;
+        for (int c = 0; c < 3; c++)
+            premultiplied.texels[i * 4 + c] = tables.toLinear[rgba[i * 4 + c]] * alpha;
+        premultiplied.texels[i * 4 + 3] = alpha;
+        opaque = opaque && rgba[i * 4 + 3] == 255;
+    }
+    if (!opaque){
+        straight.resize(width, height);
+        for (size_t i = 0; i < (size_t)width * height; i++){
+            for (int c = 0; c < 3; c++)
+                straight.texels[i * 4 + c] = tables.toLinear[rgba[i * 4 + c]];
+            straight.texels[i * 4 + 3] = 1.0f;
+        }
+    }
+
+    auto downsample = [&](FloatImage& image, bool weighted){
+        next.resize(std::max(image.width / 2, 1), std::max(image.height / 2, 1));
+        if (filter == MipFilter::Kaiser)
+            kaiserFilter(image, next, scratch, weighted);
+        else
+            boxFilter(image, next, weighted);
+        std::swap(image, next);
+    };
+
+    while (premultiplied.width > 1 || premultiplied.height > 1){
+        downsample(premultiplied, true);
+        if (!opaque)
+            downsample(straight, false);
+
+        MipLevel level;
+        level.width = premultiplied.width;
+        level.height = premultiplied.height;
+        level.pixels.resize((size_t)level.width * level.height * 4);
+        for (size_t i = 0; i < (size_t)level.width * level.height; i++){
+            const float* texel = premultiplied.texels.data() + i * 4;
+            uint8_t alpha = (uint8_t)std::lround(texel[3] * 255.0f);
+            for (int c = 0; c < 3; c++)
+                level.pixels[i * 4 + c] = alpha > 0 ? tables.encode(texel[c] / texel[3]) : tables.encode(opaque ? 0.0f : straight.texels[i * 4 + c]);
+            level.pixels[i * 4 + 3] = alpha;
+        }
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
+
+void MipGenerator::benchmark(const std::string& imagePath, unsigned int iterations){
+    DecodedImage image;
+    if (!ImageDecoder::decode(imagePath, 4, image))
+        return;
+    std::cout << imagePath << ": " << image.width << "x" << image.height << ", "
+              << getLevelCount(image.width, image.height) << " levels, " << ThreadPool::getThreadCount() << " threads" << std::endl;
+
+    for (MipFilter filter : {MipFilter::Box, MipFilter::Kaiser}){
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < std::max(iterations, 1u); i++)
+            generate(image.pixels, image.width, image.height, filter, true);
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / std::max(iterations, 1u);
+        std::cout << (filter == MipFilter::Box ? "box" : "kaiser") << ": " << milliseconds << " ms per chain" << std::endl;
+    }
+}
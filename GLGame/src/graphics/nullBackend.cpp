@@ -0,0 +1,349 @@
+#include "graphics/nullBackend.hpp"
+
+#include <glad/glad.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct BackendData{
+    std::string version;
+    int majorVersion = 4;
+    int minorVersion = 6;
+
+    GLuint nextName = 1;
+    uintptr_t nextSync = 1;
+
+    // buffer storage only exists so map calls have memory to hand out
+    std::unordered_map<GLuint, std::vector<uint8_t>> buffers;
+    std::unordered_map<GLenum, GLuint> boundBuffers;
+
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    GLenum depthFunc = GL_LESS;
+    std::unordered_map<GLenum, bool> capabilities;
+    GLenum activeTexture = GL_TEXTURE0;
+    std::unordered_map<uint64_t, GLuint> boundTextures;
+    std::unordered_set<GLuint> texturesSeen;
+
+    NullBackend::Stats stats;
+};
+
+static BackendData sData;
+
+template<typename T>
+static void changeState(T& current, T value){
+    if (current == value){
+        sData.stats.redundantStateChanges++;
+        return;
+    }
+    current = value;
+    sData.stats.stateChanges++;
+}
+
+static size_t pixelSize(GLenum format, GLenum type){
+    size_t channels = 4;
+    switch (format){
+    case GL_RED: case GL_DEPTH_COMPONENT: channels = 1; break;
+    case GL_RG: channels = 2; break;
+    case GL_RGB: case GL_BGR: channels = 3; break;
+    }
+    switch (type){
+    case GL_FLOAT: return channels * 4;
+    case GL_HALF_FLOAT: case GL_UNSIGNED_SHORT: return channels * 2;
+    }
+    return channels;
+}
+
+static void countDraw(GLsizei count, GLsizei instances){
+    sData.stats.drawCalls++;
+    sData.stats.indices += (unsigned int)count * (unsigned int)instances;
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+static void APIENTRY noop(){}
+#endif
+
+static const GLubyte* APIENTRY nullGetString(GLenum name){
+    switch (name){
+    case GL_VERSION: return (const GLubyte*)sData.version.c_str();
+    case GL_VENDOR: return (const GLubyte*)"GLGame";
+    case GL_RENDERER: return (const GLubyte*)"null backend";
+    case GL_SHADING_LANGUAGE_VERSION: return (const GLubyte*)"3.30";
+    }
+    return (const GLubyte*)"";
+}
+
+// glad refuses to load a core context that reports no extensions at all. s3tc is
+// on every desktop driver, so cooked textures take the same path they would there
+static const char* const EXTENSIONS[] = {"GL_GLGAME_null_backend", "GL_EXT_texture_compression_s3tc"};
+
+static const GLubyte* APIENTRY nullGetStringi(GLenum, GLuint index){
+    return (const GLubyte*)EXTENSIONS[index < 2 ? index : 0];
+}
+
+static void APIENTRY nullGetIntegerv(GLenum name, GLint* data){
+    switch (name){
+    case GL_NUM_EXTENSIONS: *data = 2; return;
+    case GL_MAJOR_VERSION: *data = sData.majorVersion; return;
+    case GL_MINOR_VERSION: *data = sData.minorVersion; return;
+    case GL_MAX_TEXTURE_SIZE: *data = 16384; return;
+    case GL_MAX_ARRAY_TEXTURE_LAYERS: *data = 2048; return;
+    }
+    *data = 0;
+}
+
+static GLenum APIENTRY nullGetError(){
+    return GL_NO_ERROR;
+}
+
+static void APIENTRY nullGenNames(GLsizei n, GLuint* names){
+    for (GLsizei i = 0; i < n; i++)
+        names[i] = sData.nextName++;
+}
+
+static GLuint APIENTRY nullCreateObject(GLenum){
+    return sData.nextName++;
+}
+
+static GLuint APIENTRY nullCreateProgram(){
+    return sData.nextName++;
+}
+
+// every shader compiles and links
+static void APIENTRY nullGetObjectiv(GLuint, GLenum name, GLint* params){
+    *params = (name == GL_COMPILE_STATUS || name == GL_LINK_STATUS) ? GL_TRUE : 0;
+}
+
+static GLint APIENTRY nullGetUniformLocation(GLuint, const GLchar*){
+    return 0;
+}
+
+static GLenum APIENTRY nullCheckFramebufferStatus(GLenum){
+    return GL_FRAMEBUFFER_COMPLETE;
+}
+
+static void APIENTRY nullBindBuffer(GLenum target, GLuint buffer){
+    sData.boundBuffers[target] = buffer;
+}
+
+static void APIENTRY nullDeleteBuffers(GLsizei n, const GLuint* buffers){
+    for (GLsizei i = 0; i < n; i++)
+        sData.buffers.erase(buffers[i]);
+}
+
+static void APIENTRY nullBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum){
+    sData.buffers[sData.boundBuffers[target]].assign((size_t)size, 0);
+    if (data)
+        sData.stats.bytesUploaded += (unsigned int)size;
+}
+
+static void APIENTRY nullBufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield){
+    nullBufferData(target, size, data, 0);
+}
+
+static void APIENTRY nullBufferSubData(GLenum, GLintptr, GLsizeiptr size, const void*){
+    sData.stats.bytesUploaded += (unsigned int)size;
+}
+
+static void* APIENTRY nullMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access){
+    sData.stats.bufferMaps++;
+    std::vector<uint8_t>& storage = sData.buffers[sData.boundBuffers[target]];
+    if ((size_t)(offset + length) > storage.size())
+        return nullptr;
+    // without explicit flushes the whole range counts as written
+    if (!(access & GL_MAP_FLUSH_EXPLICIT_BIT) && !(access & GL_MAP_PERSISTENT_BIT))
+        sData.stats.bytesUploaded += (unsigned int)length;
+    return storage.data() + offset;
+}
+
+static void APIENTRY nullFlushMappedBufferRange(GLenum, GLintptr, GLsizeiptr length){
+    sData.stats.bytesUploaded += (unsigned int)length;
+}
+
+static GLboolean APIENTRY nullUnmapBuffer(GLenum){
+    return GL_TRUE;
+}
+
+static GLsync APIENTRY nullFenceSync(GLenum, GLbitfield){
+    return (GLsync)sData.nextSync++;
+}
+
+static GLenum APIENTRY nullClientWaitSync(GLsync, GLbitfield, GLuint64){
+    return GL_ALREADY_SIGNALED;
+}
+
+static void APIENTRY nullUseProgram(GLuint program){
+    changeState(sData.program, program);
+}
+
+static void APIENTRY nullBindVertexArray(GLuint array){
+    changeState(sData.vertexArray, array);
+}
+
+static void APIENTRY nullDepthFunc(GLenum func){
+    changeState(sData.depthFunc, func);
+}
+
+static void APIENTRY nullEnable(GLenum capability){
+    changeState(sData.capabilities[capability], true);
+}
+
+static void APIENTRY nullDisable(GLenum capability){
+    changeState(sData.capabilities[capability], false);
+}
+
+static void APIENTRY nullActiveTexture(GLenum unit){
+    sData.activeTexture = unit;
+}
+
+static void APIENTRY nullBindTexture(GLenum target, GLuint texture){
+    uint64_t slot = ((uint64_t)sData.activeTexture << 32) | target;
+    GLuint& bound = sData.boundTextures[slot];
+    if (bound != texture)
+        sData.stats.textureBinds++;
+    changeState(bound, texture);
+    if (texture != 0 && sData.texturesSeen.insert(texture).second)
+        sData.stats.uniqueTextures++;
+}
+
+static void APIENTRY nullTexImage2D(GLenum, GLint, GLint, GLsizei width, GLsizei height, GLint, GLenum format, GLenum type, const void* pixels){
+    if (pixels)
+        sData.stats.bytesUploaded += (unsigned int)(pixelSize(format, type) * width * height);
+}
+
+static void APIENTRY nullTexImage3D(GLenum, GLint, GLint, GLsizei width, GLsizei height, GLsizei depth, GLint, GLenum format, GLenum type, const void* pixels){
+    if (pixels)
+        sData.stats.bytesUploaded += (unsigned int)(pixelSize(format, type) * width * height * depth);
+}
+
+static void APIENTRY nullTexSubImage2D(GLenum, GLint, GLint, GLint, GLsizei width, GLsizei height, GLenum format, GLenum type, const void*){
+    sData.stats.bytesUploaded += (unsigned int)(pixelSize(format, type) * width * height);
+}
+
+static void APIENTRY nullTexSubImage3D(GLenum, GLint, GLint, GLint, GLint, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void*){
+    sData.stats.bytesUploaded += (unsigned int)(pixelSize(format, type) * width * height * depth);
+}
+
+static void APIENTRY nullCompressedTexImage2D(GLenum, GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei imageSize, const void*){
+    sData.stats.bytesUploaded += (unsigned int)imageSize;
+}
+
+static void APIENTRY nullCompressedTexSubImage3D(GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei, GLenum, GLsizei imageSize, const void*){
+    sData.stats.bytesUploaded += (unsigned int)imageSize;
+}
+
+static void APIENTRY nullDrawArrays(GLenum, GLint, GLsizei count){
+    countDraw(count, 1);
+}
+
+static void APIENTRY nullDrawElements(GLenum, GLsizei count, GLenum, const void*){
+    countDraw(count, 1);
+}
+
+static void APIENTRY nullDrawElementsBaseVertex(GLenum, GLsizei count, GLenum, const void*, GLint){
+    countDraw(count, 1);
+}
+
+static void APIENTRY nullDrawElementsInstanced(GLenum, GLsizei count, GLenum, const void*, GLsizei instances){
+    sData.stats.instances += (unsigned int)instances;
+    countDraw(count, instances);
+}
+
+static void APIENTRY nullDrawElementsInstancedBaseVertex(GLenum, GLsizei count, GLenum, const void*, GLsizei instances, GLint){
+    sData.stats.instances += (unsigned int)instances;
+    countDraw(count, instances);
+}
+
+static void APIENTRY nullMultiDrawElements(GLenum, const GLsizei* counts, GLenum, const void* const*, GLsizei drawCount){
+    sData.stats.drawCalls++;
+    for (GLsizei i = 0; i < drawCount; i++)
+        sData.stats.indices += (unsigned int)counts[i];
+}
+
+struct NullFunction{
+    const char* name;
+    void* function;
+};
+
+static const NullFunction NULL_FUNCTIONS[] = {
+    {"glGetString", (void*)nullGetString},
+    {"glGetStringi", (void*)nullGetStringi},
+    {"glGetIntegerv", (void*)nullGetIntegerv},
+    {"glGetError", (void*)nullGetError},
+    {"glGenBuffers", (void*)nullGenNames},
+    {"glGenVertexArrays", (void*)nullGenNames},
+    {"glGenTextures", (void*)nullGenNames},
+    {"glGenFramebuffers", (void*)nullGenNames},
+    {"glGenRenderbuffers", (void*)nullGenNames},
+    {"glCreateShader", (void*)nullCreateObject},
+    {"glCreateProgram", (void*)nullCreateProgram},
+    {"glGetShaderiv", (void*)nullGetObjectiv},
+    {"glGetProgramiv", (void*)nullGetObjectiv},
+    {"glGetUniformLocation", (void*)nullGetUniformLocation},
+    {"glCheckFramebufferStatus", (void*)nullCheckFramebufferStatus},
+    {"glBindBuffer", (void*)nullBindBuffer},
+    {"glDeleteBuffers", (void*)nullDeleteBuffers},
+    {"glBufferData", (void*)nullBufferData},
+    {"glBufferStorage", (void*)nullBufferStorage},
+    {"glBufferSubData", (void*)nullBufferSubData},
+    {"glMapBufferRange", (void*)nullMapBufferRange},
+    {"glFlushMappedBufferRange", (void*)nullFlushMappedBufferRange},
+    {"glUnmapBuffer", (void*)nullUnmapBuffer},
+    {"glFenceSync", (void*)nullFenceSync},
+    {"glClientWaitSync", (void*)nullClientWaitSync},
+    {"glUseProgram", (void*)nullUseProgram},
+    {"glBindVertexArray", (void*)nullBindVertexArray},
+    {"glDepthFunc", (void*)nullDepthFunc},
+    {"glEnable", (void*)nullEnable},
+    {"glDisable", (void*)nullDisable},
+    {"glActiveTexture", (void*)nullActiveTexture},
+    {"glBindTexture", (void*)nullBindTexture},
+    {"glTexImage2D", (void*)nullTexImage2D},
+    {"glTexImage3D", (void*)nullTexImage3D},
+    {"glTexSubImage2D", (void*)nullTexSubImage2D},
+    {"glTexSubImage3D", (void*)nullTexSubImage3D},
+    {"glCompressedTexImage2D", (void*)nullCompressedTexImage2D},
+    {"glCompressedTexSubImage3D", (void*)nullCompressedTexSubImage3D},
+    {"glDrawArrays", (void*)nullDrawArrays},
+    {"glDrawElements", (void*)nullDrawElements},
+    {"glDrawElementsBaseVertex", (void*)nullDrawElementsBaseVertex},
+    {"glDrawElementsInstanced", (void*)nullDrawElementsInstanced},
+    {"glDrawElementsInstancedBaseVertex", (void*)nullDrawElementsInstancedBaseVertex},
+    {"glMultiDrawElements", (void*)nullMultiDrawElements},
+};
+
+// anything not in the table returns nothing and ignores its arguments. that is only
+// safe where the caller cleans up its own arguments, so the fallback is limited to
+// x86-64. on 32-bit windows APIENTRY is stdcall, the callee pops the arguments and
+// a noop called through another signature would corrupt the stack. other targets
+// leave the functions missing from the table null, calling one crashes right there
+static void* nullProcAddress(const char* name){
+    for (const NullFunction& entry : NULL_FUNCTIONS)
+        if (strcmp(entry.name, name) == 0)
+            return entry.function;
+#if defined(__x86_64__) || defined(_M_X64)
+    return (void*)noop;
+#else
+    return nullptr;
+#endif
+}
+
+bool NullBackend::load(int majorVersion, int minorVersion){
+    sData = BackendData{};
+    sData.majorVersion = majorVersion;
+    sData.minorVersion = minorVersion;
+    sData.version = std::to_string(majorVersion) + "." + std::to_string(minorVersion) + ".0 null";
+    return gladLoadGLLoader((GLADloadproc)nullProcAddress) != 0;
+}
+
+const NullBackend::Stats& NullBackend::getStats(){
+    return sData.stats;
+}
+
+void NullBackend::resetStats(){
+    sData.stats = Stats{};
+    sData.texturesSeen.clear();
+}
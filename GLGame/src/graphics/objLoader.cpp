@@ -0,0 +1,519 @@
+#include "graphics/objLoader.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "core/mappedFile.hpp"
+#include "core/threadPool.hpp"
+
+// files smaller than this are parsed on the calling thread alone
+static const size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+// one triangle corner, 1 based, 0 when the attribute is missing. negative (relative)
+// indices are resolved against the chunk while parsing and flagged, the merge adds
+// the number of elements in the chunks before
+struct Corner{
+    int v, vt, vn;
+    int relative;
+};
+
+static const int RELATIVE_V = 1;
+static const int RELATIVE_VT = 2;
+static const int RELATIVE_VN = 4;
+
+struct ObjChunk{
+    std::vector<float> positions;
+    std::vector<float> uvs;
+    std::vector<float> normals;
+    std::vector<Corner> corners;
+    bool missingNormals = false;
+};
+
+// v/vt/vn triple to vertex index, open addressing with linear probing. v is never 0
+// for a valid corner, so v == 0 marks an empty slot
+class VertexMap{
+public:
+    explicit VertexMap(size_t expected){
+        size_t capacity = 64;
+        while (capacity < expected * 2)
+            capacity *= 2;
+        slots.assign(capacity, Slot{});
+        mask = capacity - 1;
+    }
+
+    // the index of the corner's vertex, inserting `next` when it is new
+    int findOrInsert(const Corner& corner, int next, bool& inserted){
+        if ((count + 1) * 2 > slots.size())
+            grow();
+        size_t i = hash(corner.v, corner.vt, corner.vn) & mask;
+        while (true){
+            Slot& slot = slots[i];
+            if (slot.v == 0){
+                slot = Slot{(uint32_t)corner.v, (uint32_t)corner.vt, (uint32_t)corner.vn, next};
+                count++;
+                inserted = true;
+                return next;
+            }
+            if (slot.v == (uint32_t)corner.v && slot.vt == (uint32_t)corner.vt && slot.vn == (uint32_t)corner.vn){
+                inserted = false;
+                return slot.index;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+
+private:
+    struct Slot{
+        uint32_t v = 0, vt = 0, vn = 0;
+        int index = 0;
+    };
+
+    static size_t hash(uint32_t v, uint32_t vt, uint32_t vn){
+        uint64_t key = ((uint64_t)v << 32 | vt) * 0x9E3779B97F4A7C15ull;
+        key ^= (uint64_t)vn * 0xC2B2AE3D27D4EB4Full;
+        return (size_t)(key ^ (key >> 31));
+    }
+
+    void grow(){
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.assign(old.size() * 2, Slot{});
+        mask = slots.size() - 1;
+        for (const Slot& slot : old){
+            if (slot.v == 0)
+                continue;
+            size_t i = hash(slot.v, slot.vt, slot.vn) & mask;
+            while (slots[i].v != 0)
+                i = (i + 1) & mask;
+            slots[i] = slot;
+        }
+    }
+
+    std::vector<Slot> slots;
+    size_t mask = 0;
+    size_t count = 0;
+};
+
+static const double POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const char* skipSpaces(const char* p, const char* end){
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+static bool isDigit(char c){
+    return c >= '0' && c <= '9';
+}
+
+// decimal and exponent notation. the first 19 significant digits are kept exactly,
+// which together with the exact powers of ten rounds like strtof for anything an
+// exporter writes
+static const char* parseFloat(const char* p, const char* end, float& out){
+    p = skipSpaces(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')){
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    while (p < end && isDigit(*p)){
+        if (digits < 19){
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            if (mantissa != 0)
+                digits++;
+        } else {
+            exponent++;
+        }
+        p++;
+    }
+    if (p < end && *p == '.'){
+        p++;
+        while (p < end && isDigit(*p)){
+            if (digits < 19){
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                exponent--;
+                if (mantissa != 0)
+                    digits++;
+            }
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')){
+        p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+')){
+            negativeExponent = *p == '-';
+            p++;
+        }
+        int value = 0;
+        while (p < end && isDigit(*p)){
+            if (value < 10000)
+                value = value * 10 + (*p - '0');
+            p++;
+        }
+        exponent += negativeExponent ? -value : value;
+    }
+
+    double value = (double)mantissa;
+    if (mantissa != 0 && exponent != 0){
+        if (exponent > 0 && exponent <= 22)
+            value *= POWERS_OF_TEN[exponent];
+        else if (exponent < 0 && exponent >= -22)
+            value /= POWERS_OF_TEN[-exponent];
+        else
+            value *= std::pow(10.0, exponent);
+    }
+    out = (float)(negative ? -value : value);
+    return p;
+}
+
+static const char* parseInt(const char* p, const char* end, int& out){
+    bool negative = false;
+    if (p < end && *p == '-'){
+        negative = true;
+        p++;
+    }
+    int value = 0;
+    while (p < end && isDigit(*p)){
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    out = negative ? -value : value;
+    return p;
+}
+
+// v, v/vt, v//vn or v/vt/vn
+static const char* parseCorner(const char* p, const char* end, Corner& corner){
+    corner = Corner{0, 0, 0, 0};
+    p = parseInt(p, end, corner.v);
+    if (p < end && *p == '/'){
+        p++;
+        if (p < end && *p != '/')
+            p = parseInt(p, end, corner.vt);
+        if (p < end && *p == '/')
+            p = parseInt(p + 1, end, corner.vn);
+    }
+    return p;
+}
+
+static const char* nextLine(const char* p, const char* end){
+    const char* newline = (const char*)memchr(p, '\n', (size_t)(end - p));
+    return newline ? newline + 1 : end;
+}
+
+// -1 is the last element defined so far. the chunk only knows its own elements, so the
+// result is relative to the chunk start and may be 0 or below for earlier chunks
+static void resolveRelative(int& index, size_t definedInChunk, int flag, int& relative){
+    if (index >= 0)
+        return;
+    index = (int)definedInChunk + index + 1;
+    relative |= flag;
+}
+
+static bool isSeparator(char c){
+    return c == ' ' || c == '\t';
+}
+
+// parses every line starting in [p, end), end is the file end or just past a newline
+static void parseChunk(const char* p, const char* end, ObjChunk& chunk){
+    size_t estimate = (size_t)(end - p) / 64;
+    chunk.positions.reserve(estimate * 3);
+    chunk.corners.reserve(estimate * 3);
+    std::vector<Corner> polygon;
+
+    while (p < end){
+        p = skipSpaces(p, end);
+        if (end - p >= 2 && p[0] == 'v'){
+            if (isSeparator(p[1])){
+                float x, y, z;
+                p = parseFloat(p + 1, end, x);
+                p = parseFloat(p, end, y);
+                p = parseFloat(p, end, z);
+                chunk.positions.insert(chunk.positions.end(), {x, y, z});
+            } else if (p[1] == 't' && end - p >= 3 && isSeparator(p[2])){
+                float u, v;
+                p = parseFloat(p + 2, end, u);
+                p = parseFloat(p, end, v);
+                chunk.uvs.insert(chunk.uvs.end(), {u, v});
+            } else if (p[1] == 'n' && end - p >= 3 && isSeparator(p[2])){
+                float x, y, z;
+                p = parseFloat(p + 2, end, x);
+                p = parseFloat(p, end, y);
+                p = parseFloat(p, end, z);
+                chunk.normals.insert(chunk.normals.end(), {x, y, z});
+            }
+        } else if (end - p >= 2 && p[0] == 'f' && isSeparator(p[1])){
+            p++;
+            polygon.clear();
+            while (true){
+                p = skipSpaces(p, end);
+                if (p >= end || !(isDigit(*p) || *p == '-'))
+                    break;
+                Corner corner;
+                p = parseCorner(p, end, corner);
+                resolveRelative(corner.v, chunk.positions.size() / 3, RELATIVE_V, corner.relative);
+                resolveRelative(corner.vt, chunk.uvs.size() / 2, RELATIVE_VT, corner.relative);
+                resolveRelative(corner.vn, chunk.normals.size() / 3, RELATIVE_VN, corner.relative);
+                chunk.missingNormals |= corner.vn == 0;
+                polygon.push_back(corner);
+            }
+            // polygons are split into a fan around their first corner
+            for (size_t i = 1; i + 1 < polygon.size(); i++)
+                chunk.corners.insert(chunk.corners.end(), {polygon[0], polygon[i], polygon[i + 1]});
+        }
+        p = nextLine(p, end);
+    }
+}
+
+// the first line starting at or after offset
+static size_t alignToLine(const char* data, size_t size, size_t offset){
+    if (offset == 0 || offset >= size)
+        return offset >= size ? size : 0;
+    return (size_t)(nextLine(data + offset - 1, data + size) - data);
+}
+
+static void appendFloats(std::vector<float>& to, const std::vector<float>& from){
+    to.insert(to.end(), from.begin(), from.end());
+}
+
+bool OBJLoader::loadFromFile(const std::string& path, std::vector<float>& vertexArray, std::vector<int>& indexArray){
+    MappedFile file;
+    if (!file.open(path)){
+        std::cout << "unable to open file: " << path << std::endl;
+        return false;
+    }
+    const char* data = file.getData();
+    size_t size = file.getSize();
+
+    std::vector<ObjChunk> chunks(std::max(ThreadPool::getRangeCount(size, MIN_CHUNK_BYTES), 1u));
+    ThreadPool::parallelFor(size, MIN_CHUNK_BYTES, [&](unsigned int range, size_t begin, size_t end){
+        begin = alignToLine(data, size, begin);
+        end = alignToLine(data, size, end);
+        if (begin < end)
+            parseChunk(data + begin, data + end, chunks[range]);
+    });
+
+    size_t positionCount = 0, uvCount = 0, normalCount = 0, cornerCount = 0;
+    for (const ObjChunk& chunk : chunks){
+        positionCount += chunk.positions.size();
+        uvCount += chunk.uvs.size();
+        normalCount += chunk.normals.size();
+        cornerCount += chunk.corners.size();
+    }
+
+    std::vector<float> positions, uvs, normals;
+    positions.reserve(positionCount);
+    uvs.reserve(uvCount);
+    normals.reserve(normalCount);
+    for (const ObjChunk& chunk : chunks){
+        appendFloats(positions, chunk.positions);
+        appendFloats(uvs, chunk.uvs);
+        appendFloats(normals, chunk.normals);
+    }
+    int positionTotal = (int)(positionCount / 3);
+    int uvTotal = (int)(uvCount / 2);
+    int normalTotal = (int)(normalCount / 3);
+
+    // turn relative indices absolute and check every corner before touching the arrays
+    bool missingNormals = false;
+    int positionBase = 0, uvBase = 0, normalBase = 0;
+    for (ObjChunk& chunk : chunks){
+        for (Corner& corner : chunk.corners){
+            if (corner.relative & RELATIVE_V)
+                corner.v += positionBase;
+            if (corner.relative & RELATIVE_VT)
+                corner.vt += uvBase;
+            if (corner.relative & RELATIVE_VN)
+                corner.vn += normalBase;
+            bool relativeVt = (corner.relative & RELATIVE_VT) != 0;
+            bool relativeVn = (corner.relative & RELATIVE_VN) != 0;
+            if (corner.v < 1 || corner.v > positionTotal || corner.vt < (relativeVt ? 1 : 0) || corner.vt > uvTotal || corner.vn < (relativeVn ? 1 : 0) || corner.vn > normalTotal){
+                std::cout << "face vertex out of range in file: " << path << std::endl;
+                return false;
+            }
+        }
+        missingNormals |= chunk.missingNormals;
+        positionBase += (int)(chunk.positions.size() / 3);
+        uvBase += (int)(chunk.uvs.size() / 2);
+        normalBase += (int)(chunk.normals.size() / 3);
+    }
+
+    // corners without a normal share the area weighted normal of their position
+    std::vector<glm::vec3> generatedNormals;
+    if (missingNormals){
+        generatedNormals.assign(positionTotal, glm::vec3(0.0f));
+        for (const ObjChunk& chunk : chunks){
+            for (size_t i = 0; i + 2 < chunk.corners.size(); i += 3){
+                const Corner* triangle = &chunk.corners[i];
+                glm::vec3 a = glm::make_vec3(&positions[(triangle[0].v - 1) * 3]);
+                glm::vec3 b = glm::make_vec3(&positions[(triangle[1].v - 1) * 3]);
+                glm::vec3 c = glm::make_vec3(&positions[(triangle[2].v - 1) * 3]);
+                glm::vec3 normal = glm::cross(b - a, c - a);
+                for (int j = 0; j < 3; j++)
+                    generatedNormals[triangle[j].v - 1] += normal;
+            }
+        }
+        for (glm::vec3& normal : generatedNormals){
+            float length = glm::length(normal);
+            normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    }
+
+    // every distinct v/vt/vn triple becomes one vertex. a file never has more of them
+    // than corners, and rarely many more than it has positions
+    size_t expectedVertices = std::min(cornerCount, (size_t)positionTotal * 2);
+    VertexMap vertexMap(expectedVertices);
+    vertexArray.reserve(vertexArray.size() + expectedVertices * 8);
+    indexArray.reserve(indexArray.size() + cornerCount);
+    int currentIndex = (int)(vertexArray.size() / 8);
+    static const float NO_UV[2] = {0.0f, 0.0f};
+
+    for (const ObjChunk& chunk : chunks){
+        for (const Corner& corner : chunk.corners){
+            bool inserted;
+            int index = vertexMap.findOrInsert(corner, currentIndex, inserted);
+            indexArray.push_back(index);
+            if (!inserted)
+                continue;
+
+            const float* position = &positions[(corner.v - 1) * 3];
+            const float* uv = corner.vt != 0 ? &uvs[(corner.vt - 1) * 2] : NO_UV;
+            const float* normal = corner.vn != 0 ? &normals[(corner.vn - 1) * 3] : &generatedNormals[corner.v - 1][0];
+            vertexArray.insert(vertexArray.end(), {position[0], position[1], position[2], uv[0], uv[1], normal[0], normal[1], normal[2]});
+            currentIndex++;
+        }
+    }
+    return true;
+}
+
+// the original getline/stringstream loader, kept as the benchmark baseline
+static bool loadWithStreams(const std::string& path, std::vector<float>& vertexArray, std::vector<int>& indexArray){
+    std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
+    std::vector<glm::vec3> temp_vertices;
+    std::vector<glm::vec2> temp_uvs;
+    std::vector<glm::vec3> temp_normals;
+    std::unordered_map<std::string, int> vertexMap;
+    int currentIndex = 0;
+
+    std::ifstream file;
+    file.open(path);
+
+    if(file.is_open()){
+        std::string line;
+        while(getline(file, line)) {
+            std::stringstream ss(line);
+            std::string header;
+
+            ss >> header;
+
+            if(header == "v"){
+                glm::vec3 vertex;
+                ss >> vertex.x >> vertex.y >> vertex.z;
+                temp_vertices.push_back(vertex);
+            } else if (header == "vt") {
+                glm::vec2 uv;
+                ss >> uv.x >> uv.y;
+                temp_uvs.push_back(uv);
+            } else if (header == "vn") {
+                glm::vec3 normal;
+                ss >> normal.x >> normal.y >> normal.z;
+                temp_normals.push_back(normal);
+            } else if (header == "f") {
+                std::string vertex;
+                unsigned int v[3];
+                std::string token;
+
+                for (int i = 0; i < 3; i++) {
+                    ss >> vertex;
+                    auto it = vertexMap.find(vertex);
+                    if (it != vertexMap.end()) {
+                        indexArray.push_back(it->second);
+                    } else {
+                        std::stringstream ss1(vertex);
+                        vertexMap.insert({vertex, currentIndex});
+                        int i = 0;
+                        while (getline(ss1, token, '/')) {
+                            v[i] = std::stoi(token);
+                            i++;
+                        }
+                        vertexIndices.push_back(v[0] - 1);
+                        uvIndices.push_back(v[1] - 1);
+                        normalIndices.push_back(v[2] - 1);
+                        vertexArray.push_back(temp_vertices[vertexIndices[currentIndex]].x);
+                        vertexArray.push_back(temp_vertices[vertexIndices[currentIndex]].y);
+                        vertexArray.push_back(temp_vertices[vertexIndices[currentIndex]].z);
+                        vertexArray.push_back(temp_uvs[uvIndices[currentIndex]].x);
+                        vertexArray.push_back(temp_uvs[uvIndices[currentIndex]].y);
+                        vertexArray.push_back(temp_normals[normalIndices[currentIndex]].x);
+                        vertexArray.push_back(temp_normals[normalIndices[currentIndex]].y);
+                        vertexArray.push_back(temp_normals[normalIndices[currentIndex]].z);
+
+                        indexArray.push_back(currentIndex);
+
+                        currentIndex++;
+                    }
+                }
+            }
+        }
+
+    } else {
+        std::cout << "unable to open file: " << path << std::endl;
+        return false;
+    }
+    file.close();
+    return true;
+}
+
+void OBJLoader::benchmark(const std::string& path, unsigned int iterations){
+    MappedFile file;
+    if (!file.open(path) || iterations == 0){
+        std::cout << "unable to open file: " << path << std::endl;
+        return;
+    }
+    double megabytes = file.getSize() / (1024.0 * 1024.0);
+    file.close();
+
+    std::vector<float> referenceVertices, vertices;
+    std::vector<int> referenceIndices, indices;
+
+    auto measure = [&](bool (*load)(const std::string&, std::vector<float>&, std::vector<int>&), std::vector<float>& vertexArray, std::vector<int>& indexArray){
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < iterations; i++){
+            vertexArray.clear();
+            indexArray.clear();
+            load(path, vertexArray, indexArray);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return megabytes * iterations / seconds;
+    };
+
+    double referenceSpeed = measure(loadWithStreams, referenceVertices, referenceIndices);
+    double speed = measure(OBJLoader::loadFromFile, vertices, indices);
+
+    float maxError = 0.0f;
+    bool same = vertices.size() == referenceVertices.size() && indices == referenceIndices;
+    for (size_t i = 0; same && i < vertices.size(); i++)
+        maxError = std::max(maxError, std::abs(vertices[i] - referenceVertices[i]));
+
+    std::cout << path << " (" << megabytes << " MB, " << ThreadPool::getThreadCount() << " threads)" << std::endl;
+    std::cout << "stringstream loader: " << referenceSpeed << " MB/s" << std::endl;
+    std::cout << "mapped chunk loader: " << speed << " MB/s (" << speed / referenceSpeed << "x)" << std::endl;
+    if (same)
+        std::cout << "outputs match, largest float difference " << maxError << std::endl;
+    else
+        std::cout << "outputs differ: " << vertices.size() / 8 << " vs " << referenceVertices.size() / 8 << " vertices" << std::endl;
+}
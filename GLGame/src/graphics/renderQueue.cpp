@@ -0,0 +1,362 @@
+#include "graphics/renderQueue.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glad/glad.h>
+#include "graphics/batchRenderer2D.hpp"
+#include "graphics/batchRendererCube.hpp"
+#include "graphics/model.hpp"
+#include "graphics/textureStreamer.hpp"
+#include "graphics/tileLayer.hpp"
+
+// key layout, most significant first: pass 2 | shader 6 | type 2 | material 16 | depth 24 | unused 14
+static const int PASS_SHIFT = 62;
+static const int SHADER_SHIFT = 56;
+static const int TYPE_SHIFT = 54;
+static const int MATERIAL_SHIFT = 38;
+static const int DEPTH_SHIFT = 14;
+
+static const unsigned int MAX_SHADERS = 64;
+static const uint32_t DEPTH_MAX = (1u << 24) - 1;
+// model textures are not texture array pages, keep them apart in the material field
+static const uint16_t MODEL_MATERIAL_BIT = 0x8000;
+
+static unsigned int keyField(uint64_t key, int shift, int bits){
+    return (unsigned int)((key >> shift) & ((1ull << bits) - 1));
+}
+
+void RenderQueue::begin(const glm::mat4& view, float farPlane){
+    this->view = view;
+    this->farPlane = farPlane;
+    commands.clear();
+    keys.clear();
+    transforms.clear();
+    stats = Stats{};
+}
+
+void RenderQueue::setFrustum(const Frustum& frustum){
+    this->frustum = frustum;
+}
+
+void RenderQueue::setCamera(const Camera& camera, const glm::mat4& projection, float viewportHeight){
+    this->camera = &camera;
+    this->projection = projection;
+    this->viewportHeight = viewportHeight;
+}
+
+void RenderQueue::submitTile(RenderPass pass, Shader& shader, const glm::vec2& position, const glm::vec2& size, const glm::vec4& color){
+    Command command{};
+    command.type = Type::Tile;
+    command.position = glm::vec3(position, 0.0f);
+    command.size = glm::vec3(size, 0.0f);
+    command.color = color;
+    glm::vec2 center = position + size * 0.5f;
+    push(pass, shader, command, 0, glm::vec3(center.x, 0.0f, center.y));
+}
+
+void RenderQueue::submitTile(RenderPass pass, Shader& shader, const glm::vec2& position, const glm::vec2& size, const TextureLayer& texture){
+    Command command{};
+    command.type = Type::Tile;
+    command.textured = true;
+    command.position = glm::vec3(position, 0.0f);
+    command.size = glm::vec3(size, 0.0f);
+    command.texture = texture;
+    glm::vec2 center = position + size * 0.5f;
+    push(pass, shader, command, texture.layer != 0 ? texture.page : 0, glm::vec3(center.x, 0.0f, center.y));
+    requestTexture(texture.page, glm::vec3(position.x, 0.0f, position.y), glm::vec3(position.x + size.x, 0.0f, position.y + size.y), glm::max(size.x, size.y));
+}
+
+void RenderQueue::submitTile(RenderPass pass, Shader& shader, const glm::vec2& position, const glm::vec2& size, const AtlasSprite& sprite){
+    Command command{};
+    command.type = Type::Tile;
+    command.textured = true;
+    command.position = glm::vec3(position, 0.0f);
+    command.size = glm::vec3(size, 0.0f);
+    command.texture = sprite.texture;
+    command.sprite = &sprite;
+    glm::vec2 center = position + size * 0.5f;
+    push(pass, shader, command, sprite.texture.layer != 0 ? sprite.texture.page : 0, glm::vec3(center.x, 0.0f, center.y));
+}
+
+void RenderQueue::submitCube(RenderPass pass, Shader& shader, const glm::vec3& position, const glm::vec3& size, const glm::vec4& color){
+    Command command{};
+    command.type = Type::Cube;
+    command.position = position;
+    command.size = size;
+    command.color = color;
+    push(pass, shader, command, 0, position + size * 0.5f);
+}
+
+void RenderQueue::submitCube(RenderPass pass, Shader& shader, const glm::vec3& position, const glm::vec3& size, const TextureLayer& texture){
+    Command command{};
+    command.type = Type::Cube;
+    command.textured = true;
+    command.position = position;
+    command.size = size;
+    command.texture = texture;
+    push(pass, shader, command, texture.layer != 0 ? texture.page : 0, position + size * 0.5f);
+    requestTexture(texture.page, position, position + size, glm::max(size.x, glm::max(size.y, size.z)));
+}
+
+void RenderQueue::submitModel(RenderPass pass, Shader& shader, Model& model, const glm::mat4& transform){
+    if (!model.isVisible(frustum, transform)){
+        stats.culled++;
+        return;
+    }
+    Command command{};
+    command.type = Type::Model;
+    command.object = &model;
+    command.transformIndex = (unsigned int)transforms.size();
+    transforms.push_back(transform);
+    uint16_t material = MODEL_MATERIAL_BIT | (model.getTextureID() & 0x7fff);
+    push(pass, shader, command, material, glm::vec3(transform[3]));
+}
+
+void RenderQueue::submitModelInstances(RenderPass pass, Shader& shader, Model& model, const glm::mat4* instanceTransforms, size_t count){
+    Command command{};
+    command.type = Type::Model;
+    command.object = &model;
+    command.transformIndex = (unsigned int)transforms.size();
+    glm::vec3 center(0.0f);
+    for (size_t i = 0; i < count; i++){
+        if (!model.isVisible(frustum, instanceTransforms[i])){
+            stats.culled++;
+            continue;
+        }
+        transforms.push_back(instanceTransforms[i]);
+        center += glm::vec3(instanceTransforms[i][3]);
+    }
+    command.instanceCount = (unsigned int)transforms.size() - command.transformIndex;
+    if (command.instanceCount == 0)
+        return;
+    uint16_t material = MODEL_MATERIAL_BIT | (model.getTextureID() & 0x7fff);
+    push(pass, shader, command, material, center / (float)command.instanceCount);
+}
+
+void RenderQueue::submitTileLayer(RenderPass pass, Shader& shader, TileLayer& layer){
+    Command command{};
+    command.type = Type::TileLayer;
+    command.object = &layer;
+    command.shader = &shader;
+    commands.push_back(command);
+
+    // the layer spans the whole map, treat it as far away so whatever stands on it is drawn first
+    uint64_t key = ((uint64_t)pass << PASS_SHIFT)
+                 | ((uint64_t)shaderSlot(shader) << SHADER_SHIFT)
+                 | ((uint64_t)Type::TileLayer << TYPE_SHIFT)
+                 | ((uint64_t)layer.getTexturePage() << MATERIAL_SHIFT)
+                 | ((uint64_t)(pass == RenderPass::Transparent ? 0 : DEPTH_MAX) << DEPTH_SHIFT);
+    keys.push_back(key);
+
+    // every tile is one texture, the nearest one decides
+    glm::vec3 extent = glm::vec3(layer.getWidth(), 0.0f, layer.getHeight()) * layer.getTileSize();
+    requestTexture(layer.getTexturePage(), glm::vec3(0.0f), extent, layer.getTileSize());
+}
+
+void RenderQueue::push(RenderPass pass, Shader& shader, Command& command, uint16_t material, const glm::vec3& center){
+    command.shader = &shader;
+
+    float depth = -(view * glm::vec4(center, 1.0f)).z / farPlane;
+    uint32_t quantized = (uint32_t)(glm::clamp(depth, 0.0f, 1.0f) * DEPTH_MAX);
+    if (pass == RenderPass::Transparent)
+        quantized = DEPTH_MAX - quantized;
+
+    uint64_t key = ((uint64_t)pass << PASS_SHIFT)
+                 | ((uint64_t)shaderSlot(shader) << SHADER_SHIFT)
+                 | ((uint64_t)command.type << TYPE_SHIFT)
+                 | ((uint64_t)material << MATERIAL_SHIFT)
+                 | ((uint64_t)quantized << DEPTH_SHIFT);
+    commands.push_back(command);
+    keys.push_back(key);
+}
+
+void RenderQueue::requestTexture(uint16_t page, const glm::vec3& min, const glm::vec3& max, float textureSize){
+    if (page == 0 || !frustum.isBoxVisible(min, max))
+        return;
+    if (!camera){
+        TextureStreamer::request(page, INFINITY);
+        return;
+    }
+    float distance = glm::length(glm::clamp(camera->Position, min, max) - camera->Position);
+    TextureStreamer::request(page, TextureStreamer::getScreenSize(textureSize, distance, projection, viewportHeight));
+}
+
+unsigned int RenderQueue::shaderSlot(const Shader& shader){
+    for (unsigned int i = 0; i < shaderIDs.size(); i++)
+        if (shaderIDs[i] == shader.ID)
+            return i;
+    if (shaderIDs.size() >= MAX_SHADERS)
+        return MAX_SHADERS - 1;
+    shaderIDs.push_back(shader.ID);
+    return (unsigned int)shaderIDs.size() - 1;
+}
+
+void RenderQueue::flush(){
+    stats.commands = (unsigned int)commands.size();
+
+    order.resize(commands.size());
+    for (uint32_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    countBatches(order, stats.unsortedDrawCalls, stats.unsortedStateChanges);
+
+    radixSort();
+    countBatches(order, stats.sortedDrawCalls, stats.sortedStateChanges);
+
+    dispatch();
+}
+
+// lsd radix sort of (key, command index) on 8 bit digits, digits every key shares are skipped
+void RenderQueue::radixSort(){
+    size_t count = keys.size();
+    // keys stays in submission order, countBatches and dispatch look commands up in it
+    sortedKeys.assign(keys.begin(), keys.end());
+    keyScratch.resize(count);
+    orderScratch.resize(count);
+
+    for (int shift = 0; shift < 64; shift += 8){
+        unsigned int histogram[256] = {};
+        for (uint64_t key : sortedKeys)
+            histogram[(key >> shift) & 0xff]++;
+        if (count == 0 || histogram[(sortedKeys[0] >> shift) & 0xff] == count)
+            continue;
+
+        unsigned int offsets[256];
+        unsigned int sum = 0;
+        for (int i = 0; i < 256; i++){
+            offsets[i] = sum;
+            sum += histogram[i];
+        }
+        for (size_t i = 0; i < count; i++){
+            unsigned int slot = offsets[(sortedKeys[i] >> shift) & 0xff]++;
+            keyScratch[slot] = sortedKeys[i];
+            orderScratch[slot] = order[i];
+        }
+        sortedKeys.swap(keyScratch);
+        order.swap(orderScratch);
+    }
+}
+
+void RenderQueue::countBatches(const std::vector<uint32_t>& order, unsigned int& drawCalls, unsigned int& stateChanges) const{
+    drawCalls = 0;
+    stateChanges = 0;
+
+    uint64_t runKey = ~0ull;
+    unsigned int boundShader = ~0u;
+    unsigned int boundMaterial = 0;
+    unsigned int runMaterial = 0;
+
+    for (uint32_t index : order){
+        uint64_t key = keys[index];
+        Type type = (Type)keyField(key, TYPE_SHIFT, 2);
+        unsigned int shader = keyField(key, SHADER_SHIFT, 6);
+        unsigned int material = keyField(key, MATERIAL_SHIFT, 16);
+
+        // pass, shader and renderer changes always end the running batch
+        uint64_t run = key >> TYPE_SHIFT;
+        if (run != runKey || type == Type::Model || type == Type::TileLayer){
+            drawCalls++;
+            runKey = run;
+            runMaterial = 0;
+        }
+        if (shader != boundShader){
+            stateChanges++;
+            boundShader = shader;
+        }
+        if (material != 0){
+            if (runMaterial != 0 && runMaterial != material)
+                drawCalls++;
+            if (material != boundMaterial){
+                stateChanges++;
+                boundMaterial = material;
+            }
+            runMaterial = material;
+        }
+    }
+}
+
+void RenderQueue::dispatch(){
+    bool running = false;
+    Type runType = Type::Tile;
+    Shader* runShader = nullptr;
+    unsigned int runPass = 0;
+
+    auto endRun = [&](){
+        if (!running)
+            return;
+        if (runType == Type::Tile){
+            BatchRenderer2D::endBatch();
+            BatchRenderer2D::flush();
+        } else if (runType == Type::Cube){
+            BatchRendererCube::endBatch();
+            BatchRendererCube::flush();
+        }
+        running = false;
+    };
+
+    for (uint32_t index : order){
+        const Command& command = commands[index];
+        unsigned int pass = keyField(keys[index], PASS_SHIFT, 2);
+
+        if (!running || pass != runPass || command.shader != runShader || command.type != runType){
+            endRun();
+            if (pass != runPass || runShader == nullptr)
+                glDepthFunc((RenderPass)pass == RenderPass::Overlay ? GL_LEQUAL : GL_LESS);
+            if (command.shader != runShader)
+                command.shader->use();
+            if (command.type == Type::Tile)
+                BatchRenderer2D::startBatch();
+            else if (command.type == Type::Cube)
+                BatchRendererCube::startBatch();
+
+            running = true;
+            runType = command.type;
+            runShader = command.shader;
+            runPass = pass;
+        }
+
+        switch (command.type){
+        case Type::Tile:{
+            glm::vec2 position = glm::vec2(command.position);
+            glm::vec2 size = glm::vec2(command.size);
+            if (command.sprite)
+                BatchRenderer2D::drawTile(position, size, *command.sprite);
+            else if (command.textured)
+                BatchRenderer2D::drawTile(position, size, command.texture);
+            else
+                BatchRenderer2D::drawTile(position, size, command.color);
+            break;
+        }
+        case Type::Cube:
+            if (command.textured)
+                BatchRendererCube::drawCube(command.position, command.size, command.texture);
+            else
+                BatchRendererCube::drawCube(command.position, command.size, command.color);
+            break;
+        case Type::TileLayer:
+            ((TileLayer*)command.object)->draw();
+            break;
+        case Type::Model:{
+            Model* model = (Model*)command.object;
+            model->setQuantization(*command.shader);
+            if (command.instanceCount != 0){
+                const glm::mat4* instances = &transforms[command.transformIndex];
+                if (camera)
+                    model->drawInstanced(instances, command.instanceCount, *camera, projection, viewportHeight);
+                else
+                    model->drawInstanced(instances, command.instanceCount);
+                break;
+            }
+            const glm::mat4& transform = transforms[command.transformIndex];
+            command.shader->setMat4("model", transform);
+            command.shader->setMat3("normalMatrix", glm::mat3(glm::transpose(glm::inverse(transform))));
+            if (camera)
+                model->draw(transform, *camera, projection, viewportHeight);
+            else
+                model->draw();
+            break;
+        }
+        }
+    }
+    endRun();
+    glDepthFunc(GL_LESS);
+}
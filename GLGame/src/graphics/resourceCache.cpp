@@ -0,0 +1,173 @@
+#include "graphics/resourceCache.hpp"
+
+#include <functional>
+#include <unordered_map>
+#include "graphics/model.hpp"
+#include "graphics/shader.h"
+#include "graphics/texture2D.hpp"
+
+// one kind of resource by key. entries whose resource expired are dropped by sweep()
+template <typename T>
+struct ResourceTable{
+    struct Entry{
+        std::weak_ptr<T> resource;
+        std::function<size_t(const T&)> bytes;
+    };
+    std::unordered_map<std::string, Entry> entries;
+
+    std::shared_ptr<T> find(const std::string& key) const{
+        auto it = entries.find(key);
+        return it != entries.end() ? it->second.resource.lock() : nullptr;
+    }
+
+    void add(const std::string& key, const std::shared_ptr<T>& resource, std::function<size_t(const T&)> bytes){
+        entries[key] = Entry{resource, std::move(bytes)};
+    }
+
+    void sweep(ResourceCache::Stats& stats){
+        for (auto it = entries.begin(); it != entries.end();){
+            std::shared_ptr<T> resource = it->second.resource.lock();
+            if (!resource){
+                it = entries.erase(it);
+                continue;
+            }
+            stats.resident++;
+            stats.residentBytes += it->second.bytes ? it->second.bytes(*resource) : 0;
+            ++it;
+        }
+    }
+};
+
+struct CacheData{
+    ResourceTable<TextureLayer> textureLayers;
+    ResourceTable<Texture2D> textures;
+    ResourceTable<Shader> shaders;
+    ResourceTable<Model> models;
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+};
+
+static CacheData sData;
+
+static std::string textureKey(const std::string& path, bool alphaOn){
+    return path + (alphaOn ? "|rgba" : "|rgb");
+}
+
+static std::string modelKey(const std::string& objPath, const std::string& texturePath, bool alphaOn){
+    return objPath + "|" + textureKey(texturePath, alphaOn);
+}
+
+template <typename T>
+static std::shared_ptr<T> lookup(const ResourceTable<T>& table, const std::string& key){
+    std::shared_ptr<T> resource = table.find(key);
+    if (resource)
+        sData.hits++;
+    return resource;
+}
+
+// a resource loaded elsewhere; when the key is alive already the new one is dropped
+template <typename T>
+static std::shared_ptr<T> insert(ResourceTable<T>& table, const std::string& key, std::shared_ptr<T> resource, std::function<size_t(const T&)> bytes){
+    if (std::shared_ptr<T> existing = lookup(table, key))
+        return existing;
+    sData.misses++;
+    table.add(key, resource, std::move(bytes));
+    return resource;
+}
+
+static size_t textureLayerBytes(const TextureLayer& texture){
+    return TextureManager::getLayerBytes(texture.page);
+}
+
+static size_t textureBytes(const Texture2D& texture){
+    return texture.getBytes();
+}
+
+static size_t modelBytes(const Model& model){
+    return model.getVertexBytes() + model.getIndexBytes();
+}
+
+std::shared_ptr<TextureLayer> ResourceCache::getTextureLayer(const std::string& path){
+    if (std::shared_ptr<TextureLayer> texture = findTextureLayer(path))
+        return texture;
+    return addTextureLayer(path, TextureManager::load(path.c_str()));
+}
+
+std::shared_ptr<TextureLayer> ResourceCache::findTextureLayer(const std::string& path){
+    return lookup(sData.textureLayers, path);
+}
+
+std::shared_ptr<TextureLayer> ResourceCache::addTextureLayer(const std::string& path, const TextureLayer& texture){
+    // the layer goes back to its page with the last handle
+    std::shared_ptr<TextureLayer> resource(new TextureLayer(texture), [](TextureLayer* texture){
+        TextureManager::release(*texture);
+        delete texture;
+    });
+    return insert<TextureLayer>(sData.textureLayers, path, resource, textureLayerBytes);
+}
+
+std::vector<std::shared_ptr<TextureLayer>> ResourceCache::getTextureLayers(const std::vector<std::string>& paths){
+    std::vector<std::shared_ptr<TextureLayer>> textures(paths.size());
+    std::vector<std::string> missing;
+    std::vector<size_t> missingIndices;
+    for (size_t i = 0; i < paths.size(); i++){
+        textures[i] = findTextureLayer(paths[i]);
+        if (!textures[i]){
+            missing.push_back(paths[i]);
+            missingIndices.push_back(i);
+        }
+    }
+
+    std::vector<TextureLayer> loaded = TextureManager::loadAll(missing);
+    for (size_t i = 0; i < loaded.size(); i++)
+        textures[missingIndices[i]] = addTextureLayer(missing[i], loaded[i]);
+    return textures;
+}
+
+std::shared_ptr<Texture2D> ResourceCache::getTexture(const std::string& path, bool alphaOn){
+    if (std::shared_ptr<Texture2D> texture = findTexture(path, alphaOn))
+        return texture;
+    return addTexture(path, alphaOn, Texture2D{path.c_str(), alphaOn});
+}
+
+std::shared_ptr<Texture2D> ResourceCache::findTexture(const std::string& path, bool alphaOn){
+    return lookup(sData.textures, textureKey(path, alphaOn));
+}
+
+std::shared_ptr<Texture2D> ResourceCache::addTexture(const std::string& path, bool alphaOn, Texture2D&& texture){
+    return insert<Texture2D>(sData.textures, textureKey(path, alphaOn), std::make_shared<Texture2D>(std::move(texture)), textureBytes);
+}
+
+std::shared_ptr<Shader> ResourceCache::getShader(const std::string& vertexPath, const std::string& fragmentPath){
+    std::string key = vertexPath + "|" + fragmentPath;
+    if (std::shared_ptr<Shader> shader = lookup(sData.shaders, key))
+        return shader;
+    return insert<Shader>(sData.shaders, key, std::make_shared<Shader>(vertexPath.c_str(), fragmentPath.c_str()), nullptr);
+}
+
+std::shared_ptr<Model> ResourceCache::getModel(const std::string& objPath, const std::string& texturePath, bool alphaOn){
+    if (std::shared_ptr<Model> model = findModel(objPath, texturePath, alphaOn))
+        return model;
+    auto model = std::make_shared<Model>();
+    model->load(objPath, texturePath, alphaOn);
+    return addModel(objPath, texturePath, alphaOn, model);
+}
+
+std::shared_ptr<Model> ResourceCache::findModel(const std::string& objPath, const std::string& texturePath, bool alphaOn){
+    return lookup(sData.models, modelKey(objPath, texturePath, alphaOn));
+}
+
+std::shared_ptr<Model> ResourceCache::addModel(const std::string& objPath, const std::string& texturePath, bool alphaOn, const std::shared_ptr<Model>& model){
+    return insert<Model>(sData.models, modelKey(objPath, texturePath, alphaOn), model, modelBytes);
+}
+
+ResourceCache::Stats ResourceCache::getStats(){
+    Stats stats;
+    stats.hits = sData.hits;
+    stats.misses = sData.misses;
+    sData.textureLayers.sweep(stats);
+    sData.textures.sweep(stats);
+    sData.shaders.sweep(stats);
+    sData.models.sweep(stats);
+    return stats;
+}
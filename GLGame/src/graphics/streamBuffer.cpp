@@ -0,0 +1,105 @@
+#include "graphics/streamBuffer.hpp"
+
+void StreamBuffer::init(size_t segmentSize, UploadMode mode){
+    this->mode = mode;
+    this->segmentSize = segmentSize;
+    segmentIndex = 0;
+
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    if (mode != UploadMode::RingBuffer){
+        staging = new uint8_t[segmentSize];
+        glBufferData(GL_ARRAY_BUFFER, segmentSize, nullptr, mode == UploadMode::Orphan ? GL_STREAM_DRAW : GL_DYNAMIC_DRAW);
+        return;
+    }
+
+    GLsizeiptr totalSize = segmentSize * SEGMENTS;
+    if (GLAD_GL_VERSION_4_4){
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, totalSize, nullptr, flags);
+        persistentPtr = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, 0, totalSize, flags);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+    }
+}
+
+void StreamBuffer::destroy(){
+    for (GLsync& f : fences){
+        if (f)
+            glDeleteSync(f);
+        f = nullptr;
+    }
+    if (persistentPtr || mappedPtr){
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    glDeleteBuffers(1, &vbo);
+    delete[] staging;
+
+    vbo = 0;
+    staging = nullptr;
+    persistentPtr = nullptr;
+    mappedPtr = nullptr;
+}
+
+uint8_t* StreamBuffer::map(){
+    if (mode != UploadMode::RingBuffer)
+        return staging;
+    if (mappedPtr)
+        return mappedPtr;
+
+    waitForSegment();
+
+    if (persistentPtr){
+        mappedPtr = persistentPtr + getOffset();
+    } else {
+        // the fence already guarantees the gpu is done with this slice
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        mappedPtr = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, getOffset(), segmentSize, flags);
+    }
+    return mappedPtr;
+}
+
+void StreamBuffer::unmap(size_t size){
+    switch (mode){
+    case UploadMode::BufferSubData:
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, staging);
+        break;
+    case UploadMode::Orphan:
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, segmentSize, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, staging);
+        break;
+    case UploadMode::RingBuffer:
+        // coherent persistent memory needs no flush
+        if (mappedPtr && !persistentPtr){
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            if (size > 0)
+                glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, size);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        mappedPtr = nullptr;
+        break;
+    }
+}
+
+void StreamBuffer::fence(){
+    if (mode != UploadMode::RingBuffer)
+        return;
+    fences[segmentIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    segmentIndex = (segmentIndex + 1) % SEGMENTS;
+}
+
+void StreamBuffer::waitForSegment(){
+    GLsync& f = fences[segmentIndex];
+    if (!f)
+        return;
+    GLenum result = glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    while (result == GL_TIMEOUT_EXPIRED)
+        result = glClientWaitSync(f, 0, 1000000000);
+    glDeleteSync(f);
+    f = nullptr;
+}
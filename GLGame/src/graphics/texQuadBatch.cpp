@@ -1,4 +1,6 @@
 #include "graphics/texQuadBatch.hpp"
+#include <cstring>
+#include "graphics/textureStreamer.hpp"
 
 TexQuadBatch::TexQuadBatch(){
     unsigned int indices[] = {
@@ -7,7 +9,7 @@ TexQuadBatch::TexQuadBatch(){
         4, 5, 6,
         6, 7, 4,
     };	
-    shader = Shader("resources/shaders/texQuadShader.vs", "resources/shaders/texQuadShader.fs");
+    shader = ResourceCache::getShader("resources/shaders/texQuadShader.vs", "resources/shaders/texQuadShader.fs");
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
@@ -29,13 +31,12 @@ TexQuadBatch::TexQuadBatch(){
     // texture coord attribute
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TexQuadVertex), (const void*)(offsetof(TexQuadVertex, TexCoords)));
     glEnableVertexAttribArray(2);
-    // texture coord attribute
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(TexQuadVertex), (const void*)(offsetof(TexQuadVertex, TexID)));
+    // texture index attribute
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(TexQuadVertex), (const void*)(offsetof(TexQuadVertex, TexID)));
     glEnableVertexAttribArray(3);
 
-    shader.use();
-    int sampler[2] = {0, 1};
-    shader.setTextures("u_Textures", sampler, 2);
+    shader->use();
+    shader->setInt("u_TextureArray", 0);
 }
 
 TexQuadBatch::~TexQuadBatch(){
@@ -46,19 +47,17 @@ TexQuadBatch::~TexQuadBatch(){
 
 void TexQuadBatch::render(Camera& camera, float deltaTime){
 
-    auto q0 = createQuad(-1.5f, 0, 1, 1, 0);
-    auto q1 = createQuad(0.5f, 0, 1, 1, 1);
+    auto q0 = createQuad(-1.5f, 0, 1, 1, textures[0]->layer);
+    auto q1 = createQuad(0.5f, 0, 1, 1, textures[1]->layer);
 
     TexQuadVertex vertices[8];
     memcpy(vertices, q0.data(), q0.size() * sizeof(TexQuadVertex));
     memcpy(vertices + q0.size(), q1.data(), q1.size()  * sizeof(TexQuadVertex));
     
-    shader.use();
-     // bind textures on corresponding texture units
+    shader->use();
+    // both textures are 512x512 and share a texture array page
     glActiveTexture(GL_TEXTURE0);
-    texture1.bind();
-    glActiveTexture(GL_TEXTURE0 + 1);
-    texture2.bind();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, TextureManager::getArrayID(textures[0]->page));
     
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
@@ -68,18 +67,21 @@ void TexQuadBatch::render(Camera& camera, float deltaTime){
     glm::mat4 view = camera.GetViewMatrix();
     
     projection = glm::perspective(glm::radians(45.0f), (float)800 / 600, 0.1f, 100.0f);
-
-    shader.use();
-    shader.setMat4("model", model);
-    shader.setMat4("view", view);
-    shader.setMat4("projection", projection);
-    shader.setFloat("tick", deltaTime);
+    // both 1x1 quads sit on z = 0 around the origin
+    float distance = glm::max(glm::abs(camera.Position.z), 0.0001f);
+    TextureStreamer::request(textures[0]->page, TextureStreamer::getScreenSize(1.0f, distance, projection, 600.0f));
+
+    shader->use();
+    shader->setMat4("model", model);
+    shader->setMat4("view", view);
+    shader->setMat4("projection", projection);
+    shader->setFloat("tick", deltaTime);
     
     glBindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
 }
 
-std::array<TexQuadBatch::TexQuadVertex, 4> TexQuadBatch::createQuad(float x, float y, float sizeX, float sizeY, float textureID){
+std::array<TexQuadBatch::TexQuadVertex, 4> TexQuadBatch::createQuad(float x, float y, float sizeX, float sizeY, unsigned int textureID){
     TexQuadVertex v0;
     v0.Position = glm::vec3(x, y, 0);
     v0.Color = glm::vec4(1, 1, 1, 1);
@@ -0,0 +1,333 @@
+#include "graphics/textureArray.hpp"
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <vector>
+#include "graphics/imageDecoder.hpp"
+
+static const unsigned int INITIAL_LAYERS = 8;
+// big pages like atlases start with fewer layers, growPage doubles them when needed
+static const size_t INITIAL_PAGE_BYTES = 8 * 1024 * 1024;
+
+struct TexturePage{
+    unsigned int arrayID = 0;
+    int width = 0;
+    int height = 0;
+    // levels of the full chain, fewer for pages whose small mips would mix their texels
+    unsigned int levelCount = 0;
+    unsigned int layerCount = 0;
+    unsigned int capacity = 0;
+    // released layers below layerCount, handed out again before layerCount grows
+    std::vector<uint16_t> freeLayers;
+    // level of the full chain that is level 0 of arrayID, the ones above aren't in gl
+    unsigned int residentLevel = 0;
+    bool streamed = false;
+    std::vector<std::string> sources;
+    // added layers nothing was decoded for yet, white until they stream in
+    std::vector<bool> pending;
+};
+
+static std::vector<TexturePage> sPages;
+
+static int getLevelSize(int size, unsigned int level){
+    return std::max(size >> level, 1);
+}
+
+static unsigned int getStartLevel(int width, int height){
+    unsigned int level = 0;
+    while (std::max(getLevelSize(width, level), getLevelSize(height, level)) > TextureManager::STREAMING_START_SIZE)
+        level++;
+    return level;
+}
+
+// storage for the page's levels from topLevel down up front, each layer's levels come from MipGenerator
+static unsigned int createArray(const TexturePage& page, unsigned int topLevel, unsigned int layers){
+    unsigned int id;
+    int width = getLevelSize(page.width, topLevel), height = getLevelSize(page.height, topLevel);
+    unsigned int levels = page.levelCount - topLevel;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (int)levels - 1);
+    for (unsigned int level = 0; level < levels; level++)
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, (int)level, GL_RGBA8, getLevelSize(width, level), getLevelSize(height, level), layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    return id;
+}
+
+// the layer's levels from the page's resident level until endLevel, levels of the full chain
+static void uploadLayer(const TexturePage& page, unsigned int layer, const unsigned char* pixels, const std::vector<MipLevel>& mips, unsigned int endLevel){
+    glBindTexture(GL_TEXTURE_2D_ARRAY, page.arrayID);
+    for (unsigned int level = page.residentLevel; level < endLevel && level <= mips.size(); level++){
+        const unsigned char* data = level == 0 ? pixels : mips[level - 1].pixels.data();
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (int)(level - page.residentLevel), 0, 0, layer, getLevelSize(page.width, level), getLevelSize(page.height, level), 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    }
+}
+
+// white at the levels from the page's resident level until endLevel, the smaller
+// ones read the start of the same buffer
+static void uploadWhiteLayer(const TexturePage& page, unsigned int layer, unsigned int endLevel){
+    std::vector<uint32_t> white((size_t)getLevelSize(page.width, page.residentLevel) * getLevelSize(page.height, page.residentLevel), 0xffffffff);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, page.arrayID);
+    for (unsigned int level = page.residentLevel; level < endLevel; level++)
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (int)(level - page.residentLevel), 0, 0, layer, getLevelSize(page.width, level), getLevelSize(page.height, level), 1, GL_RGBA, GL_UNSIGNED_BYTE, white.data());
+}
+
+// copies the levels the page has resident into another array for its layers whose
+// top level is destinationLevel. the texels never leave the gpu: copy_image on 4.3,
+// a read framebuffer on each layer before that
+static void copyLevels(const TexturePage& page, unsigned int destinationID, unsigned int destinationLevel){
+    unsigned int first = std::max(page.residentLevel, destinationLevel);
+    unsigned int levels = page.levelCount;
+    if (GLAD_GL_VERSION_4_3){
+        for (unsigned int level = first; level < levels; level++)
+            glCopyImageSubData(page.arrayID, GL_TEXTURE_2D_ARRAY, (int)(level - page.residentLevel), 0, 0, 0,
+                               destinationID, GL_TEXTURE_2D_ARRAY, (int)(level - destinationLevel), 0, 0, 0,
+                               getLevelSize(page.width, level), getLevelSize(page.height, level), page.layerCount);
+        return;
+    }
+
+    int readFramebuffer;
+    unsigned int framebuffer;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, destinationID);
+    for (unsigned int level = first; level < levels; level++){
+        for (unsigned int layer = 0; layer < page.layerCount; layer++){
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, page.arrayID, (int)(level - page.residentLevel), (int)layer);
+            glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, (int)(level - destinationLevel), 0, 0, (int)layer, 0, 0, getLevelSize(page.width, level), getLevelSize(page.height, level));
+        }
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, (unsigned int)readFramebuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+}
+
+// returns the page's index. slots of deleted pages are reused, page 0 is always the white page
+static uint16_t createPage(int width, int height, unsigned int levelCount, unsigned int capacity, bool streamed){
+    size_t index = sPages.empty() ? 0 : 1;
+    while (index < sPages.size() && sPages[index].arrayID != 0)
+        index++;
+    if (index == sPages.size())
+        sPages.emplace_back();
+
+    TexturePage& page = sPages[index];
+    page = TexturePage{};
+    page.width = width;
+    page.height = height;
+    page.levelCount = levelCount;
+    page.capacity = capacity;
+    page.streamed = streamed;
+    page.residentLevel = streamed ? getStartLevel(width, height) : 0;
+    page.arrayID = createArray(page, page.residentLevel, capacity);
+    uploadWhiteLayer(page, 0, levelCount);
+    page.layerCount = 1;
+    return (uint16_t)index;
+}
+
+// array textures can't be resized, so copy the layers into a bigger one, level by level
+static void growPage(TexturePage& page){
+    unsigned int capacity = page.capacity * 2;
+    unsigned int id = createArray(page, page.residentLevel, capacity);
+    copyLevels(page, id, page.residentLevel);
+
+    glDeleteTextures(1, &page.arrayID);
+    page.arrayID = id;
+    page.capacity = capacity;
+}
+
+void TextureManager::init(){
+    if (!sPages.empty())
+        return;
+    // page 0 only holds the white layer, bound when a batch has no textures
+    createPage(1, 1, 1, 1, false);
+}
+
+void TextureManager::shutdown(){
+    for (TexturePage& page : sPages)
+        glDeleteTextures(1, &page.arrayID);
+    sPages.clear();
+}
+
+TextureLayer TextureManager::load(const char* path){
+    int width, height;
+    if (!ImageDecoder::getSize(path, width, height))
+        return TextureLayer{};
+    return add(width, height, path);
+}
+
+// a free layer of a page of the size and level count, streamed pages only hold layers with a source
+static TextureLayer addLayer(int width, int height, unsigned int levelCount, bool streamed){
+    uint16_t pageIndex = 1;
+    while (pageIndex < sPages.size() && (sPages[pageIndex].arrayID == 0 || sPages[pageIndex].width != width || sPages[pageIndex].height != height
+                                         || sPages[pageIndex].levelCount != levelCount || sPages[pageIndex].streamed != streamed))
+        pageIndex++;
+    if (pageIndex == sPages.size())
+        pageIndex = createPage(width, height, levelCount, (unsigned int)std::clamp<size_t>(INITIAL_PAGE_BYTES / ((size_t)width * height * 4), 2, INITIAL_LAYERS), streamed);
+
+    TexturePage& page = sPages[pageIndex];
+    TextureLayer texture;
+    texture.page = pageIndex;
+    if (!page.freeLayers.empty()){
+        texture.layer = page.freeLayers.back();
+        page.freeLayers.pop_back();
+    } else {
+        if (page.layerCount == page.capacity)
+            growPage(page);
+        texture.layer = (uint16_t)page.layerCount++;
+    }
+    if (page.sources.size() <= texture.layer){
+        page.sources.resize(texture.layer + 1);
+        page.pending.resize(texture.layer + 1);
+    }
+    return texture;
+}
+
+TextureLayer TextureManager::add(const unsigned char* pixels, int width, int height){
+    return add(pixels, width, height, MipGenerator::generate(pixels, width, height));
+}
+
+TextureLayer TextureManager::add(const unsigned char* pixels, int width, int height, const std::vector<MipLevel>& mips){
+    init();
+    unsigned int levelCount = MipGenerator::getLevelCount(width, height);
+    TextureLayer texture = addLayer(width, height, levelCount, false);
+    uploadLayer(sPages[texture.page], texture.layer, pixels, mips, levelCount);
+    return texture;
+}
+
+TextureLayer TextureManager::add(const unsigned char* pixels, int width, int height, unsigned int levelCount){
+    init();
+    levelCount = std::clamp(levelCount, 1u, MipGenerator::getLevelCount(width, height));
+    TextureLayer texture = addLayer(width, height, levelCount, false);
+    uploadLayer(sPages[texture.page], texture.layer, pixels, MipGenerator::generate(pixels, width, height), levelCount);
+    return texture;
+}
+
+TextureLayer TextureManager::add(int width, int height, const std::string& source){
+    init();
+    unsigned int levelCount = MipGenerator::getLevelCount(width, height);
+    TextureLayer texture = addLayer(width, height, levelCount, true);
+    TexturePage& page = sPages[texture.page];
+    uploadWhiteLayer(page, texture.layer, levelCount);
+    page.sources[texture.layer] = source;
+    page.pending[texture.layer] = true;
+    return texture;
+}
+
+std::vector<TextureLayer> TextureManager::loadAll(const std::vector<std::string>& paths){
+    std::vector<TextureLayer> textures(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+        textures[i] = load(paths[i].c_str());
+    return textures;
+}
+
+void TextureManager::release(const TextureLayer& texture){
+    // page 0 and the white layers are never handed out, layers of a page that
+    // shutdown already deleted are nothing to release
+    if (texture.page == 0 || texture.layer == 0 || texture.page >= sPages.size())
+        return;
+    TexturePage& page = sPages[texture.page];
+    if (page.arrayID == 0 || texture.layer >= page.layerCount)
+        return;
+
+    page.freeLayers.push_back(texture.layer);
+    if (texture.layer < page.sources.size()){
+        page.sources[texture.layer].clear();
+        page.pending[texture.layer] = false;
+    }
+    if (page.freeLayers.size() == page.layerCount - 1){
+        glDeleteTextures(1, &page.arrayID);
+        page = TexturePage{};
+    }
+}
+
+size_t TextureManager::getLayerBytes(uint16_t page){
+    if (page >= sPages.size())
+        return 0;
+    const TexturePage& texturePage = sPages[page];
+    return (size_t)getLevelSize(texturePage.width, texturePage.residentLevel) * getLevelSize(texturePage.height, texturePage.residentLevel) * 4 * 4 / 3;
+}
+
+bool TextureManager::isStreamed(uint16_t page){
+    return page < sPages.size() && sPages[page].arrayID != 0 && sPages[page].streamed;
+}
+
+int TextureManager::getWidth(uint16_t page){
+    return page < sPages.size() ? sPages[page].width : 0;
+}
+
+int TextureManager::getHeight(uint16_t page){
+    return page < sPages.size() ? sPages[page].height : 0;
+}
+
+unsigned int TextureManager::getLevelCount(uint16_t page){
+    return page < sPages.size() && sPages[page].arrayID != 0 ? sPages[page].levelCount : 0;
+}
+
+unsigned int TextureManager::getResidentLevel(uint16_t page){
+    return page < sPages.size() ? sPages[page].residentLevel : 0;
+}
+
+unsigned int TextureManager::getStartLevel(uint16_t page){
+    return isStreamed(page) ? ::getStartLevel(sPages[page].width, sPages[page].height) : 0;
+}
+
+size_t TextureManager::getPageBytes(uint16_t page, unsigned int level){
+    if (page >= sPages.size() || sPages[page].arrayID == 0)
+        return 0;
+    const TexturePage& texturePage = sPages[page];
+    size_t bytes = 0;
+    for (; level < texturePage.levelCount; level++)
+        bytes += (size_t)getLevelSize(texturePage.width, level) * getLevelSize(texturePage.height, level) * 4;
+    return bytes * texturePage.capacity;
+}
+
+std::vector<std::string> TextureManager::getSources(uint16_t page){
+    return page < sPages.size() && sPages[page].arrayID != 0 ? sPages[page].sources : std::vector<std::string>{};
+}
+
+std::vector<bool> TextureManager::getPendingLayers(uint16_t page){
+    return page < sPages.size() && sPages[page].arrayID != 0 ? sPages[page].pending : std::vector<bool>{};
+}
+
+bool TextureManager::hasPendingLayers(uint16_t page){
+    return isStreamed(page) && std::find(sPages[page].pending.begin(), sPages[page].pending.end(), true) != sPages[page].pending.end();
+}
+
+void TextureManager::setResidentLevel(uint16_t pageIndex, unsigned int level, const std::vector<DecodedImage>& images, const std::vector<std::vector<MipLevel>>& mips){
+    if (!isStreamed(pageIndex))
+        return;
+    TexturePage& page = sPages[pageIndex];
+    unsigned int levels = page.levelCount;
+    level = std::min(level, levels - 1);
+    unsigned int previousLevel = page.residentLevel;
+    if (level != previousLevel){
+        unsigned int id = createArray(page, level, page.capacity);
+        copyLevels(page, id, level);
+        glDeleteTextures(1, &page.arrayID);
+        page.arrayID = id;
+        page.residentLevel = level;
+    }
+    if (level < previousLevel)
+        uploadWhiteLayer(page, 0, previousLevel);
+
+    // the levels the old array didn't have, all of them for a pending layer. released
+    // layers are never sampled and stay undefined
+    for (unsigned int layer = 1; layer < page.layerCount && layer < images.size() && layer < mips.size(); layer++){
+        if (images[layer].isEmpty())
+            continue;
+        if (level < previousLevel || page.pending[layer])
+            uploadLayer(page, layer, images[layer].pixels, mips[layer], page.pending[layer] ? levels : previousLevel);
+        page.pending[layer] = false;
+    }
+}
+
+unsigned int TextureManager::getArrayID(uint16_t page){
+    return sPages[page].arrayID;
+}
+
+unsigned int TextureManager::getPageCount(){
+    return (unsigned int)sPages.size();
+}
@@ -0,0 +1,77 @@
+#include "graphics/textureAtlas.hpp"
+
+#include <cstring>
+#include <iostream>
+#include "core/mappedFile.hpp"
+#include "graphics/atlasPacker.hpp"
+#include "graphics/batchVertex.hpp"
+
+static const char MAGIC[4] = {'G', 'L', 'G', 'A'};
+
+static bool isValid(const AtlasFileHeader& header, size_t fileSize){
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != AtlasPacker::VERSION)
+        return false;
+    if (header.pageWidth == 0 || header.pageHeight == 0 || header.pageCount == 0 || header.levelCount == 0)
+        return false;
+    size_t recordsEnd = sizeof(AtlasFileHeader) + sizeof(AtlasSpriteRecord) * (size_t)header.spriteCount;
+    size_t pageBytes = (size_t)header.pageWidth * header.pageHeight * 4;
+    return header.pageOffset >= recordsEnd && (size_t)header.pageOffset + pageBytes * header.pageCount <= fileSize;
+}
+
+static void packTexCoords(AtlasSprite& sprite){
+    sprite.texCoords[0] = packTexCoord(sprite.uvMin.x, sprite.uvMin.y);
+    sprite.texCoords[1] = packTexCoord(sprite.uvMax.x, sprite.uvMin.y);
+    sprite.texCoords[2] = packTexCoord(sprite.uvMax.x, sprite.uvMax.y);
+    sprite.texCoords[3] = packTexCoord(sprite.uvMin.x, sprite.uvMax.y);
+}
+
+TextureAtlas::~TextureAtlas(){
+    destroy();
+}
+
+bool TextureAtlas::load(const std::string& path){
+    destroy();
+    MappedFile file;
+    if (!file.open(path)){
+        std::cout << "unable to open file: " << path << std::endl;
+        return false;
+    }
+    const AtlasFileHeader* header = (const AtlasFileHeader*)file.getData();
+    if (file.getSize() < sizeof(AtlasFileHeader) || !isValid(*header, file.getSize())){
+        std::cout << "not a texture atlas: " << path << std::endl;
+        return false;
+    }
+
+    // the mips are built here, only as many as the gutters keep the sprites apart in.
+    // the smaller ones would blend neighbouring sprites into each other
+    int width = (int)header->pageWidth, height = (int)header->pageHeight;
+    size_t pageBytes = (size_t)width * height * 4;
+    for (uint32_t i = 0; i < header->pageCount; i++)
+        pages.push_back(TextureManager::add((const unsigned char*)file.getData() + header->pageOffset + pageBytes * i, width, height, header->levelCount));
+
+    const AtlasSpriteRecord* records = (const AtlasSpriteRecord*)(file.getData() + sizeof(AtlasFileHeader));
+    for (uint32_t i = 0; i < header->spriteCount; i++){
+        const AtlasSpriteRecord& record = records[i];
+        if (record.page >= header->pageCount || record.x + record.width > header->pageWidth || record.y + record.height > header->pageHeight)
+            continue;
+        AtlasSprite sprite;
+        sprite.texture = pages[record.page];
+        sprite.uvMin = glm::vec2(record.x, record.y) / glm::vec2(width, height);
+        sprite.uvMax = glm::vec2(record.x + record.width, record.y + record.height) / glm::vec2(width, height);
+        packTexCoords(sprite);
+        sprites[std::string(record.name, strnlen(record.name, sizeof(record.name)))] = sprite;
+    }
+    return true;
+}
+
+void TextureAtlas::destroy(){
+    for (const TextureLayer& page : pages)
+        TextureManager::release(page);
+    pages.clear();
+    sprites.clear();
+}
+
+const AtlasSprite* TextureAtlas::find(const std::string& name) const{
+    auto sprite = sprites.find(name);
+    return sprite != sprites.end() ? &sprite->second : nullptr;
+}
@@ -0,0 +1,256 @@
+#include "graphics/textureStreamer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "core/threadPool.hpp"
+#include "graphics/imageDecoder.hpp"
+#include "graphics/mipGenerator.hpp"
+#include "graphics/textureArray.hpp"
+
+static const unsigned int NO_REQUEST = ~0u;
+
+struct StreamedPage{
+    // finest level a draw asked for this frame
+    unsigned int wantedLevel = NO_REQUEST;
+    uint64_t lastUsedFrame = 0;
+    bool loading = false;
+    // a source that doesn't decode any more, the page keeps what it has
+    bool failed = false;
+};
+
+// a page's layers decoded on a worker, uploaded by the next update()
+struct StreamIn{
+    uint16_t page;
+    unsigned int level;
+    std::vector<std::string> sources;
+    // the layers to decode, all of them for a new level, only the pending ones otherwise
+    std::vector<bool> layers;
+    std::vector<DecodedImage> images;
+    std::vector<std::vector<MipLevel>> mips;
+    bool failed = false;
+    std::chrono::steady_clock::time_point started;
+};
+
+struct StreamerData{
+    std::mutex mutex;
+    std::condition_variable idle;
+    std::vector<std::shared_ptr<StreamIn>> finished;
+    unsigned int decoding = 0;
+
+    std::vector<StreamedPage> pages;
+    uint64_t frame = 1;
+    size_t budget = TextureStreamer::DEFAULT_BUDGET;
+    size_t residentBytes = 0;
+    TextureStreamer::Stats stats;
+    double totalLatencyMilliseconds = 0.0;
+};
+
+static StreamerData sData;
+
+static StreamedPage& getPage(uint16_t page){
+    if (page >= sData.pages.size())
+        sData.pages.resize(page + 1);
+    return sData.pages[page];
+}
+
+static void decode(StreamIn& streamIn, int width, int height){
+    streamIn.images.resize(streamIn.sources.size());
+    streamIn.mips.resize(streamIn.sources.size());
+    for (size_t layer = 0; layer < streamIn.sources.size(); layer++){
+        if (streamIn.sources[layer].empty() || !streamIn.layers[layer])
+            continue;
+        // a file changed on disk since it was added no longer fits the page
+        DecodedImage& image = streamIn.images[layer];
+        if (!ImageDecoder::decode(streamIn.sources[layer], 4, image) || image.width != width || image.height != height){
+            streamIn.failed = true;
+            return;
+        }
+        streamIn.mips[layer] = MipGenerator::generate(image.pixels, image.width, image.height);
+    }
+}
+
+static void startStreamIn(uint16_t page, unsigned int level){
+    auto streamIn = std::make_shared<StreamIn>();
+    streamIn->page = page;
+    streamIn->level = level;
+    streamIn->sources = TextureManager::getSources(page);
+    streamIn->layers = TextureManager::getPendingLayers(page);
+    if (level < TextureManager::getResidentLevel(page))
+        streamIn->layers.assign(streamIn->sources.size(), true);
+    streamIn->started = std::chrono::steady_clock::now();
+    getPage(page).loading = true;
+    int width = TextureManager::getWidth(page), height = TextureManager::getHeight(page);
+    {
+        std::lock_guard<std::mutex> lock(sData.mutex);
+        sData.decoding++;
+    }
+    ThreadPool::submit([streamIn, width, height]{
+        decode(*streamIn, width, height);
+        std::lock_guard<std::mutex> lock(sData.mutex);
+        sData.finished.push_back(streamIn);
+        if (--sData.decoding == 0)
+            sData.idle.notify_all();
+    });
+}
+
+static void finishStreamIn(StreamIn& streamIn){
+    StreamedPage& state = getPage(streamIn.page);
+    state.loading = false;
+    // layers added or released while it decoded, the next request starts over
+    if (streamIn.sources != TextureManager::getSources(streamIn.page))
+        return;
+    if (streamIn.failed){
+        state.failed = true;
+        return;
+    }
+    unsigned int resident = TextureManager::getResidentLevel(streamIn.page);
+    if (streamIn.level > resident)
+        return;
+
+    sData.residentBytes -= TextureManager::getPageBytes(streamIn.page, resident);
+    TextureManager::setResidentLevel(streamIn.page, streamIn.level, streamIn.images, streamIn.mips);
+    sData.residentBytes += TextureManager::getPageBytes(streamIn.page, streamIn.level);
+
+    double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - streamIn.started).count();
+    sData.stats.streamIns++;
+    sData.totalLatencyMilliseconds += latency;
+    sData.stats.longestLatencyMilliseconds = std::max(sData.stats.longestLatencyMilliseconds, latency);
+}
+
+// drops one level at a time from the least recently used page until the pages fit
+// in limit. a page drawn this frame keeps the levels it asked for
+static void evict(size_t limit, uint16_t keep){
+    while (sData.residentBytes > limit){
+        uint16_t victim = 0;
+        uint64_t oldest = ~0ull;
+        for (uint16_t page = 1; page < TextureManager::getPageCount(); page++){
+            if (page == keep || !TextureManager::isStreamed(page))
+                continue;
+            const StreamedPage& state = getPage(page);
+            unsigned int floorLevel = TextureManager::getStartLevel(page);
+            if (state.lastUsedFrame == sData.frame)
+                floorLevel = std::min(floorLevel, state.wantedLevel);
+            if (state.loading || TextureManager::getResidentLevel(page) >= floorLevel || state.lastUsedFrame >= oldest)
+                continue;
+            victim = page;
+            oldest = state.lastUsedFrame;
+        }
+        if (victim == 0)
+            return;
+
+        unsigned int resident = TextureManager::getResidentLevel(victim);
+        sData.residentBytes -= TextureManager::getPageBytes(victim, resident) - TextureManager::getPageBytes(victim, resident + 1);
+        TextureManager::setResidentLevel(victim, resident + 1, {}, {});
+        sData.stats.evictions++;
+    }
+}
+
+void TextureStreamer::setBudget(size_t bytes){
+    sData.budget = bytes;
+}
+
+size_t TextureStreamer::getBudget(){
+    return sData.budget;
+}
+
+void TextureStreamer::request(uint16_t page, float screenPixels){
+    if (!TextureManager::isStreamed(page))
+        return;
+    StreamedPage& state = getPage(page);
+    // the level whose texels come closest to one per pixel without going under
+    float texels = (float)std::max(TextureManager::getWidth(page), TextureManager::getHeight(page));
+    unsigned int level = 0;
+    if (screenPixels > 0.0f && screenPixels < texels)
+        level = (unsigned int)std::floor(std::log2(texels / screenPixels));
+    level = std::min(level, TextureManager::getLevelCount(page) - 1);
+
+    if (state.lastUsedFrame != sData.frame)
+        state.wantedLevel = NO_REQUEST;
+    state.wantedLevel = std::min(state.wantedLevel, level);
+    state.lastUsedFrame = sData.frame;
+}
+
+float TextureStreamer::getScreenSize(float worldSize, float distance, const glm::mat4& projection, float viewportHeight){
+    float pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+    // same as Model::selectLod, only perspective projections shrink with distance
+    if (projection[3][3] == 0.0f)
+        pixelsPerUnit /= std::max(distance, 0.0001f);
+    return worldSize * pixelsPerUnit;
+}
+
+void TextureStreamer::update(){
+    std::vector<std::shared_ptr<StreamIn>> finished;
+    {
+        std::lock_guard<std::mutex> lock(sData.mutex);
+        finished.swap(sData.finished);
+    }
+
+    // counted again every frame, pages come and go with TextureManager::add and release.
+    // only streamed pages can be evicted, so only they are held to the budget
+    sData.residentBytes = 0;
+    sData.stats.fixedBytes = 0;
+    for (uint16_t page = 0; page < TextureManager::getPageCount(); page++){
+        size_t bytes = TextureManager::getPageBytes(page, TextureManager::getResidentLevel(page));
+        if (TextureManager::isStreamed(page))
+            sData.residentBytes += bytes;
+        else
+            sData.stats.fixedBytes += bytes;
+    }
+    for (std::shared_ptr<StreamIn>& streamIn : finished)
+        finishStreamIn(*streamIn);
+
+    for (uint16_t page = 1; page < TextureManager::getPageCount(); page++){
+        StreamedPage& state = getPage(page);
+        // a deleted page's slot may come back as a new page, it starts over
+        if (!TextureManager::isStreamed(page)){
+            if (!state.loading)
+                state = StreamedPage{};
+            continue;
+        }
+        // layers added since the last stream-in are decoded with the page's first draw
+        unsigned int resident = TextureManager::getResidentLevel(page);
+        bool pending = TextureManager::hasPendingLayers(page);
+        if (state.lastUsedFrame != sData.frame || (state.wantedLevel >= resident && !pending) || state.loading || state.failed)
+            continue;
+
+        // room is made before the decode starts, so the upload never goes over. what
+        // eviction can't free lowers the level the page streams in at
+        size_t current = TextureManager::getPageBytes(page, resident);
+        unsigned int level = std::min(state.wantedLevel, resident);
+        while (level < resident && TextureManager::getPageBytes(page, level) - current > sData.budget)
+            level++;
+        evict(sData.budget - (TextureManager::getPageBytes(page, level) - current), page);
+        while (level < resident && sData.residentBytes - current + TextureManager::getPageBytes(page, level) > sData.budget)
+            level++;
+        if (level < resident || pending)
+            startStreamIn(page, level);
+    }
+    evict(sData.budget, 0);
+
+    sData.stats.budgetBytes = sData.budget;
+    sData.stats.residentBytes = sData.residentBytes;
+    sData.frame++;
+}
+
+void TextureStreamer::shutdown(){
+    std::unique_lock<std::mutex> lock(sData.mutex);
+    sData.idle.wait(lock, []{ return sData.decoding == 0; });
+    sData.finished.clear();
+    sData.pages.clear();
+}
+
+TextureStreamer::Stats TextureStreamer::getStats(){
+    Stats stats = sData.stats;
+    {
+        std::lock_guard<std::mutex> lock(sData.mutex);
+        stats.pending = sData.decoding + (unsigned int)sData.finished.size();
+    }
+    stats.averageLatencyMilliseconds = stats.streamIns > 0 ? sData.totalLatencyMilliseconds / stats.streamIns : 0.0;
+    return stats;
+}
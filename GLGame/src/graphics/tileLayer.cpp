@@ -0,0 +1,274 @@
+#include "graphics/tileLayer.hpp"
+#include "core/threadPool.hpp"
+
+#include <algorithm>
+#include <glad/glad.h>
+
+static const uint32_t UV_00 = packTexCoord(0.0f, 0.0f);
+static const uint32_t UV_10 = packTexCoord(1.0f, 0.0f);
+static const uint32_t UV_11 = packTexCoord(1.0f, 1.0f);
+static const uint32_t UV_01 = packTexCoord(0.0f, 1.0f);
+static const uint32_t FULL_TEXTURE[4] = {UV_00, UV_10, UV_11, UV_01};
+
+static void writeTileVertices(BatchVertex* v, const glm::vec2& position, float tileSize, uint32_t color, uint16_t textureIndex,
+                              const uint32_t* texCoords = FULL_TEXTURE){
+    v[0].position = {position.x, 0.0f, position.y + tileSize};
+    v[1].position = {position.x + tileSize, 0.0f, position.y + tileSize};
+    v[2].position = {position.x + tileSize, 0.0f, position.y};
+    v[3].position = {position.x, 0.0f, position.y};
+    for (int i = 0; i < 4; i++){
+        v[i].texCoord = texCoords[i];
+        v[i].color = color;
+        v[i].texIndex = textureIndex;
+        v[i].normalIndex = NORMAL_POS_Y;
+        v[i].padding = 0;
+    }
+}
+
+TileLayer::~TileLayer(){
+    destroy();
+}
+
+void TileLayer::init(unsigned int width, unsigned int height, float tileSize){
+    destroy();
+    renderStats = Stats{};
+    this->width = width;
+    this->height = height;
+    this->tileSize = tileSize;
+    chunksX = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunksY = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    // tiles of one chunk are contiguous so a dirty chunk is a single sub-range upload
+    unsigned int firstTile = 0;
+    chunks.resize(chunksX * chunksY);
+    for (unsigned int cy = 0; cy < chunksY; cy++){
+        for (unsigned int cx = 0; cx < chunksX; cx++){
+            Chunk& chunk = chunks[cy * chunksX + cx];
+            chunk.firstTile = firstTile;
+            chunk.width = std::min(CHUNK_SIZE, width - cx * CHUNK_SIZE);
+            chunk.height = std::min(CHUNK_SIZE, height - cy * CHUNK_SIZE);
+            chunk.dirtyBegin = chunk.dirtyEnd = 0;
+            firstTile += chunk.width * chunk.height;
+        }
+    }
+
+    unsigned int tileCount = width * height;
+    vertices.resize(tileCount * 4);
+    buildChunks([](unsigned int, unsigned int){ return glm::vec4(1.0f); });
+
+    std::vector<unsigned int> indices(tileCount * 6);
+    for (unsigned int i = 0, offset = 0; i < indices.size(); i += 6, offset += 4){
+        indices[i + 0] = offset + 0;
+        indices[i + 1] = offset + 1;
+        indices[i + 2] = offset + 2;
+
+        indices[i + 3] = offset + 2;
+        indices[i + 4] = offset + 3;
+        indices[i + 5] = offset + 0;
+    }
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ibo);
+
+    glBindVertexArray(vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(BatchVertex) * vertices.size(), vertices.data(), GL_DYNAMIC_DRAW);
+    setupBatchVertexAttributes();
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+    TextureManager::init();
+    texturePage = 0;
+}
+
+void TileLayer::destroy(){
+    if (vao == 0)
+        return;
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ibo);
+    vao = vbo = ibo = 0;
+
+    vertices.clear();
+    chunks.clear();
+    dirtyChunks.clear();
+}
+
+void TileLayer::setupShaderSampler(Shader& shader){
+    shader.use();
+    shader.setInt("u_TextureArray", 0);
+}
+
+void TileLayer::setTile(unsigned int x, unsigned int y, const glm::vec4& color){
+    writeTile(x, y, packColor(color), 0);
+}
+
+void TileLayer::setTile(unsigned int x, unsigned int y, const TextureLayer& texture){
+    if (texture.layer != 0 && texturePage != 0 && texturePage != texture.page){
+        renderStats.otherPageTiles++;
+        writeTile(x, y, 0xffffffff, 0);
+        return;
+    }
+    if (texture.layer != 0)
+        texturePage = texture.page;
+    writeTile(x, y, 0xffffffff, texture.layer);
+}
+
+void TileLayer::setTile(unsigned int x, unsigned int y, const AtlasSprite& sprite){
+    if (sprite.texture.layer != 0 && texturePage != 0 && texturePage != sprite.texture.page){
+        renderStats.otherPageTiles++;
+        writeTile(x, y, 0xffffffff, 0);
+        return;
+    }
+    if (sprite.texture.layer != 0)
+        texturePage = sprite.texture.page;
+    writeTile(x, y, 0xffffffff, sprite.texture.layer, sprite.texCoords);
+}
+
+void TileLayer::fill(const std::function<glm::vec4(unsigned int x, unsigned int y)>& colorAt){
+    if (vao == 0)
+        return;
+    buildChunks(colorAt);
+
+    // the whole mesh changed, one upload beats one per chunk
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(BatchVertex) * vertices.size(), vertices.data());
+    renderStats.chunksUpdated += (unsigned int)chunks.size();
+    renderStats.tilesUploaded += width * height;
+    renderStats.bytesUploaded += (unsigned int)(sizeof(BatchVertex) * vertices.size());
+}
+
+void TileLayer::draw(){
+    uploadDirtyChunks();
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, TextureManager::getArrayID(texturePage));
+
+    glBindVertexArray(vao);
+    if (!frustum.isEnabled()){
+        glDrawElements(GL_TRIANGLES, width * height * 6, GL_UNSIGNED_INT, nullptr);
+        renderStats.drawCalls++;
+        return;
+    }
+
+    // chunks are contiguous in the index buffer, so neighbouring visible chunks form one range
+    drawCounts.clear();
+    drawOffsets.clear();
+    unsigned int runBegin = 0, runEnd = 0;
+    for (unsigned int i = 0; i < chunks.size(); i++){
+        const Chunk& chunk = chunks[i];
+        glm::vec3 min = glm::vec3((i % chunksX) * CHUNK_SIZE, 0.0f, (i / chunksX) * CHUNK_SIZE) * tileSize;
+        glm::vec3 max = min + glm::vec3(chunk.width, 0.0f, chunk.height) * tileSize;
+        if (!frustum.isBoxVisible(min, max)){
+            renderStats.chunksCulled++;
+            continue;
+        }
+        unsigned int first = chunk.firstTile * 6;
+        unsigned int count = chunk.width * chunk.height * 6;
+        if (runEnd != first && runEnd != runBegin){
+            drawCounts.push_back(runEnd - runBegin);
+            drawOffsets.push_back((const void*)(sizeof(unsigned int) * runBegin));
+            runBegin = first;
+        } else if (runEnd == runBegin){
+            runBegin = first;
+        }
+        runEnd = first + count;
+    }
+    if (runEnd != runBegin){
+        drawCounts.push_back(runEnd - runBegin);
+        drawOffsets.push_back((const void*)(sizeof(unsigned int) * runBegin));
+    }
+    if (drawCounts.empty())
+        return;
+
+    glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(), (GLsizei)drawCounts.size());
+    renderStats.drawCalls++;
+}
+
+void TileLayer::setFrustum(const Frustum& frustum){
+    this->frustum = frustum;
+}
+
+// tiles drawn white are part of the layer's contents, not of a frame
+void TileLayer::resetStats(){
+    unsigned int otherPageTiles = renderStats.otherPageTiles;
+    renderStats = Stats{};
+    renderStats.otherPageTiles = otherPageTiles;
+}
+
+unsigned int TileLayer::chunkIndex(unsigned int x, unsigned int y) const{
+    return (y / CHUNK_SIZE) * chunksX + x / CHUNK_SIZE;
+}
+
+BatchVertex* TileLayer::tileVertices(unsigned int x, unsigned int y, Chunk** chunk){
+    Chunk& c = chunks[chunkIndex(x, y)];
+    unsigned int local = (y % CHUNK_SIZE) * c.width + x % CHUNK_SIZE;
+
+    if (c.dirtyBegin >= c.dirtyEnd){
+        dirtyChunks.push_back(chunkIndex(x, y));
+        c.dirtyBegin = local;
+        c.dirtyEnd = local + 1;
+    } else {
+        c.dirtyBegin = std::min(c.dirtyBegin, local);
+        c.dirtyEnd = std::max(c.dirtyEnd, local + 1);
+    }
+
+    *chunk = &c;
+    return &vertices[(c.firstTile + local) * 4];
+}
+
+void TileLayer::writeTile(unsigned int x, unsigned int y, uint32_t color, uint16_t textureIndex, const uint32_t* texCoords){
+    if (x >= width || y >= height)
+        return;
+
+    Chunk* chunk;
+    BatchVertex* v = tileVertices(x, y, &chunk);
+    writeTileVertices(v, glm::vec2(x, y) * tileSize, tileSize, color, textureIndex, texCoords ? texCoords : FULL_TEXTURE);
+}
+
+// rows of chunks are disjoint runs of the vertex array, so each thread takes a few rows
+void TileLayer::buildChunks(const std::function<glm::vec4(unsigned int x, unsigned int y)>& colorAt){
+    ThreadPool::parallelFor(chunksY, 1, [&](unsigned int, size_t begin, size_t end){
+        for (unsigned int cy = (unsigned int)begin; cy < end; cy++){
+            for (unsigned int cx = 0; cx < chunksX; cx++){
+                const Chunk& chunk = chunks[cy * chunksX + cx];
+                BatchVertex* v = &vertices[chunk.firstTile * 4];
+                for (unsigned int ly = 0; ly < chunk.height; ly++){
+                    for (unsigned int lx = 0; lx < chunk.width; lx++, v += 4){
+                        unsigned int x = cx * CHUNK_SIZE + lx;
+                        unsigned int y = cy * CHUNK_SIZE + ly;
+                        writeTileVertices(v, glm::vec2(x, y) * tileSize, tileSize, packColor(colorAt(x, y)), 0);
+                    }
+                }
+            }
+        }
+    });
+
+    for (Chunk& chunk : chunks)
+        chunk.dirtyBegin = chunk.dirtyEnd = 0;
+    dirtyChunks.clear();
+}
+
+void TileLayer::uploadDirtyChunks(){
+    if (dirtyChunks.empty())
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    for (unsigned int index : dirtyChunks){
+        Chunk& chunk = chunks[index];
+        unsigned int first = chunk.firstTile + chunk.dirtyBegin;
+        unsigned int count = chunk.dirtyEnd - chunk.dirtyBegin;
+        GLsizeiptr size = sizeof(BatchVertex) * 4 * count;
+
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(BatchVertex) * 4 * first, size, &vertices[first * 4]);
+        chunk.dirtyBegin = chunk.dirtyEnd = 0;
+
+        renderStats.chunksUpdated++;
+        renderStats.tilesUploaded += count;
+        renderStats.bytesUploaded += size;
+    }
+    dirtyChunks.clear();
+}
@@ -0,0 +1,614 @@
+#include "graphics/vertexKernels.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEX_KERNELS_SSE2
+#define VERTEX_KERNELS_SIMD
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define VERTEX_KERNELS_NEON
+#define VERTEX_KERNELS_SIMD
+#include <arm_neon.h>
+#endif
+
+static_assert(sizeof(BatchVertex) == 24, "kernels write BatchVertex as six dwords");
+static_assert(offsetof(BatchVertex, texIndex) == 20, "texIndex and normalIndex are written as one dword");
+
+static const uint32_t UV_00 = packTexCoord(0.0f, 0.0f);
+static const uint32_t UV_10 = packTexCoord(1.0f, 0.0f);
+static const uint32_t UV_11 = packTexCoord(1.0f, 1.0f);
+static const uint32_t UV_01 = packTexCoord(0.0f, 1.0f);
+
+// texIndex, normalIndex and padding share the last dword of a vertex
+static uint32_t packTexNormal(uint16_t textureIndex, uint8_t normalIndex){
+    return (uint32_t)textureIndex | ((uint32_t)normalIndex << 16);
+}
+
+// faces of the unit cube in the order drawCube emits them, corners in uv order 00, 10, 11, 01
+template<int Face> struct CubeFace;
+
+template<> struct CubeFace<0>{ // front
+    static constexpr uint8_t normal = NORMAL_POS_Z;
+    static constexpr float corners[4][3] = {{0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}};
+};
+template<> struct CubeFace<1>{ // right
+    static constexpr uint8_t normal = NORMAL_POS_X;
+    static constexpr float corners[4][3] = {{1, 0, 1}, {1, 0, 0}, {1, 1, 0}, {1, 1, 1}};
+};
+template<> struct CubeFace<2>{ // left
+    static constexpr uint8_t normal = NORMAL_NEG_X;
+    static constexpr float corners[4][3] = {{0, 0, 0}, {0, 0, 1}, {0, 1, 1}, {0, 1, 0}};
+};
+template<> struct CubeFace<3>{ // top
+    static constexpr uint8_t normal = NORMAL_POS_Y;
+    static constexpr float corners[4][3] = {{0, 1, 1}, {1, 1, 1}, {1, 1, 0}, {0, 1, 0}};
+};
+template<> struct CubeFace<4>{ // bottom
+    static constexpr uint8_t normal = NORMAL_NEG_Y;
+    static constexpr float corners[4][3] = {{1, 0, 1}, {0, 0, 1}, {0, 0, 0}, {1, 0, 0}};
+};
+template<> struct CubeFace<5>{ // back
+    static constexpr uint8_t normal = NORMAL_NEG_Z;
+    static constexpr float corners[4][3] = {{1, 0, 0}, {0, 0, 0}, {0, 1, 0}, {1, 1, 0}};
+};
+
+// corner k of a tile is (x[k], z[k]) in the order drawTile emits them
+struct TileCorners{
+    float x[4];
+    float z[4];
+};
+
+// same corners as BatchRenderer2D::drawTile, with sin and cos taken once per tile
+static TileCorners tileCorners(const TileArrays& tiles, size_t i){
+    float x = tiles.x[i], y = tiles.y[i];
+    float w = tiles.width[i], h = tiles.height[i];
+    TileCorners c;
+    if (!tiles.rotations){
+        c.x[0] = x;     c.z[0] = y + h;
+        c.x[1] = x + w; c.z[1] = y + h;
+        c.x[2] = x + w; c.z[2] = y;
+        c.x[3] = x;     c.z[3] = y;
+        return c;
+    }
+    float cosR = std::cos(tiles.rotations[i]);
+    float sinR = std::sin(tiles.rotations[i]);
+    float hw = w * 0.5f, hh = h * 0.5f;
+    float tx = x + hw, ty = y + hh;
+    float a = cosR * hw, b = sinR * hh, d = sinR * hw, e = cosR * hh;
+    c.x[0] = tx - a - b; c.z[0] = ty - d + e;
+    c.x[1] = tx + a - b; c.z[1] = ty + d + e;
+    c.x[2] = tx + a + b; c.z[2] = ty + d - e;
+    c.x[3] = tx - a + b; c.z[3] = ty - d - e;
+    return c;
+}
+
+static void expandTileScalar(BatchVertex* v, const TileArrays& tiles, size_t i){
+    const uint32_t texCoords[4] = {UV_00, UV_10, UV_11, UV_01};
+    uint32_t color = tiles.colors ? tiles.colors[i] : 0xffffffff;
+    uint16_t textureIndex = tiles.textureLayers ? tiles.textureLayers[i] : 0;
+    TileCorners c = tileCorners(tiles, i);
+    for (int k = 0; k < 4; k++){
+        v[k].position = {c.x[k], 0.0f, c.z[k]};
+        v[k].color = color;
+        v[k].texCoord = texCoords[k];
+        v[k].texIndex = textureIndex;
+        v[k].normalIndex = NORMAL_POS_Y;
+        v[k].padding = 0;
+    }
+}
+
+#ifdef VERTEX_KERNELS_SSE2
+
+static inline __m128 laneMask(bool l0, bool l1, bool l2, bool l3){
+    return _mm_castsi128_ps(_mm_setr_epi32(l0 ? -1 : 0, l1 ? -1 : 0, l2 ? -1 : 0, l3 ? -1 : 0));
+}
+
+// four tiles per call. the corners are computed lane-per-tile, transposed so each
+// tile holds (x0, z0, x1, z1) and (x2, z2, x3, z3), then spread over the 96 bytes
+// of its four vertices with shuffles and masks
+template<bool Rotated>
+static void expandFourTiles(BatchVertex* out, const TileArrays& tiles, size_t i){
+    __m128 x = _mm_loadu_ps(tiles.x + i);
+    __m128 y = _mm_loadu_ps(tiles.y + i);
+    __m128 w = _mm_loadu_ps(tiles.width + i);
+    __m128 h = _mm_loadu_ps(tiles.height + i);
+
+    __m128 x0, z0, x1, z1, x2, z2, x3, z3;
+    if (Rotated){
+        float cosR[4], sinR[4];
+        for (int t = 0; t < 4; t++){
+            cosR[t] = std::cos(tiles.rotations[i + t]);
+            sinR[t] = std::sin(tiles.rotations[i + t]);
+        }
+        __m128 c = _mm_loadu_ps(cosR);
+        __m128 s = _mm_loadu_ps(sinR);
+        __m128 half = _mm_set1_ps(0.5f);
+        __m128 hw = _mm_mul_ps(w, half);
+        __m128 hh = _mm_mul_ps(h, half);
+        __m128 tx = _mm_add_ps(x, hw);
+        __m128 ty = _mm_add_ps(y, hh);
+        __m128 a = _mm_mul_ps(c, hw), b = _mm_mul_ps(s, hh);
+        __m128 d = _mm_mul_ps(s, hw), e = _mm_mul_ps(c, hh);
+        __m128 aPlusB = _mm_add_ps(a, b), aMinusB = _mm_sub_ps(a, b);
+        __m128 dPlusE = _mm_add_ps(d, e), dMinusE = _mm_sub_ps(d, e);
+        x0 = _mm_sub_ps(tx, aPlusB);  z0 = _mm_sub_ps(ty, dMinusE);
+        x1 = _mm_add_ps(tx, aMinusB); z1 = _mm_add_ps(ty, dPlusE);
+        x2 = _mm_add_ps(tx, aPlusB);  z2 = _mm_add_ps(ty, dMinusE);
+        x3 = _mm_sub_ps(tx, aMinusB); z3 = _mm_sub_ps(ty, dPlusE);
+    } else {
+        __m128 right = _mm_add_ps(x, w);
+        __m128 bottom = _mm_add_ps(y, h);
+        x0 = x;     z0 = bottom;
+        x1 = right; z1 = bottom;
+        x2 = right; z2 = y;
+        x3 = x;     z3 = y;
+    }
+    _MM_TRANSPOSE4_PS(x0, z0, x1, z1);
+    _MM_TRANSPOSE4_PS(x2, z2, x3, z3);
+    __m128 first[4] = {x0, z0, x1, z1};
+    __m128 second[4] = {x2, z2, x3, z3};
+
+    const __m128 mask02 = laneMask(true, false, true, false);
+    const __m128 mask0 = laneMask(true, false, false, false);
+    const __m128 mask2 = laneMask(false, false, true, false);
+    const __m128 uv00 = _mm_castsi128_ps(_mm_setr_epi32(UV_00, 0, 0, 0));
+    const __m128 uv10 = _mm_castsi128_ps(_mm_setr_epi32(0, 0, UV_10, 0));
+    const __m128 uv11 = _mm_castsi128_ps(_mm_setr_epi32(UV_11, 0, 0, 0));
+    const __m128 uv01 = _mm_castsi128_ps(_mm_setr_epi32(0, 0, UV_01, 0));
+
+    for (int t = 0; t < 4; t++){
+        uint32_t color = tiles.colors ? tiles.colors[i + t] : 0xffffffff;
+        uint32_t texNormal = packTexNormal(tiles.textureLayers ? tiles.textureLayers[i + t] : 0, NORMAL_POS_Y);
+        __m128 color3 = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, (int)color));
+        __m128 texNormal1 = _mm_castsi128_ps(_mm_setr_epi32(0, (int)texNormal, 0, 0));
+        __m128 colorTexNormal = _mm_castsi128_ps(_mm_setr_epi32(0, (int)color, 0, (int)texNormal));
+        __m128 a = first[t], b = second[t];
+
+        // vertices as dwords: x0 0 z0 c | uv tn x1 0 | z1 c uv tn | x2 0 z2 c | uv tn x3 0 | z3 c uv tn
+        __m128 q0 = _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 1, 0, 0)), mask02), color3);
+        __m128 q1 = _mm_or_ps(_mm_or_ps(uv00, texNormal1), _mm_and_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 2, 0, 0)), mask2));
+        __m128 q2 = _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 3)), mask0), _mm_or_ps(uv10, colorTexNormal));
+        __m128 q3 = _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 1, 0, 0)), mask02), color3);
+        __m128 q4 = _mm_or_ps(_mm_or_ps(uv11, texNormal1), _mm_and_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 2, 0, 0)), mask2));
+        __m128 q5 = _mm_or_ps(_mm_and_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 0, 0, 3)), mask0), _mm_or_ps(uv01, colorTexNormal));
+
+        float* dst = (float*)(out + t * 4);
+        _mm_storeu_ps(dst + 0, q0);
+        _mm_storeu_ps(dst + 4, q1);
+        _mm_storeu_ps(dst + 8, q2);
+        _mm_storeu_ps(dst + 12, q3);
+        _mm_storeu_ps(dst + 16, q4);
+        _mm_storeu_ps(dst + 20, q5);
+    }
+}
+
+template<int Face>
+static inline void writeFace(BatchVertex* v, __m128 position, __m128 size, __m128 color3, uint16_t textureIndex){
+    const uint32_t texCoords[4] = {UV_00, UV_10, UV_11, UV_01};
+    uint64_t texNormal = (uint64_t)packTexNormal(textureIndex, CubeFace<Face>::normal) << 32;
+    for (int k = 0; k < 4; k++){
+        const float* corner = CubeFace<Face>::corners[k];
+        __m128 p = _mm_add_ps(position, _mm_mul_ps(_mm_setr_ps(corner[0], corner[1], corner[2], 0.0f), size));
+        _mm_storeu_ps((float*)(v + Face * 4 + k), _mm_or_ps(p, color3));
+        uint64_t tail = texCoords[k] | texNormal;
+        memcpy((uint8_t*)(v + Face * 4 + k) + 16, &tail, sizeof(tail));
+    }
+}
+
+static inline void expandCubeSimd(BatchVertex* v, float x, float y, float z, float w, float h, float d, uint32_t color, uint16_t textureIndex){
+    // lane 3 is zero in both, so the position lane 3 is +0.0f and the color can be or'ed in
+    __m128 position = _mm_setr_ps(x, y, z, 0.0f);
+    __m128 size = _mm_setr_ps(w, h, d, 0.0f);
+    __m128 color3 = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, (int)color));
+    writeFace<0>(v, position, size, color3, textureIndex);
+    writeFace<1>(v, position, size, color3, textureIndex);
+    writeFace<2>(v, position, size, color3, textureIndex);
+    writeFace<3>(v, position, size, color3, textureIndex);
+    writeFace<4>(v, position, size, color3, textureIndex);
+    writeFace<5>(v, position, size, color3, textureIndex);
+}
+
+// the frustum's planes splatted across the lanes, so four boxes are tested at once.
+// the sums are ordered like Frustum::isBoxVisible, a box gets the same answer from both
+struct FrustumLanes{
+    __m128 nx[6], ny[6], nz[6], nw[6];
+    __m128 ax[6], ay[6], az[6];
+
+    explicit FrustumLanes(const Frustum& frustum){
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        for (int i = 0; i < 6; i++){
+            const glm::vec4& plane = frustum.getPlane(i);
+            nx[i] = _mm_set1_ps(plane.x);
+            ny[i] = _mm_set1_ps(plane.y);
+            nz[i] = _mm_set1_ps(plane.z);
+            nw[i] = _mm_set1_ps(plane.w);
+            ax[i] = _mm_and_ps(nx[i], absMask);
+            ay[i] = _mm_and_ps(ny[i], absMask);
+            az[i] = _mm_and_ps(nz[i], absMask);
+        }
+    }
+
+    // one bit per box inside the frustum, from the boxes' min and max corners
+    int visible(__m128 minX, __m128 minY, __m128 minZ, __m128 maxX, __m128 maxY, __m128 maxZ) const{
+        const __m128 half = _mm_set1_ps(0.5f);
+        __m128 cx = _mm_mul_ps(_mm_add_ps(minX, maxX), half), ex = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+        __m128 cy = _mm_mul_ps(_mm_add_ps(minY, maxY), half), ey = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+        __m128 cz = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half), ez = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+        __m128 outside = _mm_setzero_ps();
+        for (int i = 0; i < 6; i++){
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[i], cx), _mm_mul_ps(ny[i], cy)),
+                                         _mm_add_ps(_mm_mul_ps(nz[i], cz), nw[i]));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[i], ex), _mm_mul_ps(ay[i], ey)), _mm_mul_ps(az[i], ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+        return ~_mm_movemask_ps(outside) & 0xf;
+    }
+
+    // tiles i to i + 3 straight from the arrays, bounds built like tileBounds
+    int visibleTiles(const TileArrays& tiles, size_t i) const{
+        const __m128 zero = _mm_setzero_ps(), half = _mm_set1_ps(0.5f);
+        __m128 x = _mm_loadu_ps(tiles.x + i), y = _mm_loadu_ps(tiles.y + i);
+        __m128 width = _mm_loadu_ps(tiles.width + i), height = _mm_loadu_ps(tiles.height + i);
+        __m128 minX = x, minZ = y;
+        __m128 maxX = _mm_add_ps(x, width), maxZ = _mm_add_ps(y, height);
+        if (tiles.rotations){
+            __m128 radius = _mm_mul_ps(half, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(width, width), _mm_mul_ps(height, height))));
+            __m128 centerX = _mm_add_ps(x, _mm_mul_ps(width, half));
+            __m128 centerZ = _mm_add_ps(y, _mm_mul_ps(height, half));
+            minX = _mm_sub_ps(centerX, radius);
+            maxX = _mm_add_ps(centerX, radius);
+            minZ = _mm_sub_ps(centerZ, radius);
+            maxZ = _mm_add_ps(centerZ, radius);
+        }
+        return visible(minX, zero, minZ, maxX, zero, maxZ);
+    }
+
+    int visibleCubes(const CubeArrays& cubes, size_t i) const{
+        __m128 minX = _mm_loadu_ps(cubes.x + i), minY = _mm_loadu_ps(cubes.y + i), minZ = _mm_loadu_ps(cubes.z + i);
+        __m128 maxX = _mm_add_ps(minX, _mm_loadu_ps(cubes.width + i));
+        __m128 maxY = _mm_add_ps(minY, _mm_loadu_ps(cubes.height + i));
+        __m128 maxZ = _mm_add_ps(minZ, _mm_loadu_ps(cubes.depth + i));
+        return visible(minX, minY, minZ, maxX, maxY, maxZ);
+    }
+};
+
+#elif defined(VERTEX_KERNELS_NEON)
+
+// arm64 gets the same kernels as the sse2 path, op for op, so --bench-kernels still
+// checks them against the scalar code
+
+static inline void transpose(float32x4_t& r0, float32x4_t& r1, float32x4_t& r2, float32x4_t& r3){
+    float32x4_t t0 = vzip1q_f32(r0, r2), t1 = vzip2q_f32(r0, r2);
+    float32x4_t t2 = vzip1q_f32(r1, r3), t3 = vzip2q_f32(r1, r3);
+    r0 = vzip1q_f32(t0, t2);
+    r1 = vzip2q_f32(t0, t2);
+    r2 = vzip1q_f32(t1, t3);
+    r3 = vzip2q_f32(t1, t3);
+}
+
+// two vertices from (xa, za, xb, zb) as dwords: xa 0 za c | uv tn xb 0 | zb c uv tn
+static inline void writeTwoVertices(uint32_t* dst, float32x4_t corners, uint32_t color, uint64_t firstTail, uint64_t secondTail){
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    uint32x4_t a = vreinterpretq_u32_f32(vzip1q_f32(corners, zero));
+    uint32x4_t b = vreinterpretq_u32_f32(vzip2q_f32(corners, zero));
+    vst1q_u32(dst + 0, vsetq_lane_u32(color, a, 3));
+    vst1q_u32(dst + 4, vcombine_u32(vcreate_u32(firstTail), vget_low_u32(b)));
+    vst1q_u32(dst + 8, vcombine_u32(vset_lane_u32(color, vget_high_u32(b), 1), vcreate_u32(secondTail)));
+}
+
+template<bool Rotated>
+static void expandFourTiles(BatchVertex* out, const TileArrays& tiles, size_t i){
+    float32x4_t x = vld1q_f32(tiles.x + i);
+    float32x4_t y = vld1q_f32(tiles.y + i);
+    float32x4_t w = vld1q_f32(tiles.width + i);
+    float32x4_t h = vld1q_f32(tiles.height + i);
+
+    float32x4_t x0, z0, x1, z1, x2, z2, x3, z3;
+    if (Rotated){
+        float cosR[4], sinR[4];
+        for (int t = 0; t < 4; t++){
+            cosR[t] = std::cos(tiles.rotations[i + t]);
+            sinR[t] = std::sin(tiles.rotations[i + t]);
+        }
+        float32x4_t c = vld1q_f32(cosR);
+        float32x4_t s = vld1q_f32(sinR);
+        float32x4_t half = vdupq_n_f32(0.5f);
+        float32x4_t hw = vmulq_f32(w, half);
+        float32x4_t hh = vmulq_f32(h, half);
+        float32x4_t tx = vaddq_f32(x, hw);
+        float32x4_t ty = vaddq_f32(y, hh);
+        float32x4_t a = vmulq_f32(c, hw), b = vmulq_f32(s, hh);
+        float32x4_t d = vmulq_f32(s, hw), e = vmulq_f32(c, hh);
+        float32x4_t aPlusB = vaddq_f32(a, b), aMinusB = vsubq_f32(a, b);
+        float32x4_t dPlusE = vaddq_f32(d, e), dMinusE = vsubq_f32(d, e);
+        x0 = vsubq_f32(tx, aPlusB);  z0 = vsubq_f32(ty, dMinusE);
+        x1 = vaddq_f32(tx, aMinusB); z1 = vaddq_f32(ty, dPlusE);
+        x2 = vaddq_f32(tx, aPlusB);  z2 = vaddq_f32(ty, dMinusE);
+        x3 = vsubq_f32(tx, aMinusB); z3 = vsubq_f32(ty, dPlusE);
+    } else {
+        float32x4_t right = vaddq_f32(x, w);
+        float32x4_t bottom = vaddq_f32(y, h);
+        x0 = x;     z0 = bottom;
+        x1 = right; z1 = bottom;
+        x2 = right; z2 = y;
+        x3 = x;     z3 = y;
+    }
+    transpose(x0, z0, x1, z1);
+    transpose(x2, z2, x3, z3);
+    float32x4_t first[4] = {x0, z0, x1, z1};
+    float32x4_t second[4] = {x2, z2, x3, z3};
+
+    for (int t = 0; t < 4; t++){
+        uint32_t color = tiles.colors ? tiles.colors[i + t] : 0xffffffff;
+        uint64_t texNormal = (uint64_t)packTexNormal(tiles.textureLayers ? tiles.textureLayers[i + t] : 0, NORMAL_POS_Y) << 32;
+        uint32_t* dst = (uint32_t*)(out + t * 4);
+        writeTwoVertices(dst, first[t], color, UV_00 | texNormal, UV_10 | texNormal);
+        writeTwoVertices(dst + 12, second[t], color, UV_11 | texNormal, UV_01 | texNormal);
+    }
+}
+
+template<int Face>
+static inline void writeFace(BatchVertex* v, float32x4_t position, float32x4_t size, uint32_t color, uint16_t textureIndex){
+    const uint32_t texCoords[4] = {UV_00, UV_10, UV_11, UV_01};
+    uint64_t texNormal = (uint64_t)packTexNormal(textureIndex, CubeFace<Face>::normal) << 32;
+    for (int k = 0; k < 4; k++){
+        const float* corner = CubeFace<Face>::corners[k];
+        const float lanes[4] = {corner[0], corner[1], corner[2], 0.0f};
+        float32x4_t p = vaddq_f32(position, vmulq_f32(vld1q_f32(lanes), size));
+        vst1q_u32((uint32_t*)(v + Face * 4 + k), vsetq_lane_u32(color, vreinterpretq_u32_f32(p), 3));
+        uint64_t tail = texCoords[k] | texNormal;
+        memcpy((uint8_t*)(v + Face * 4 + k) + 16, &tail, sizeof(tail));
+    }
+}
+
+static inline void expandCubeSimd(BatchVertex* v, float x, float y, float z, float w, float h, float d, uint32_t color, uint16_t textureIndex){
+    const float positionLanes[4] = {x, y, z, 0.0f}, sizeLanes[4] = {w, h, d, 0.0f};
+    float32x4_t position = vld1q_f32(positionLanes);
+    float32x4_t size = vld1q_f32(sizeLanes);
+    writeFace<0>(v, position, size, color, textureIndex);
+    writeFace<1>(v, position, size, color, textureIndex);
+    writeFace<2>(v, position, size, color, textureIndex);
+    writeFace<3>(v, position, size, color, textureIndex);
+    writeFace<4>(v, position, size, color, textureIndex);
+    writeFace<5>(v, position, size, color, textureIndex);
+}
+
+struct FrustumLanes{
+    float32x4_t nx[6], ny[6], nz[6], nw[6];
+    float32x4_t ax[6], ay[6], az[6];
+
+    explicit FrustumLanes(const Frustum& frustum){
+        for (int i = 0; i < 6; i++){
+            const glm::vec4& plane = frustum.getPlane(i);
+            nx[i] = vdupq_n_f32(plane.x);
+            ny[i] = vdupq_n_f32(plane.y);
+            nz[i] = vdupq_n_f32(plane.z);
+            nw[i] = vdupq_n_f32(plane.w);
+            ax[i] = vabsq_f32(nx[i]);
+            ay[i] = vabsq_f32(ny[i]);
+            az[i] = vabsq_f32(nz[i]);
+        }
+    }
+
+    int visible(float32x4_t minX, float32x4_t minY, float32x4_t minZ, float32x4_t maxX, float32x4_t maxY, float32x4_t maxZ) const{
+        const float32x4_t half = vdupq_n_f32(0.5f), zero = vdupq_n_f32(0.0f);
+        const uint32_t laneBits[4] = {1, 2, 4, 8};
+        float32x4_t cx = vmulq_f32(vaddq_f32(minX, maxX), half), ex = vmulq_f32(vsubq_f32(maxX, minX), half);
+        float32x4_t cy = vmulq_f32(vaddq_f32(minY, maxY), half), ey = vmulq_f32(vsubq_f32(maxY, minY), half);
+        float32x4_t cz = vmulq_f32(vaddq_f32(minZ, maxZ), half), ez = vmulq_f32(vsubq_f32(maxZ, minZ), half);
+        uint32x4_t outside = vdupq_n_u32(0);
+        for (int i = 0; i < 6; i++){
+            float32x4_t distance = vaddq_f32(vaddq_f32(vmulq_f32(nx[i], cx), vmulq_f32(ny[i], cy)),
+                                             vaddq_f32(vmulq_f32(nz[i], cz), nw[i]));
+            float32x4_t radius = vaddq_f32(vaddq_f32(vmulq_f32(ax[i], ex), vmulq_f32(ay[i], ey)), vmulq_f32(az[i], ez));
+            outside = vorrq_u32(outside, vcltq_f32(vaddq_f32(distance, radius), zero));
+        }
+        return ~(int)vaddvq_u32(vandq_u32(outside, vld1q_u32(laneBits))) & 0xf;
+    }
+
+    int visibleTiles(const TileArrays& tiles, size_t i) const{
+        const float32x4_t zero = vdupq_n_f32(0.0f), half = vdupq_n_f32(0.5f);
+        float32x4_t x = vld1q_f32(tiles.x + i), y = vld1q_f32(tiles.y + i);
+        float32x4_t width = vld1q_f32(tiles.width + i), height = vld1q_f32(tiles.height + i);
+        float32x4_t minX = x, minZ = y;
+        float32x4_t maxX = vaddq_f32(x, width), maxZ = vaddq_f32(y, height);
+        if (tiles.rotations){
+            float32x4_t radius = vmulq_f32(half, vsqrtq_f32(vaddq_f32(vmulq_f32(width, width), vmulq_f32(height, height))));
+            float32x4_t centerX = vaddq_f32(x, vmulq_f32(width, half));
+            float32x4_t centerZ = vaddq_f32(y, vmulq_f32(height, half));
+            minX = vsubq_f32(centerX, radius);
+            maxX = vaddq_f32(centerX, radius);
+            minZ = vsubq_f32(centerZ, radius);
+            maxZ = vaddq_f32(centerZ, radius);
+        }
+        return visible(minX, zero, minZ, maxX, zero, maxZ);
+    }
+
+    int visibleCubes(const CubeArrays& cubes, size_t i) const{
+        float32x4_t minX = vld1q_f32(cubes.x + i), minY = vld1q_f32(cubes.y + i), minZ = vld1q_f32(cubes.z + i);
+        float32x4_t maxX = vaddq_f32(minX, vld1q_f32(cubes.width + i));
+        float32x4_t maxY = vaddq_f32(minY, vld1q_f32(cubes.height + i));
+        float32x4_t maxZ = vaddq_f32(minZ, vld1q_f32(cubes.depth + i));
+        return visible(minX, minY, minZ, maxX, maxY, maxZ);
+    }
+};
+
+#endif
+
+template<int Face>
+static inline void writeFaceScalar(BatchVertex* v, const glm::vec3& position, const glm::vec3& size, uint32_t color, uint16_t textureIndex){
+    const uint32_t texCoords[4] = {UV_00, UV_10, UV_11, UV_01};
+    for (int k = 0; k < 4; k++){
+        const float* corner = CubeFace<Face>::corners[k];
+        BatchVertex& vertex = v[Face * 4 + k];
+        vertex.position = position + glm::vec3(corner[0], corner[1], corner[2]) * size;
+        vertex.color = color;
+        vertex.texCoord = texCoords[k];
+        vertex.texIndex = textureIndex;
+        vertex.normalIndex = CubeFace<Face>::normal;
+        vertex.padding = 0;
+    }
+}
+
+void expandTiles(BatchVertex* out, const TileArrays& tiles, size_t first, size_t count){
+    size_t i = first;
+    size_t end = first + count;
+#ifdef VERTEX_KERNELS_SIMD
+    for (; i + 4 <= end; i += 4, out += 16){
+        if (tiles.rotations)
+            expandFourTiles<true>(out, tiles, i);
+        else
+            expandFourTiles<false>(out, tiles, i);
+    }
+#endif
+    for (; i < end; i++, out += 4)
+        expandTileScalar(out, tiles, i);
+}
+
+void expandCube(BatchVertex* out, const glm::vec3& position, const glm::vec3& size, uint32_t color, uint16_t textureIndex){
+#ifdef VERTEX_KERNELS_SIMD
+    expandCubeSimd(out, position.x, position.y, position.z, size.x, size.y, size.z, color, textureIndex);
+#else
+    expandCubeScalar(out, position, size, color, textureIndex);
+#endif
+}
+
+void expandCubeScalar(BatchVertex* out, const glm::vec3& position, const glm::vec3& size, uint32_t color, uint16_t textureIndex){
+    writeFaceScalar<0>(out, position, size, color, textureIndex);
+    writeFaceScalar<1>(out, position, size, color, textureIndex);
+    writeFaceScalar<2>(out, position, size, color, textureIndex);
+    writeFaceScalar<3>(out, position, size, color, textureIndex);
+    writeFaceScalar<4>(out, position, size, color, textureIndex);
+    writeFaceScalar<5>(out, position, size, color, textureIndex);
+}
+
+void expandCubes(BatchVertex* out, const CubeArrays& cubes, size_t first, size_t count){
+    for (size_t i = first; i < first + count; i++, out += 24){
+        uint32_t color = cubes.colors ? cubes.colors[i] : 0xffffffff;
+        uint16_t textureIndex = cubes.textureLayers ? cubes.textureLayers[i] : 0;
+#ifdef VERTEX_KERNELS_SIMD
+        expandCubeSimd(out, cubes.x[i], cubes.y[i], cubes.z[i], cubes.width[i], cubes.height[i], cubes.depth[i], color, textureIndex);
+#else
+        expandCube(out, glm::vec3(cubes.x[i], cubes.y[i], cubes.z[i]), glm::vec3(cubes.width[i], cubes.height[i], cubes.depth[i]), color, textureIndex);
+#endif
+    }
+}
+
+void tileBounds(float x, float y, float width, float height, bool rotated, glm::vec3& min, glm::vec3& max){
+    if (!rotated){
+        min = glm::vec3(x, 0.0f, y);
+        max = glm::vec3(x + width, 0.0f, y + height);
+        return;
+    }
+    float radius = 0.5f * std::sqrt(width * width + height * height);
+    glm::vec3 center = glm::vec3(x + width * 0.5f, 0.0f, y + height * 0.5f);
+    min = center - glm::vec3(radius, 0.0f, radius);
+    max = center + glm::vec3(radius, 0.0f, radius);
+}
+
+template<typename T>
+static void keep(std::vector<T>& out, const T* in, size_t i){
+    if (in)
+        out.push_back(in[i]);
+}
+
+template<typename T>
+static const T* dataOrNull(const std::vector<T>& values, const T* source){
+    return source ? values.data() : nullptr;
+}
+
+static void keepTile(TileScratch& scratch, const TileArrays& tiles, size_t i){
+    scratch.x.push_back(tiles.x[i]);
+    scratch.y.push_back(tiles.y[i]);
+    scratch.width.push_back(tiles.width[i]);
+    scratch.height.push_back(tiles.height[i]);
+    keep(scratch.rotations, tiles.rotations, i);
+    keep(scratch.colors, tiles.colors, i);
+    keep(scratch.textureLayers, tiles.textureLayers, i);
+}
+
+static void keepCube(CubeScratch& scratch, const CubeArrays& cubes, size_t i){
+    scratch.x.push_back(cubes.x[i]);
+    scratch.y.push_back(cubes.y[i]);
+    scratch.z.push_back(cubes.z[i]);
+    scratch.width.push_back(cubes.width[i]);
+    scratch.height.push_back(cubes.height[i]);
+    scratch.depth.push_back(cubes.depth[i]);
+    keep(scratch.colors, cubes.colors, i);
+    keep(scratch.textureLayers, cubes.textureLayers, i);
+}
+
+
+TileArrays cullTiles(const TileArrays& tiles, const Frustum& frustum, TileScratch& scratch){
+    scratch.x.clear(); scratch.y.clear(); scratch.width.clear(); scratch.height.clear();
+    scratch.rotations.clear(); scratch.colors.clear(); scratch.textureLayers.clear();
+
+    size_t i = 0;
+#ifdef VERTEX_KERNELS_SIMD
+    if (frustum.isEnabled()){
+        FrustumLanes lanes(frustum);
+        for (; i + 4 <= tiles.count; i += 4){
+            int mask = lanes.visibleTiles(tiles, i);
+            for (int lane = 0; lane < 4; lane++)
+                if (mask & (1 << lane))
+                    keepTile(scratch, tiles, i + lane);
+        }
+    }
+#endif
+    for (; i < tiles.count; i++){
+        glm::vec3 min, max;
+        tileBounds(tiles.x[i], tiles.y[i], tiles.width[i], tiles.height[i], tiles.rotations != nullptr, min, max);
+        if (frustum.isBoxVisible(min, max))
+            keepTile(scratch, tiles, i);
+    }
+
+    TileArrays visible = tiles;
+    visible.count = scratch.x.size();
+    visible.x = scratch.x.data();
+    visible.y = scratch.y.data();
+    visible.width = scratch.width.data();
+    visible.height = scratch.height.data();
+    visible.rotations = dataOrNull(scratch.rotations, tiles.rotations);
+    visible.colors = dataOrNull(scratch.colors, tiles.colors);
+    visible.textureLayers = dataOrNull(scratch.textureLayers, tiles.textureLayers);
+    return visible;
+}
+
+CubeArrays cullCubes(const CubeArrays& cubes, const Frustum& frustum, CubeScratch& scratch){
+    scratch.x.clear(); scratch.y.clear(); scratch.z.clear();
+    scratch.width.clear(); scratch.height.clear(); scratch.depth.clear();
+    scratch.colors.clear(); scratch.textureLayers.clear();
+
+    size_t i = 0;
+#ifdef VERTEX_KERNELS_SIMD
+    if (frustum.isEnabled()){
+        FrustumLanes lanes(frustum);
+        for (; i + 4 <= cubes.count; i += 4){
+            int mask = lanes.visibleCubes(cubes, i);
+            for (int lane = 0; lane < 4; lane++)
+                if (mask & (1 << lane))
+                    keepCube(scratch, cubes, i + lane);
+        }
+    }
+#endif
+    for (; i < cubes.count; i++){
+        glm::vec3 min = glm::vec3(cubes.x[i], cubes.y[i], cubes.z[i]);
+        glm::vec3 max = min + glm::vec3(cubes.width[i], cubes.height[i], cubes.depth[i]);
+        if (frustum.isBoxVisible(min, max))
+            keepCube(scratch, cubes, i);
+    }
+
+    CubeArrays visible = cubes;
+    visible.count = scratch.x.size();
+    visible.x = scratch.x.data();
+    visible.y = scratch.y.data();
+    visible.z = scratch.z.data();
+    visible.width = scratch.width.data();
+    visible.height = scratch.height.data();
+    visible.depth = scratch.depth.data();
+    visible.colors = dataOrNull(scratch.colors, cubes.colors);
+    visible.textureLayers = dataOrNull(scratch.textureLayers, cubes.textureLayers);
+    return visible;
+}
@@ -0,0 +1,346 @@
+#include "physics/meshBvh.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include "graphics/cookedMesh.hpp"
+
+// deeper subtrees become one leaf, traversal keeps at most this many nodes on its stack
+static const unsigned int MAX_DEPTH = 64;
+
+struct Bounds{
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    void grow(const glm::vec3& point){
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    void grow(const Bounds& other){
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+    float area() const{
+        glm::vec3 size = max - min;
+        if (size.x < 0.0f || size.y < 0.0f || size.z < 0.0f)
+            return 0.0f;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+};
+
+struct BuildTriangle{
+    Bounds bounds;
+    glm::vec3 centroid;
+};
+
+struct Builder{
+    std::vector<BvhNode>& nodes;
+    const std::vector<BuildTriangle>& info;
+    std::vector<uint32_t>& order;
+
+    void makeLeaf(size_t node, size_t begin, size_t end){
+        nodes[node].offset = (uint32_t)begin;
+        nodes[node].count = (uint32_t)(end - begin);
+    }
+
+    void build(size_t begin, size_t end, unsigned int depth){
+        size_t node = nodes.size();
+        nodes.push_back(BvhNode{});
+
+        Bounds bounds, centroids;
+        for (size_t i = begin; i < end; i++){
+            bounds.grow(info[order[i]].bounds);
+            centroids.grow(info[order[i]].centroid);
+        }
+        for (int axis = 0; axis < 3; axis++){
+            nodes[node].boundsMin[axis] = bounds.min[axis];
+            nodes[node].boundsMax[axis] = bounds.max[axis];
+        }
+
+        size_t count = end - begin;
+        if (count <= 2 || depth + 1 >= MAX_DEPTH){
+            makeLeaf(node, begin, end);
+            return;
+        }
+
+        glm::vec3 extent = centroids.max - centroids.min;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        size_t middle = begin + count / 2;
+
+        if (extent[axis] > 0.0f){
+            // triangles go to bins by centroid, the best of the SAH_BINS - 1 planes between them wins
+            Bounds binBounds[MeshBvh::SAH_BINS];
+            size_t binCounts[MeshBvh::SAH_BINS] = {};
+            float scale = MeshBvh::SAH_BINS / extent[axis];
+            auto binOf = [&](uint32_t triangle){
+                int bin = (int)((info[triangle].centroid[axis] - centroids.min[axis]) * scale);
+                return std::min(std::max(bin, 0), (int)MeshBvh::SAH_BINS - 1);
+            };
+            for (size_t i = begin; i < end; i++){
+                int bin = binOf(order[i]);
+                binCounts[bin]++;
+                binBounds[bin].grow(info[order[i]].bounds);
+            }
+
+            float rightAreas[MeshBvh::SAH_BINS];
+            size_t rightCounts[MeshBvh::SAH_BINS];
+            Bounds right;
+            size_t rightCount = 0;
+            for (int bin = MeshBvh::SAH_BINS - 1; bin > 0; bin--){
+                right.grow(binBounds[bin]);
+                rightCount += binCounts[bin];
+                rightAreas[bin] = right.area();
+                rightCounts[bin] = rightCount;
+            }
+
+            // cost relative to the parent's area, a traversal step costs as much as a triangle test
+            Bounds left;
+            size_t leftCount = 0;
+            float bestCost = std::numeric_limits<float>::max();
+            int bestPlane = -1;
+            float parentArea = std::max(bounds.area(), std::numeric_limits<float>::min());
+            for (int plane = 1; plane < (int)MeshBvh::SAH_BINS; plane++){
+                left.grow(binBounds[plane - 1]);
+                leftCount += binCounts[plane - 1];
+                if (leftCount == 0 || rightCounts[plane] == 0)
+                    continue;
+                float cost = 1.0f + (left.area() * leftCount + rightAreas[plane] * rightCounts[plane]) / parentArea;
+                if (cost < bestCost){
+                    bestCost = cost;
+                    bestPlane = plane;
+                }
+            }
+
+            if (bestPlane >= 0 && bestCost >= (float)count && count <= MeshBvh::MAX_LEAF_TRIANGLES){
+                makeLeaf(node, begin, end);
+                return;
+            }
+            if (bestPlane >= 0){
+                middle = std::partition(order.begin() + begin, order.begin() + end, [&](uint32_t triangle){
+                    return binOf(triangle) < bestPlane;
+                }) - order.begin();
+            }
+        } else if (count <= MeshBvh::MAX_LEAF_TRIANGLES){
+            makeLeaf(node, begin, end);
+            return;
+        }
+
+        // no usable plane, halve by centroid instead
+        if (middle == begin || middle == end){
+            middle = begin + count / 2;
+            std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](uint32_t a, uint32_t b){
+                return info[a].centroid[axis] < info[b].centroid[axis];
+            });
+        }
+
+        build(begin, middle, depth + 1);
+        nodes[node].offset = (uint32_t)nodes.size();
+        nodes[node].count = 0;
+        build(middle, end, depth + 1);
+    }
+};
+
+void MeshBvh::build(const std::vector<float>& vertices, size_t floatsPerVertex, const int* indices, size_t indexCount){
+    clear();
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    auto position = [&](int index){
+        const float* vertex = &vertices[(size_t)index * floatsPerVertex];
+        return glm::vec3(vertex[0], vertex[1], vertex[2]);
+    };
+
+    std::vector<BuildTriangle> info(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++){
+        for (int corner = 0; corner < 3; corner++)
+            info[i].bounds.grow(position(indices[i * 3 + corner]));
+        info[i].centroid = (info[i].bounds.min + info[i].bounds.max) * 0.5f;
+    }
+
+    std::vector<uint32_t> order(triangleCount);
+    std::iota(order.begin(), order.end(), 0);
+    nodes.reserve(triangleCount * 2);
+    Builder{nodes, info, order}.build(0, triangleCount, 0);
+    nodes.shrink_to_fit();
+
+    triangles.resize(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++){
+        const int* corners = &indices[(size_t)order[i] * 3];
+        glm::vec3 a = position(corners[0]);
+        glm::vec3 edge1 = position(corners[1]) - a;
+        glm::vec3 edge2 = position(corners[2]) - a;
+        BvhTriangle& triangle = triangles[i];
+        for (int axis = 0; axis < 3; axis++){
+            triangle.vertex[axis] = a[axis];
+            triangle.edge1[axis] = edge1[axis];
+            triangle.edge2[axis] = edge2[axis];
+        }
+        triangle.index = order[i];
+    }
+}
+
+void MeshBvh::assign(const BvhNode* nodes, size_t nodeCount, const BvhTriangle* triangles, size_t triangleCount){
+    this->nodes.assign(nodes, nodes + nodeCount);
+    this->triangles.assign(triangles, triangles + triangleCount);
+}
+
+void MeshBvh::clear(){
+    nodes.clear();
+    triangles.clear();
+}
+
+// entry distance of the ray into the node's box, infinity when it misses or enters beyond maxDistance
+static inline float intersectBox(const BvhNode& node, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance){
+    float near = 0.0f, far = maxDistance;
+    for (int axis = 0; axis < 3; axis++){
+        float t0 = (node.boundsMin[axis] - origin[axis]) * inverseDirection[axis];
+        float t1 = (node.boundsMax[axis] - origin[axis]) * inverseDirection[axis];
+        near = std::max(near, std::min(t0, t1));
+        far = std::min(far, std::max(t0, t1));
+    }
+    return near <= far ? near : std::numeric_limits<float>::infinity();
+}
+
+// Moller-Trumbore, both sides count
+static inline void intersectTriangle(const BvhTriangle& triangle, const glm::vec3& origin, const glm::vec3& direction, RayHit& hit){
+    glm::vec3 edge1(triangle.edge1[0], triangle.edge1[1], triangle.edge1[2]);
+    glm::vec3 edge2(triangle.edge2[0], triangle.edge2[1], triangle.edge2[2]);
+    glm::vec3 p = glm::cross(direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (determinant == 0.0f)
+        return;
+    float inverse = 1.0f / determinant;
+    glm::vec3 s = origin - glm::vec3(triangle.vertex[0], triangle.vertex[1], triangle.vertex[2]);
+    float u = glm::dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f)
+        return;
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f)
+        return;
+    float t = glm::dot(edge2, q) * inverse;
+    if (t < 0.0f || t >= hit.distance)
+        return;
+    hit.hit = true;
+    hit.distance = t;
+    hit.triangle = triangle.index;
+    hit.barycentric = glm::vec2(u, v);
+}
+
+RayHit MeshBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const{
+    RayHit hit;
+    hit.distance = maxDistance;
+    if (nodes.empty())
+        return hit;
+
+    glm::vec3 inverseDirection = 1.0f / direction;
+    if (intersectBox(nodes[0], origin, inverseDirection, hit.distance) == std::numeric_limits<float>::infinity())
+        return hit;
+
+    // far children wait here with their entry distance, and are skipped once a closer hit is known
+    uint32_t stack[MAX_DEPTH];
+    float stackDistance[MAX_DEPTH];
+    unsigned int stackSize = 0;
+    uint32_t index = 0;
+    while (true){
+        const BvhNode& node = nodes[index];
+        if (node.count > 0){
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+                intersectTriangle(triangles[i], origin, direction, hit);
+        } else {
+            uint32_t near = index + 1, far = node.offset;
+            float nearDistance = intersectBox(nodes[near], origin, inverseDirection, hit.distance);
+            float farDistance = intersectBox(nodes[far], origin, inverseDirection, hit.distance);
+            if (farDistance < nearDistance){
+                std::swap(near, far);
+                std::swap(nearDistance, farDistance);
+            }
+            if (nearDistance != std::numeric_limits<float>::infinity()){
+                if (farDistance != std::numeric_limits<float>::infinity()){
+                    stack[stackSize] = far;
+                    stackDistance[stackSize++] = farDistance;
+                }
+                index = near;
+                continue;
+            }
+        }
+
+        bool found = false;
+        while (stackSize > 0 && !found){
+            stackSize--;
+            found = stackDistance[stackSize] < hit.distance;
+            index = stack[stackSize];
+        }
+        if (!found)
+            break;
+    }
+    return hit;
+}
+
+RayHit MeshBvh::raycastBruteForce(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const{
+    RayHit hit;
+    hit.distance = maxDistance;
+    for (const BvhTriangle& triangle : triangles)
+        intersectTriangle(triangle, origin, direction, hit);
+    return hit;
+}
+
+void MeshBvh::benchmark(const std::string& objPath, unsigned int rays){
+    auto now = []{ return std::chrono::steady_clock::now(); };
+    auto seconds = [](std::chrono::steady_clock::duration duration){
+        return std::chrono::duration<double>(duration).count();
+    };
+
+    CookedMesh mesh;
+    if (!mesh.load(objPath))
+        return;
+    MeshBvh bvh;
+    bvh.assign(mesh.getBvhNodes(), mesh.getBvhNodeCount(), mesh.getBvhTriangles(), mesh.getBvhTriangleCount());
+    if (bvh.isEmpty() || rays == 0)
+        return;
+
+    // origins on a sphere twice the mesh's size, aimed at random points of its box
+    glm::vec3 center = mesh.getBoundingSphereCenter();
+    float radius = mesh.getBoundingSphereRadius();
+    glm::vec3 boundsMin = mesh.getBoundsMin(), boundsMax = mesh.getBoundsMax();
+    uint32_t seed = 12345;
+    auto random = [&seed]{
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    };
+    std::vector<glm::vec3> origins(rays), directions(rays);
+    for (unsigned int i = 0; i < rays; i++){
+        float z = random() * 2.0f - 1.0f, angle = random() * 6.2831853f;
+        float ring = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        origins[i] = center + glm::vec3(ring * std::cos(angle), ring * std::sin(angle), z) * radius * 2.0f;
+        glm::vec3 target = boundsMin + (boundsMax - boundsMin) * glm::vec3(random(), random(), random());
+        directions[i] = glm::normalize(target - origins[i]);
+    }
+
+    std::vector<RayHit> hits(rays);
+    auto start = now();
+    for (unsigned int i = 0; i < rays; i++)
+        hits[i] = bvh.raycast(origins[i], directions[i]);
+    double bvhSeconds = seconds(now() - start);
+
+    // brute force gets enough rays for a stable rate and checks the hierarchy's answers
+    unsigned int bruteRays = std::min<unsigned int>(rays, (unsigned int)std::max<size_t>(1, 20000000 / bvh.getTriangles().size()));
+    unsigned int hitCount = 0, mismatches = 0;
+    start = now();
+    for (unsigned int i = 0; i < bruteRays; i++){
+        RayHit reference = bvh.raycastBruteForce(origins[i], directions[i]);
+        if (reference.hit != hits[i].hit || (reference.hit && std::abs(reference.distance - hits[i].distance) > radius * 1e-5f))
+            mismatches++;
+    }
+    double bruteSeconds = seconds(now() - start);
+    for (const RayHit& hit : hits)
+        hitCount += hit.hit ? 1 : 0;
+
+    std::cout << objPath << ": " << bvh.getTriangles().size() << " triangles, " << bvh.getNodes().size() << " nodes, "
+              << bvh.getBytes() / 1024.0 << " KB" << std::endl;
+    std::cout << "bvh: " << rays / bvhSeconds / 1e6 << " million rays/s, " << hitCount << "/" << rays << " hit" << std::endl;
+    std::cout << "brute force: " << bruteRays / bruteSeconds / 1e6 << " million rays/s, " << mismatches << "/" << bruteRays << " disagree" << std::endl;
+}
@@ -3,6 +3,8 @@
 #include "graphics/objLoader.hpp"
 #include "graphics/model.hpp"
 
+#include <chrono>
+
 unsigned int SCR_WIDTH = 800;
 unsigned int SCR_HEIGHT = 600;
 
@@ -15,26 +17,53 @@ Camera camera = Camera{glm::vec3(3.0f, 4.0f, 3.0f)};
 float mouse_x = 0;
 float mouse_y = 0;
 
-Model fox;
+// gl uploads of finished loads per frame
+static const double UPLOAD_BUDGET_MILLISECONDS = 2.0;
 
-Game::Game(){
-    setupWindow();
+Game::Game(bool headless) : headless(headless), startTime(std::chrono::steady_clock::now()){
+    if (headless)
+        setupHeadless();
+    else
+        setupWindow();
+    ThreadPool::init();
     
-    shader = Shader{"resources/shaders/texQuadShader.vs", "resources/shaders/texQuadShader.fs"};
-    modelLoaderShader = Shader{"resources/shaders/shader.vs", "resources/shaders/shader.fs"};
-    debugDepthQuad = Shader{"resources/shaders/debugDepthQuad.vs", "resources/shaders/debugDepthQuad.fs"};
-
-    crateTexture = Texture2D{"resources/container.jpg", false};
-    awesomeFaceTexture = Texture2D{"resources/awesomeface.png", true};
-
-    BatchRenderer2D::init();
-    BatchRenderer2D::setupShaderSampler(shader);
+    shader = ResourceCache::getShader("resources/shaders/texQuadShader.vs", "resources/shaders/texQuadShader.fs");
+    cubeShader = ResourceCache::getShader("resources/shaders/cubeInstanced.vs", "resources/shaders/texQuadShader.fs");
+    modelLoaderShader = ResourceCache::getShader("resources/shaders/shader.vs", "resources/shaders/shader.fs");
+    modelInstancedShader = ResourceCache::getShader("resources/shaders/shaderInstanced.vs", "resources/shaders/shader.fs");
+    debugDepthQuad = ResourceCache::getShader("resources/shaders/debugDepthQuad.vs", "resources/shaders/debugDepthQuad.fs");
+
+    // decoded on the thread pool and uploaded over the first frames by AssetLoader::update
+    crateTexture = AssetLoader::loadTexture("resources/container.jpg");
+    awesomeFaceTexture = AssetLoader::loadTexture("resources/awesomeface.png");
+    fox = AssetLoader::loadModel("resources/models/cube.obj", "resources/fox.ctex", false);
+
+    BatchRenderer2D::init(UploadMode::RingBuffer);
+    BatchRenderer2D::setupShaderSampler(*shader);
+
+    BatchRendererCube::init(UploadMode::RingBuffer, BatchRendererCube::Mode::Instanced);
+    BatchRendererCube::setupShaderSampler(*cubeShader);
+
+    floorTiles.init(100, 100, 0.25f);
+    floorTiles.setupShaderSampler(*shader);
+    floorTiles.fill([](unsigned int x, unsigned int y){
+        return ((x + y) %  2 == 0 ? glm::vec4(0.7, 0.7, 0.7, 1) : glm::vec4(0.4, 0.4, 0.4, 1));
+    });
+    // a path of tiles from the atlas the build cooks, both sprites share one page
+    if (spriteAtlas.load("resources/sprites.atlas")){
+        const AtlasSprite* crate = spriteAtlas.find("container");
+        const AtlasSprite* face = spriteAtlas.find("awesomeface");
+        for (unsigned int i = 0; i < 12 && crate && face; i++)
+            floorTiles.setTile(2 + i, 6, i % 3 == 0 ? *face : *crate);
+    }
 
-    BatchRendererCube::init();
-    BatchRendererCube::setupShaderSampler(shader);
+    Model::setupShader(*modelLoaderShader);
+    Model::setupShader(*modelInstancedShader);
+}
 
-    fox.load("resources/models/cube.obj", "resources/fox.png", false);
-    fox.setupShader(modelLoaderShader);
+void Game::setHerdSize(unsigned int size){
+    herdSize = size;
+    herd.resize(size);
 }
 
 void Game::setupWindow(){
@@ -66,6 +95,7 @@ void Game::setupWindow(){
         std::cout << "Failed to initialize GLAD" << std::endl;
         exit(-1);
     }
+    Texture2D::queryFormatSupport();
 
     glEnable(GL_DEPTH_TEST);
 
@@ -93,16 +123,53 @@ void Game::setupWindow(){
     glBindFramebuffer(GL_FRAMEBUFFER, 0);*/
 }
 
+void Game::setupHeadless(){
+    if (!NullBackend::load())
+    {
+        std::cout << "Failed to initialize the null backend" << std::endl;
+        exit(-1);
+    }
+    Texture2D::queryFormatSupport();
+
+    glEnable(GL_DEPTH_TEST);
+
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+}
+
+double Game::getTime() const{
+    if (!headless)
+        return glfwGetTime();
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
 void Game::cleanup(){
+    AssetLoader::shutdown();
+    // handles go before the context does, the cache frees what nobody else holds
+    fox.reset();
+    crateTexture.reset();
+    awesomeFaceTexture.reset();
+    shader.reset();
+    cubeShader.reset();
+    modelLoaderShader.reset();
+    modelInstancedShader.reset();
+    debugDepthQuad.reset();
+    floorTiles.destroy();
+    spriteAtlas.destroy();
+    TextureStreamer::shutdown();
     BatchRenderer2D::shutdown();
     BatchRendererCube::shutdown();
-    glfwTerminate();
+    TextureManager::shutdown();
+    ThreadPool::shutdown();
+    if (!headless)
+        glfwTerminate();
 }
 
 void Game::runMainGameLoop(){
     while (!glfwWindowShouldClose(window))
     {
-        float current = glfwGetTime();
+        float current = getTime();
         deltaTime = current - lastTime;
         lastTime = current;
         processInput(window);
@@ -113,9 +180,12 @@ void Game::runMainGameLoop(){
         camera.Update(deltaTime);
 
         // draw stuff
+        AssetLoader::update(UPLOAD_BUDGET_MILLISECONDS);
         renderScene();
+        TextureStreamer::update();
         
         glfwSwapBuffers(window);
+        endFrame();
         glfwPollEvents();
 
         fpsTimer += deltaTime;
@@ -129,62 +199,172 @@ void Game::runMainGameLoop(){
     }
 }
 
+void Game::runHeadless(unsigned int frames){
+    NullBackend::resetStats();
+    lastTime = getTime();
+    double start = lastTime;
+
+    for (unsigned int i = 0; i < frames; i++)
+    {
+        double current = getTime();
+        deltaTime = current - lastTime;
+        lastTime = current;
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        camera.Update(deltaTime);
+        AssetLoader::update(UPLOAD_BUDGET_MILLISECONDS);
+        renderScene();
+        TextureStreamer::update();
+        endFrame();
+    }
+
+    if (frames == 0)
+        return;
+    double elapsed = getTime() - start;
+    const NullBackend::Stats& stats = NullBackend::getStats();
+    std::cout << "headless: " << frames << " frames, " << elapsed * 1000.0 / frames << " ms cpu per frame" << std::endl;
+    std::cout << "per frame: " << (double)stats.drawCalls / frames << " draw calls, "
+              << (double)stats.indices / frames << " indices, "
+              << (double)stats.instances / frames << " instances, "
+              << (double)stats.bytesUploaded / frames / 1024.0 << " KB uploaded, "
+              << (double)stats.bufferMaps / frames << " buffer maps" << std::endl;
+    std::cout << "per frame: " << (double)stats.stateChanges / frames << " state changes ("
+              << (double)stats.redundantStateChanges / frames << " redundant), "
+              << (double)stats.textureBinds / frames << " texture binds, "
+              << stats.uniqueTextures << " unique textures" << std::endl;
+    std::cout << "models: " << Model::getStats().instances << " models, " << Model::getStats().triangles << " triangles in "
+              << Model::getStats().drawCalls << " draws last frame, fox lods";
+    if (fox->isReady()){
+        const Model& foxModel = *fox->value;
+        for (unsigned int lod = 0; lod < foxModel.getLodCount(); lod++)
+            std::cout << " " << foxModel.getLodTriangles(lod);
+        std::cout << std::endl;
+        std::cout << "fox memory: " << foxModel.getGpuBytes() / 1024.0 << " KB gpu (" << foxModel.getVertexBytes() / 1024.0 << " vertices, "
+                  << foxModel.getIndexBytes() / 1024.0 << " indices), " << foxModel.getCpuBytes() / 1024.0 << " KB cpu, "
+                  << Model::getInstanceBytes() / 1024.0 << " KB shared instance ring" << std::endl;
+    } else {
+        std::cout << " (not loaded)" << std::endl;
+    }
+    ResourceCache::Stats cache = ResourceCache::getStats();
+    std::cout << "resources: " << cache.hits << " hits, " << cache.misses << " misses, " << cache.resident << " resident, "
+              << cache.residentBytes / 1024.0 << " KB" << std::endl;
+    const AssetLoader::Stats& loader = AssetLoader::getStats();
+    std::cout << "assets: " << loader.uploads << " uploads, longest upload frame " << loader.longestUpdateMilliseconds << " ms" << std::endl;
+    TextureStreamer::Stats streaming = TextureStreamer::getStats();
+    std::cout << "texture streaming: " << streaming.residentBytes / 1024.0 << " of " << streaming.budgetBytes / 1024.0 << " KB budget (+"
+              << streaming.fixedBytes / 1024.0 << " KB never streamed), "
+              << streaming.streamIns << " stream ins (" << streaming.averageLatencyMilliseconds << " ms average, "
+              << streaming.longestLatencyMilliseconds << " ms longest), " << streaming.evictions << " evictions, "
+              << streaming.pending << " pending" << std::endl;
+    if (floorTiles.getStats().otherPageTiles > 0)
+        std::cout << "floor: " << floorTiles.getStats().otherPageTiles << " tiles drawn white, their texture is on another page" << std::endl;
+}
+
+void Game::endFrame(){
+    auto since = [this]{
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    };
+    if (firstFrameMilliseconds < 0.0){
+        firstFrameMilliseconds = since();
+        std::cout << "first frame after " << firstFrameMilliseconds << " ms" << std::endl;
+    }
+    if (assetsReadyMilliseconds < 0.0 && AssetLoader::getPendingCount() == 0){
+        assetsReadyMilliseconds = since();
+        std::cout << "assets loaded after " << assetsReadyMilliseconds << " ms" << std::endl;
+    }
+}
+
 void Game::renderScene() {
     glm::mat4 model = glm::mat4(1.0f);
     glm::mat4 view = camera.GetViewMatrix();
     glm::mat4 projection = glm::perspective(glm::radians(20.0f), (float)SCR_WIDTH / SCR_HEIGHT, 0.1f, 100.0f);
+    float a = 1.25*glm::pi<float>();//glfwGetTime();
 
     glm::mat4 model1 = glm::translate(model, glm::vec3(0.125 * 3, 0.0, 0.125 * 3));
     model1 = glm::scale(model1, glm::vec3(0.007));
-    model1 = glm::rotate(model1, (float)glfwGetTime(), glm::vec3(0,1,0));
-    modelLoaderShader.use();
-    modelLoaderShader.setMat4("model", model1);
-    modelLoaderShader.setMat4("view", view);
-    modelLoaderShader.setMat4("projection", projection);
-    float a = 1.25*glm::pi<float>();//glfwGetTime();
-    modelLoaderShader.setVec3("lightDir", -glm::vec3(-cos(a), -sin(a), -sin(a)));
-    modelLoaderShader.setMat3("normalMatrix", glm::mat3(transpose(inverse(model1))));
-    modelLoaderShader.setFloat("ambientStrength", 0.3f);
-
-    fox.draw();
-
-    shader.use();
-    shader.setMat4("model", model);
-    shader.setMat4("view", view);
-    shader.setMat4("projection", projection);
-    //float a = 1.25*glm::pi<float>();//glfwGetTime();
-    shader.setVec3("lightDir", -glm::vec3(-cos(a), -sin(a), -sin(a)));
-    shader.setFloat("ambientStrength", 0.3f);
+    model1 = glm::rotate(model1, (float)getTime(), glm::vec3(0,1,0));
+    modelLoaderShader->use();
+    modelLoaderShader->setMat4("view", view);
+    modelLoaderShader->setMat4("projection", projection);
+    modelLoaderShader->setVec3("lightDir", -glm::vec3(-cos(a), -sin(a), -sin(a)));
+    modelLoaderShader->setFloat("ambientStrength", 0.3f);
+
+    modelInstancedShader->use();
+    modelInstancedShader->setMat4("view", view);
+    modelInstancedShader->setMat4("projection", projection);
+    modelInstancedShader->setVec3("lightDir", -glm::vec3(-cos(a), -sin(a), -sin(a)));
+    modelInstancedShader->setFloat("ambientStrength", 0.3f);
+
+    shader->use();
+    shader->setMat4("model", model);
+    shader->setMat4("view", view);
+    shader->setMat4("projection", projection);
+    shader->setVec3("lightDir", -glm::vec3(-cos(a), -sin(a), -sin(a)));
+    shader->setFloat("ambientStrength", 0.3f);
+
+    cubeShader->use();
+    cubeShader->setMat4("model", model);
+    cubeShader->setMat4("view", view);
+    cubeShader->setMat4("projection", projection);
+    cubeShader->setVec3("lightDir", -glm::vec3(-cos(a), -sin(a), -sin(a)));
+    cubeShader->setFloat("ambientStrength", 0.3f);
 
     Raycast raycast(glm::vec2(mouse_x, mouse_y), glm::vec2(SCR_WIDTH, SCR_HEIGHT), projection, view);
     glm::vec3 intersection = raycast.checkPlaneIntersection(camera.Position, glm::vec3(0, 1, 0), 0);
 
+    Frustum frustum(projection * view);
+    floorTiles.setFrustum(frustum);
+    BatchRenderer2D::setFrustum(frustum);
+    BatchRendererCube::setFrustum(frustum);
+
+    floorTiles.resetStats();
     BatchRenderer2D::resetStats();
-    BatchRenderer2D::startBatch();
-
-    for(int i = 0; i < 100; i++){
-        for (int j = 0; j < 100; j++){
-            if(j == (int)(intersection.x * 4) && i == (int)(intersection.z * 4)){
-                BatchRenderer2D::drawTile(glm::vec2(j * 0.25f, i * 0.25f), glm::vec2(0.25f, 0.25f), glm::vec4(1,1,1,1));
-            }else{
-                glm::vec4 color = ((i + j) %  2 == 0 ? glm::vec4(0.7, 0.7, 0.7, 1) : glm::vec4(0.4, 0.4, 0.4, 1));
-                BatchRenderer2D::drawTile(glm::vec2(j * 0.25f, i * 0.25f), glm::vec2(0.25f, 0.25f), color);
-            }
+    BatchRendererCube::resetStats();
+    Model::resetStats();
+
+    renderQueue.begin(view, 100.0f);
+    renderQueue.setFrustum(frustum);
+    renderQueue.setCamera(camera, projection, (float)SCR_HEIGHT);
+    if (fox->isReady())
+        renderQueue.submitModel(RenderPass::Opaque, *modelLoaderShader, *fox->value, model1);
+    if (herdSize > 0 && fox->isReady()){
+        // a square grid over the floor the camera sees, each fox turned a little further
+        // than the last. the corners are where rays a bit inside the screen's corners hit the floor
+        glm::vec2 screen = glm::vec2(SCR_WIDTH, SCR_HEIGHT);
+        glm::vec3 corners[4];
+        const glm::vec2 inset[4] = {{0.15f, 0.85f}, {0.85f, 0.85f}, {0.15f, 0.15f}, {0.85f, 0.15f}};
+        for (int c = 0; c < 4; c++)
+            corners[c] = Raycast(inset[c] * screen, screen, projection, view).checkPlaneIntersection(camera.Position, glm::vec3(0, 1, 0), 0);
+        unsigned int columns = (unsigned int)glm::ceil(glm::sqrt((float)herdSize));
+        unsigned int rows = (herdSize + columns - 1) / columns;
+        for (unsigned int i = 0; i < herdSize; i++){
+            float u = (i % columns + 0.5f) / columns, v = (i / columns + 0.5f) / rows;
+            glm::vec3 position = glm::mix(glm::mix(corners[0], corners[1], u), glm::mix(corners[2], corners[3], u), v);
+            herd[i] = glm::translate(model, position);
+            herd[i] = glm::scale(herd[i], glm::vec3(0.007));
+            herd[i] = glm::rotate(herd[i], (float)getTime() + i, glm::vec3(0,1,0));
         }
+        renderQueue.submitModelInstances(RenderPass::Opaque, *modelInstancedShader, *fox->value, herd.data(), herd.size());
     }
-    //BatchRenderer2D::drawQuad(glm::vec2(std::sin(glfwGetTime() + 1), -0.5f), glm::vec2(0.5f, 0.5f), crateTexture.getID());
-    //BatchRenderer2D::drawQuad(glm::vec2(std::sin(glfwGetTime()), 0.0f), glm::vec2(0.5f, 0.5f), awesomeFaceTexture.getID());
-    BatchRenderer2D::endBatch();
-    BatchRenderer2D::flush();
+    renderQueue.submitTileLayer(RenderPass::Opaque, *shader, floorTiles);
 
-    //std::cout << BatchRenderer2D::getStats().drawCalls << " " << BatchRenderer2D::getStats().quadCount << std::endl;
+    // a model in front of the floor takes the hover, the tile it stands on lights up
+    if (fox->isReady() && fox->value->raycast(raycast.getRay(camera.Position), model1).hit)
+        intersection = glm::vec3(model1[3]);
 
-    BatchRendererCube::resetStats();
-    BatchRendererCube::startBatch();
-    BatchRendererCube::drawCube(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.25f), crateTexture.getID());
-    BatchRendererCube::drawCube(glm::vec3(1.0f, 0.0f, 2.0f), glm::vec3(0.25f), awesomeFaceTexture.getID());
-    BatchRendererCube::endBatch();
-    BatchRendererCube::flush();
+    // the hovered tile is drawn over the retained floor instead of rebuilding it
+    int hoverX = (int)(intersection.x * 4);
+    int hoverY = (int)(intersection.z * 4);
+    if (hoverX >= 0 && hoverY >= 0 && hoverX < (int)floorTiles.getWidth() && hoverY < (int)floorTiles.getHeight())
+        renderQueue.submitTile(RenderPass::Overlay, *shader, glm::vec2(hoverX * 0.25f, hoverY * 0.25f), glm::vec2(0.25f, 0.25f), glm::vec4(1,1,1,1));
+
+    if (crateTexture->isReady())
+        renderQueue.submitCube(RenderPass::Opaque, *cubeShader, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.25f), *crateTexture->value);
+    if (awesomeFaceTexture->isReady())
+        renderQueue.submitCube(RenderPass::Opaque, *cubeShader, glm::vec3(1.0f, 0.0f, 2.0f), glm::vec3(0.25f), *awesomeFaceTexture->value);
+    renderQueue.flush();
+
+    //std::cout << renderQueue.getStats().unsortedDrawCalls << " -> " << renderQueue.getStats().sortedDrawCalls << std::endl;
 }
 
 void Game::processInput(GLFWwindow* window){
@@ -1,8 +1,74 @@
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 #include "runner/game.hpp"
+#include "graphics/objLoader.hpp"
+#include "graphics/cookedMesh.hpp"
+#include "graphics/imageDecoder.hpp"
+#include "physics/meshBvh.hpp"
 
-int main()
+int main(int argc, char** argv)
 {
+    // --headless [frames] [foxes] [texture budget KB] renders on the null backend and prints per frame costs
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0)
+    {
+        unsigned int frames = argc > 2 ? (unsigned int)atoi(argv[2]) : 1000;
+        Game game(true);
+        game.setHerdSize(argc > 3 ? (unsigned int)atoi(argv[3]) : 0);
+        if (argc > 4)
+            TextureStreamer::setBudget((size_t)atoi(argv[4]) * 1024);
+        game.runHeadless(frames);
+        game.cleanup();
+        return 0;
+    }
+
+    // --bench-obj path [iterations] compares the obj loaders on one file
+    if (argc > 2 && strcmp(argv[1], "--bench-obj") == 0)
+    {
+        ThreadPool::init();
+        OBJLoader::benchmark(argv[2], argc > 3 ? (unsigned int)atoi(argv[3]) : 10);
+        ThreadPool::shutdown();
+        return 0;
+    }
+
+    // --bench-mesh path [iterations] times cold and warm loads through the mesh cache
+    if (argc > 2 && strcmp(argv[1], "--bench-mesh") == 0)
+    {
+        ThreadPool::init();
+        CookedMesh::benchmark(argv[2], argc > 3 ? (unsigned int)atoi(argv[3]) : 10);
+        ThreadPool::shutdown();
+        return 0;
+    }
+
+    // --bench-ray path [rays] traces random rays against a mesh's bvh and by brute force
+    if (argc > 2 && strcmp(argv[1], "--bench-ray") == 0)
+    {
+        ThreadPool::init();
+        MeshBvh::benchmark(argv[2], argc > 3 ? (unsigned int)atoi(argv[3]) : 100000);
+        ThreadPool::shutdown();
+        return 0;
+    }
+
+    // --bench-kernels [tiles] [iterations] times the sse vertex kernels against the per call
+    // drawTile and drawCube paths and checks both write the same vertices
+    if (argc > 1 && strcmp(argv[1], "--bench-kernels") == 0)
+    {
+        unsigned int count = argc > 2 ? (unsigned int)atoi(argv[2]) : 100000;
+        unsigned int iterations = argc > 3 ? (unsigned int)atoi(argv[3]) : 10;
+        BatchRenderer2D::benchmarkKernels(count, iterations);
+        BatchRendererCube::benchmarkKernels(count / 5, iterations);
+        return 0;
+    }
+
+    // --bench-decode [directory] [iterations] decodes every image in a directory on one thread and across the pool
+    if (argc > 1 && strcmp(argv[1], "--bench-decode") == 0)
+    {
+        ThreadPool::init();
+        ImageDecoder::benchmark(argc > 2 ? argv[2] : "resources", argc > 3 ? (unsigned int)atoi(argv[3]) : 10);
+        ThreadPool::shutdown();
+        return 0;
+    }
+
     Game game;
 
     game.runMainGameLoop();
@@ -0,0 +1,70 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "core/mappedFile.hpp"
+#include "core/threadPool.hpp"
+#include "graphics/atlasPacker.hpp"
+
+// offline atlas packer, images in, one .atlas file with every page and the
+// sprites' rects out. TextureAtlas loads it.
+//   atlaspack <output.atlas> <image>... [--max-size n] [--gutter n] [--padding n]
+// pages are at most 2048 square by default. sprites get a 4 texel gutter of their
+// edge texels, which keeps them apart down to mip level 2, the last one the pages get
+
+static bool printTable(const std::string& path){
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+    const AtlasFileHeader* header = (const AtlasFileHeader*)file.getData();
+    const AtlasSpriteRecord* records = (const AtlasSpriteRecord*)(file.getData() + sizeof(AtlasFileHeader));
+    size_t used = 0;
+    for (uint32_t i = 0; i < header->spriteCount; i++){
+        const AtlasSpriteRecord& record = records[i];
+        std::cout << "  " << std::string(record.name, strnlen(record.name, sizeof(record.name))) << ": page " << record.page
+                  << " at " << record.x << ", " << record.y << " size " << record.width << "x" << record.height << std::endl;
+        used += (size_t)record.width * record.height;
+    }
+    size_t total = (size_t)header->pageWidth * header->pageHeight * header->pageCount;
+    std::cout << path << ": " << header->pageCount << " page(s) of " << header->pageWidth << "x" << header->pageHeight << ", "
+              << header->spriteCount << " sprites, " << 100.0 * used / total << "% of texels used, "
+              << header->levelCount << " mip levels" << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "usage: atlaspack <output.atlas> <image>... [--max-size n] [--gutter n] [--padding n]" << std::endl;
+        return 1;
+    }
+
+    std::string outputPath = argv[1];
+    std::vector<std::string> imagePaths;
+    int maxPageSize = 2048, gutter = 4, padding = 0;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc)
+            maxPageSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--gutter") == 0 && i + 1 < argc)
+            gutter = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--padding") == 0 && i + 1 < argc)
+            padding = atoi(argv[++i]);
+        else
+            imagePaths.push_back(argv[i]);
+    }
+    if (imagePaths.empty() || maxPageSize <= 0 || gutter < 0 || padding < 0)
+    {
+        std::cout << "atlaspack needs at least one image and sizes of 0 or more" << std::endl;
+        return 1;
+    }
+
+    ThreadPool::init();
+    bool packed = AtlasPacker::cook(imagePaths, outputPath, maxPageSize, gutter, padding);
+    ThreadPool::shutdown();
+    if (!packed || !printTable(outputPath))
+        return 1;
+    return 0;
+}
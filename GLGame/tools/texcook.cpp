@@ -0,0 +1,101 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "core/threadPool.hpp"
+#include "graphics/blockCompression.hpp"
+#include "graphics/compressedTexture.hpp"
+#include "graphics/imageDecoder.hpp"
+#include "graphics/mipGenerator.hpp"
+
+// offline texture cooker, images in, .ctex files with block compressed mip chains out.
+//   texcook <image> [output.ctex] [--bc1|--bc3|--bc7] [--box|--kaiser] [--linear]
+//   texcook --bench <image> [iterations]
+//   texcook --bench-mips <image> [iterations]
+// without a format, opaque images become bc1 and everything else bc7. mips are
+// kaiser filtered in linear light unless --box or --linear (for non colour data) say otherwise
+
+static std::string getOutputPath(const std::string& imagePath){
+    size_t dot = imagePath.find_last_of('.');
+    size_t slash = imagePath.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return imagePath + ".ctex";
+    return imagePath.substr(0, dot) + ".ctex";
+}
+
+static bool isOpaque(const DecodedImage& image){
+    size_t pixels = (size_t)image.width * image.height;
+    for (size_t i = 0; i < pixels; i++){
+        if (image.pixels[i * 4 + 3] != 255)
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: texcook <image> [output.ctex] [--bc1|--bc3|--bc7] [--box|--kaiser] [--linear]" << std::endl;
+        std::cout << "       texcook --bench <image> [iterations]" << std::endl;
+        std::cout << "       texcook --bench-mips <image> [iterations]" << std::endl;
+        return 1;
+    }
+
+    ThreadPool::init();
+
+    if (strcmp(argv[1], "--bench") == 0)
+    {
+        if (argc > 2)
+            BlockCompression::benchmark(argv[2], argc > 3 ? (unsigned int)atoi(argv[3]) : 5);
+        ThreadPool::shutdown();
+        return 0;
+    }
+
+    if (strcmp(argv[1], "--bench-mips") == 0)
+    {
+        if (argc > 2)
+            MipGenerator::benchmark(argv[2], argc > 3 ? (unsigned int)atoi(argv[3]) : 10);
+        ThreadPool::shutdown();
+        return 0;
+    }
+
+    std::string imagePath = argv[1];
+    std::string outputPath = getOutputPath(imagePath);
+    const char* formatName = nullptr;
+    MipFilter filter = MipFilter::Kaiser;
+    bool srgb = true;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bc1") == 0 || strcmp(argv[i], "--bc3") == 0 || strcmp(argv[i], "--bc7") == 0)
+            formatName = argv[i];
+        else if (strcmp(argv[i], "--box") == 0 || strcmp(argv[i], "--kaiser") == 0)
+            filter = argv[i][2] == 'b' ? MipFilter::Box : MipFilter::Kaiser;
+        else if (strcmp(argv[i], "--linear") == 0)
+            srgb = false;
+        else
+            outputPath = argv[i];
+    }
+
+    DecodedImage image;
+    if (!ImageDecoder::decode(imagePath, 4, image))
+    {
+        ThreadPool::shutdown();
+        return 1;
+    }
+
+    BlockFormat format = isOpaque(image) ? BlockFormat::BC1 : BlockFormat::BC7;
+    if (formatName)
+        format = formatName[4] == '1' ? BlockFormat::BC1 : formatName[4] == '3' ? BlockFormat::BC3 : BlockFormat::BC7;
+
+    bool cooked = CompressedTexture::cook(image, format, outputPath, filter, srgb);
+    if (cooked)
+    {
+        CompressedTexture texture;
+        texture.load(outputPath);
+        std::cout << imagePath << " -> " << outputPath << ": " << BlockCompression::getName(format) << ", "
+                  << texture.getLevelCount() << " levels, " << texture.getBytes() / 1024.0 << " KB" << std::endl;
+    }
+    ThreadPool::shutdown();
+    return cooked ? 0 : 1;
+}